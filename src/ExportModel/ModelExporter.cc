@@ -4,11 +4,13 @@
 #include "ModelExporter.h"
 #include "ExportUtil/Log.h"
 #include "ExportUtil/MeshSaver.h"
+#include "ExportUtil/Parallel.h"
 #include "assimp/Importer.hpp"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
 #include <cassert>
 #include <cfloat>
+#include <algorithm>
 
 using namespace std;
 
@@ -24,6 +26,7 @@ ModelExporter::~ModelExporter() {
         this->mesh.IndexBuffer.Discard();
     }
     this->mesh.PrimGroups.clear();
+    this->mesh.PrimGroupBounds.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -87,6 +90,7 @@ ModelExporter::ExportMesh(const std::string& path) {
     this->exportVertices();
     this->exportIndices();
     this->exportPrimGroups();
+    this->ComputeBoundingBox();
 
     FILE* fp = fopen(path.c_str(), "wb");
     if (fp) {
@@ -116,20 +120,37 @@ ModelExporter::ExportModel(const std::string& path) {
 //------------------------------------------------------------------------------
 void
 ModelExporter::ComputeBoundingBox() {
-    this->boxMin = glm::vec3(FLT_MAX);
-    this->boxMax = glm::vec3(-FLT_MAX);
-    for (unsigned int meshIndex = 0; meshIndex < this->scene->mNumMeshes; meshIndex++) {
+    assert(nullptr != this->scene);
+
+    // one primitive group per aiMesh (see exportPrimGroups), compute
+    // the bounds of each aiMesh in parallel
+    const int numMeshes = this->scene->mNumMeshes;
+    std::vector<Bounds> bounds(numMeshes);
+    std::vector<float> radius(numMeshes, 0.0f);
+    ParallelFor(numMeshes, [this, &bounds](int meshIndex) {
         const aiMesh* curMesh = this->scene->mMeshes[meshIndex];
-        for (unsigned int vertIndex = 0; vertIndex < curMesh->mNumVertices; vertIndex++) {
-            const aiVector3D& pos = curMesh->mVertices[vertIndex];
-            if (pos.x < this->boxMin.x) this->boxMin.x = pos.x;
-            if (pos.y < this->boxMin.y) this->boxMin.y = pos.y;
-            if (pos.z < this->boxMin.z) this->boxMin.z = pos.z;
-            if (pos.x > this->boxMax.x) this->boxMax.x = pos.x;
-            if (pos.y > this->boxMax.y) this->boxMax.y = pos.y;
-            if (pos.z > this->boxMax.z) this->boxMax.z = pos.z;
-        }
+        bounds[meshIndex] = Bounds::FromPoints((const float*)curMesh->mVertices, curMesh->mNumVertices, 3);
+    });
+
+    // the whole-mesh sphere is centered in the merged box, a second pass
+    // gets its radius (merging the group spheres would be less tight)
+    Bounds all;
+    for (const auto& b : bounds) {
+        all.ExtendBox(b.Min, b.Max);
     }
+    const glm::vec3 center = (all.Min + all.Max) * 0.5f;
+    all.Center = center;
+    ParallelFor(numMeshes, [this, &radius, &center](int meshIndex) {
+        const aiMesh* curMesh = this->scene->mMeshes[meshIndex];
+        radius[meshIndex] = Bounds::MaxDistance((const float*)curMesh->mVertices, curMesh->mNumVertices, 3, center);
+    });
+    for (float r : radius) {
+        all.Radius = std::max(all.Radius, r);
+    }
+    this->mesh.Bounds = all;
+    this->mesh.PrimGroupBounds = bounds;
+    this->boxMin = all.Min;
+    this->boxMax = all.Max;
 }
 
 //------------------------------------------------------------------------------
@@ -144,6 +165,14 @@ ModelExporter::GetBoundingBoxMax() const {
     return this->boxMax;
 }
 
+//------------------------------------------------------------------------------
+static void
+addVertexComponent(VertexLayout& layout, const VertexLayout& requestedLayout, VertexAttr::Code attr) {
+    if (!layout.HasAttr(attr)) {
+        layout.Components.push_back(requestedLayout.AttrComponent(attr));
+    }
+}
+
 //------------------------------------------------------------------------------
 bool
 ModelExporter::exportVertices() {
@@ -163,27 +192,27 @@ ModelExporter::exportVertices() {
     for (unsigned int meshIndex = 0; meshIndex < this->scene->mNumMeshes; meshIndex++) {
         const aiMesh* curMesh = this->scene->mMeshes[meshIndex];
         if (this->requestedVertexLayout.HasAttr(VertexAttr::Position)) {
-            layout.Components[VertexAttr::Position] = this->requestedVertexLayout.Components[VertexAttr::Position];
+            addVertexComponent(layout, this->requestedVertexLayout, VertexAttr::Position);
         }
         if (curMesh->HasNormals() && this->requestedVertexLayout.HasAttr(VertexAttr::Normal)) {
-            layout.Components[VertexAttr::Normal] = this->requestedVertexLayout.Components[VertexAttr::Normal];
+            addVertexComponent(layout, this->requestedVertexLayout, VertexAttr::Normal);
         }
         if (curMesh->HasTangentsAndBitangents() && this->requestedVertexLayout.HasAttr(VertexAttr::Tangent)) {
-            layout.Components[VertexAttr::Tangent] = this->requestedVertexLayout.Components[VertexAttr::Tangent];
+            addVertexComponent(layout, this->requestedVertexLayout, VertexAttr::Tangent);
         }
         if (curMesh->HasTangentsAndBitangents() && this->requestedVertexLayout.HasAttr(VertexAttr::Binormal)) {
-            layout.Components[VertexAttr::Binormal] = this->requestedVertexLayout.Components[VertexAttr::Binormal];
+            addVertexComponent(layout, this->requestedVertexLayout, VertexAttr::Binormal);
         }
         for (int i = 0; i < 4; i++) {
             const VertexAttr::Code attr = (VertexAttr::Code)(VertexAttr::TexCoord0 + i);
             if (curMesh->HasTextureCoords(i) && this->requestedVertexLayout.HasAttr(attr)) {
-                layout.Components[attr] = this->requestedVertexLayout.Components[attr];
+                addVertexComponent(layout, this->requestedVertexLayout, attr);
             }
         }
         for (int i = 0; i < 2; i++) {
             const VertexAttr::Code attr = (VertexAttr::Code)(VertexAttr::Color0 + i);
             if (curMesh->HasVertexColors(i) && this->requestedVertexLayout.HasAttr(attr)) {
-                layout.Components[attr] = this->requestedVertexLayout.Components[attr];
+                addVertexComponent(layout, this->requestedVertexLayout, attr);
             }
         }
         // FIXME: skinned vertex components
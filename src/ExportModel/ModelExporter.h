@@ -37,7 +37,7 @@ public:
     const aiScene* GetScene() const;
     /// get exported mesh
     const Mesh& GetMesh() const;
-    /// compute bounding box of loaded geometry
+    /// compute bounding box and sphere of loaded geometry, and of each primitive group (written to the mesh file)
     void ComputeBoundingBox();
     /// get bounding box min
     const glm::vec3& GetBoundingBoxMin() const;
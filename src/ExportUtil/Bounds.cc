@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+//  Bounds.cc
+//------------------------------------------------------------------------------
+#include "Bounds.h"
+#include "Simd.h"
+#include "glm/glm.hpp"
+#include <math.h>
+
+namespace OryolTools {
+
+//------------------------------------------------------------------------------
+Bounds
+Bounds::FromPoints(const float* points, int numPoints, int stride) {
+    Bounds bounds;
+    bounds.Extend(points, numPoints, stride);
+    if (!bounds.IsEmpty()) {
+        bounds.Center = (bounds.Min + bounds.Max) * 0.5f;
+        bounds.Radius = MaxDistance(points, numPoints, stride, bounds.Center);
+    }
+    return bounds;
+}
+
+//------------------------------------------------------------------------------
+bool
+Bounds::IsEmpty() const {
+    return (this->Min.x > this->Max.x) || (this->Min.y > this->Max.y) || (this->Min.z > this->Max.z);
+}
+
+//------------------------------------------------------------------------------
+void
+Bounds::Extend(const float* points, int numPoints, int stride) {
+    // a 4-wide load of a point reads one float past its xyz, so the
+    // SIMD loop stops while the next point is still in the array
+    f4 min = f4_splat(FLT_MAX);
+    f4 max = f4_splat(-FLT_MAX);
+    int i = 0;
+    for (; (i + 4) < numPoints; i += 4) {
+        const float* p = points + i * stride;
+        const f4 p0 = f4_load(p);
+        const f4 p1 = f4_load(p + stride);
+        const f4 p2 = f4_load(p + 2 * stride);
+        const f4 p3 = f4_load(p + 3 * stride);
+        min = f4_min(min, f4_min(f4_min(p0, p1), f4_min(p2, p3)));
+        max = f4_max(max, f4_max(f4_max(p0, p1), f4_max(p2, p3)));
+    }
+    float minf[4], maxf[4];
+    f4_store(minf, min);
+    f4_store(maxf, max);
+    for (; i < numPoints; i++) {
+        const float* p = points + i * stride;
+        for (int j = 0; j < 3; j++) {
+            minf[j] = glm::min(minf[j], p[j]);
+            maxf[j] = glm::max(maxf[j], p[j]);
+        }
+    }
+    this->ExtendBox(glm::vec3(minf[0], minf[1], minf[2]), glm::vec3(maxf[0], maxf[1], maxf[2]));
+}
+
+//------------------------------------------------------------------------------
+float
+Bounds::MaxDistance(const float* points, int numPoints, int stride, const glm::vec3& center) {
+    // transpose 4 points into xxxx, yyyy, zzzz to get 4 squared distances at once
+    const f4 cx = f4_splat(center.x);
+    const f4 cy = f4_splat(center.y);
+    const f4 cz = f4_splat(center.z);
+    f4 maxSq = f4_splat(0.0f);
+    int i = 0;
+    for (; (i + 4) < numPoints; i += 4) {
+        const float* p = points + i * stride;
+        f4 x = f4_load(p);
+        f4 y = f4_load(p + stride);
+        f4 z = f4_load(p + 2 * stride);
+        f4 w = f4_load(p + 3 * stride);
+        f4_transpose(x, y, z, w);
+        x = f4_sub(x, cx);
+        y = f4_sub(y, cy);
+        z = f4_sub(z, cz);
+        maxSq = f4_max(maxSq, f4_add(f4_add(f4_mul(x, x), f4_mul(y, y)), f4_mul(z, z)));
+    }
+    float sq[4];
+    f4_store(sq, maxSq);
+    float res = glm::max(glm::max(sq[0], sq[1]), glm::max(sq[2], sq[3]));
+    for (; i < numPoints; i++) {
+        const float* p = points + i * stride;
+        const glm::vec3 d = glm::vec3(p[0], p[1], p[2]) - center;
+        res = glm::max(res, glm::dot(d, d));
+    }
+    return sqrtf(res);
+}
+
+//------------------------------------------------------------------------------
+void
+Bounds::ExtendBox(const glm::vec3& min, const glm::vec3& max) {
+    this->Min = glm::min(this->Min, min);
+    this->Max = glm::max(this->Max, max);
+}
+
+//------------------------------------------------------------------------------
+void
+Bounds::Merge(const Bounds& other) {
+    if (other.IsEmpty()) {
+        return;
+    }
+    if (this->IsEmpty()) {
+        *this = other;
+        return;
+    }
+    this->ExtendBox(other.Min, other.Max);
+
+    // smallest sphere enclosing both spheres
+    const glm::vec3 d = other.Center - this->Center;
+    const float dist = glm::length(d);
+    if ((dist + other.Radius) <= this->Radius) {
+        return;
+    }
+    if ((dist + this->Radius) <= other.Radius) {
+        this->Center = other.Center;
+        this->Radius = other.Radius;
+        return;
+    }
+    const float radius = (dist + this->Radius + other.Radius) * 0.5f;
+    this->Center += d * ((radius - this->Radius) / dist);
+    this->Radius = radius;
+}
+
+//------------------------------------------------------------------------------
+void
+Bounds::SphereFromBox() {
+    if (!this->IsEmpty()) {
+        this->Center = (this->Min + this->Max) * 0.5f;
+        this->Radius = glm::length(this->Max - this->Min) * 0.5f;
+    }
+}
+
+//------------------------------------------------------------------------------
+Bounds
+Bounds::Transform(const glm::mat4& m) const {
+    Bounds res;
+    if (this->IsEmpty()) {
+        return res;
+    }
+    for (int i = 0; i < 8; i++) {
+        const glm::vec3 corner((i & 1) ? this->Max.x : this->Min.x,
+                               (i & 2) ? this->Max.y : this->Min.y,
+                               (i & 4) ? this->Max.z : this->Min.z);
+        const glm::vec3 p = glm::vec3(m * glm::vec4(corner, 1.0f));
+        res.ExtendBox(p, p);
+    }
+    const float scale = glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+    res.Center = glm::vec3(m * glm::vec4(this->Center, 1.0f));
+    res.Radius = this->Radius * scale;
+    return res;
+}
+
+} // namespace OryolTools
@@ -0,0 +1,41 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class OryolTools::Bounds
+    @brief axis-aligned bounding box and bounding sphere
+
+    The point loops are SIMD (4 points at a time), so computing the bounds
+    of many point sets is cheap enough to run over all meshes in parallel.
+*/
+#include <cfloat>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace OryolTools {
+
+class Bounds {
+public:
+    glm::vec3 Min = glm::vec3(FLT_MAX);
+    glm::vec3 Max = glm::vec3(-FLT_MAX);
+    glm::vec3 Center = glm::vec3(0.0f);
+    float Radius = 0.0f;
+
+    /// compute the box and sphere (centered in the box) of points, stride in floats (>= 3)
+    static Bounds FromPoints(const float* points, int numPoints, int stride);
+    /// get the max distance of points from a center point, stride in floats (>= 3)
+    static float MaxDistance(const float* points, int numPoints, int stride, const glm::vec3& center);
+    /// return true if nothing has been added to the box
+    bool IsEmpty() const;
+    /// grow the box by points, stride in floats (>= 3), doesn't update the sphere
+    void Extend(const float* points, int numPoints, int stride);
+    /// grow the box by another box, doesn't update the sphere
+    void ExtendBox(const glm::vec3& min, const glm::vec3& max);
+    /// grow box and sphere to also enclose other bounds
+    void Merge(const Bounds& other);
+    /// set the sphere to enclose the box
+    void SphereFromBox();
+    /// get bounds enclosing the transformed box and sphere
+    Bounds Transform(const glm::mat4& m) const;
+};
+
+} // namespace OryolTools
@@ -170,9 +170,10 @@ Config::GetLayout() const {
             const std::string& attrName = VertexAttr::ToString((VertexAttr::Code)attrIndex);
             if (layout->contains(attrName)) {
                 auto attr = layout->get(attrName)->as_table();
+                VertexComponent comp((VertexAttr::Code)attrIndex);
                 if (attr->contains("format")) {
                     auto format = attr->get("format");
-                    result.Components[attrIndex].Format = VertexFormat::FromString(format->as<std::string>()->get());
+                    comp.Format = VertexFormat::FromString(format->as<std::string>()->get());
                 }
                 if (attr->contains("scale")) {
                     auto scale = attr->get("scale");
@@ -183,7 +184,7 @@ Config::GetLayout() const {
                     else if (scale->as<int64_t>()) {
                         scaleValue = scale->as<int64_t>()->get();
                     }
-                    result.Components[attrIndex].Scale = scaleValue;
+                    comp.Scale = scaleValue;
                 }
                 if (attr->contains("bias")) {
                     auto bias = attr->get("bias");
@@ -194,7 +195,19 @@ Config::GetLayout() const {
                     else if (bias->as<int64_t>()) {
                         biasValue = bias->as<int64_t>()->get();
                     }
-                    result.Components[attrIndex].Bias = biasValue;
+                    comp.Bias = biasValue;
+                }
+                if (attr->contains("stream")) {
+                    auto stream = attr->get("stream");
+                    if (stream->as<int64_t>()) {
+                        comp.Stream = (int) stream->as<int64_t>()->get();
+                    }
+                    if (comp.Stream < 0) {
+                        Log::Fatal("invalid vertex stream %d in Layout.%s!\n", comp.Stream, attrName.c_str());
+                    }
+                }
+                if (comp.Format != VertexFormat::Invalid) {
+                    result.Components.push_back(comp);
                 }
             }
         }
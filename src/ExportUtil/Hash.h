@@ -0,0 +1,38 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class OryolTools::Hash
+    @brief incremental 64-bit FNV-1a hash
+
+    Used to find candidates for identical data (anim curves, materials,
+    meshes, vertex positions), a hash match must always be confirmed by
+    an exact compare.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace OryolTools {
+
+class Hash {
+public:
+    uint64_t Value = 14695981039346656037ULL;
+
+    /// add raw bytes
+    void Add(const void* ptr, size_t num) {
+        const uint8_t* bytes = (const uint8_t*) ptr;
+        for (size_t i = 0; i < num; i++) {
+            this->Value = (this->Value ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+    /// add the raw bytes of a value
+    template<class TYPE> void AddValue(const TYPE& val) {
+        this->Add(&val, sizeof(val));
+    }
+    /// add a string including its terminating zero
+    void AddString(const std::string& str) {
+        this->Add(str.c_str(), str.length() + 1);
+    }
+};
+
+} // namespace OryolTools
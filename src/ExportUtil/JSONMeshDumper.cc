@@ -40,15 +40,12 @@ JSONMeshDumper::dumpHeader(cJSON* jsonNode, const Mesh& mesh) {
 
     cJSON* jsonLayout = cJSON_CreateArray();
     cJSON_AddItemToObject(jsonNode, "vertex_layout", jsonLayout);
-    for (int i = 0; i < VertexAttr::Num; i++) {
-        const auto& comp = mesh.VertexBuffer.GetVertexLayout().Components[i];
-        if (comp.Format != VertexFormat::Invalid) {
-            VertexAttr::Code attr = (VertexAttr::Code) i;
-            cJSON* jsonComp = cJSON_CreateObject();
-            cJSON_AddItemToArray(jsonLayout, jsonComp);
-            cJSON_AddItemToObject(jsonComp, "attr", cJSON_CreateString(VertexAttr::ToString(attr)));
-            cJSON_AddItemToObject(jsonComp, "format", cJSON_CreateString(VertexFormat::ToString(comp.Format)));
-        }
+    for (const auto& comp : mesh.VertexBuffer.GetVertexLayout().Components) {
+        cJSON* jsonComp = cJSON_CreateObject();
+        cJSON_AddItemToArray(jsonLayout, jsonComp);
+        cJSON_AddItemToObject(jsonComp, "attr", cJSON_CreateString(VertexAttr::ToString(comp.Attr)));
+        cJSON_AddItemToObject(jsonComp, "format", cJSON_CreateString(VertexFormat::ToString(comp.Format)));
+        cJSON_AddItemToObject(jsonComp, "stream", cJSON_CreateNumber(comp.Stream));
     }
 
     cJSON* jsonPrimGroups = cJSON_CreateArray();
@@ -72,13 +69,15 @@ JSONMeshDumper::dumpVertices(cJSON* jsonNode, const Mesh& mesh) {
     cJSON* jsonVertices = cJSON_CreateArray();
     cJSON_AddItemToObject(jsonNode, "vertices", jsonVertices);
     const VertexLayout& layout = mesh.VertexBuffer.GetVertexLayout();
-    const uint8_t* ptr = mesh.VertexBuffer.GetDataPointer();
+    const uint8_t* data = mesh.VertexBuffer.GetDataPointer();
     const int numVerts = mesh.VertexBuffer.GetNumVertices();
     for (int vertIndex = 0; vertIndex < numVerts; vertIndex++) {
         cJSON* jsonVertex = cJSON_CreateArray();
         cJSON_AddItemToArray(jsonVertices, jsonVertex);
-        for (int attr = 0; attr < VertexAttr::Num; attr++) {
-            switch (layout.Components[attr].Format) {
+        for (const auto& comp : layout.Components) {
+            const uint8_t* ptr = data + mesh.VertexBuffer.GetStreamOffset(comp.Stream) +
+                vertIndex * layout.StreamByteSize(comp.Stream) + layout.StreamOffset(comp.Attr);
+            switch (comp.Format) {
                 case VertexFormat::Float4:
                     {
                         const float* fPtr = (const float*) ptr;
@@ -7,6 +7,7 @@
 #include "ExportUtil/VertexBuffer.h"
 #include "ExportUtil/IndexBuffer.h"
 #include "ExportUtil/PrimitiveGroup.h"
+#include "ExportUtil/Bounds.h"
 #include <vector>
 
 namespace OryolTools {
@@ -19,6 +20,10 @@ public:
     class IndexBuffer IndexBuffer;
     /// primitive groups
     std::vector<PrimitiveGroup> PrimGroups;
+    /// optional bounds of the whole mesh (not written if empty)
+    class Bounds Bounds;
+    /// bounds of each primitive group (written with the mesh bounds)
+    std::vector<class Bounds> PrimGroupBounds;
 };
 
 } // namespace OryolTool
\ No newline at end of file
@@ -13,6 +13,18 @@ MeshSaver::write32(FILE* fp, uint32_t val) {
     return fwrite(&val, 1, sizeof(val), fp);
 }
 
+//------------------------------------------------------------------------------
+size_t
+MeshSaver::writeBounds(FILE* fp, const Bounds& bounds) {
+    const float values[10] = {
+        bounds.Min.x, bounds.Min.y, bounds.Min.z,
+        bounds.Max.x, bounds.Max.y, bounds.Max.z,
+        bounds.Center.x, bounds.Center.y, bounds.Center.z,
+        bounds.Radius
+    };
+    return fwrite(values, 1, sizeof(values), fp);
+}
+
 //------------------------------------------------------------------------------
 size_t
 MeshSaver::Save(const Mesh& mesh, FILE* fp) {
@@ -22,23 +34,27 @@ MeshSaver::Save(const Mesh& mesh, FILE* fp) {
     assert(!mesh.PrimGroups.empty());
 
     const VertexLayout& layout = mesh.VertexBuffer.GetVertexLayout();
+    const int numStreams = layout.NumStreams();
     size_t size = 0;
 
     // write magic number and header data
-    size += write32(fp, 'OMSH');
+    size += write32(fp, (numStreams > 1) ? 'OMS2' : 'OMSH');
     size += write32(fp, mesh.VertexBuffer.GetNumVertices());
     size += write32(fp, layout.ByteSize());
     size += write32(fp, mesh.IndexBuffer.GetNumIndices());
     size += write32(fp, mesh.IndexBuffer.GetIndexSize());
     size += write32(fp, layout.Components.size());
     size += write32(fp, mesh.PrimGroups.size());
+    if (numStreams > 1) {
+        size += write32(fp, numStreams);
+    }
 
     // write vertex layout
-    for (uint32_t attr = 0; attr < VertexAttr::Num; attr++) {
-        const auto& comp = layout.Components[attr];
-        if (VertexFormat::Invalid != comp.Format) {
-            size += write32(fp, attr);
-            size += write32(fp, comp.Format);
+    for (const auto& comp : layout.Components) {
+        size += write32(fp, comp.Attr);
+        size += write32(fp, comp.Format);
+        if (numStreams > 1) {
+            size += write32(fp, comp.Stream);
         }
     }
 
@@ -66,6 +82,16 @@ MeshSaver::Save(const Mesh& mesh, FILE* fp) {
         assert((size & 3) == 0);
     }
 
+    // write optional bounds
+    if (!mesh.Bounds.IsEmpty()) {
+        assert(mesh.PrimGroupBounds.size() == mesh.PrimGroups.size());
+        size += write32(fp, 'OBND');
+        size += writeBounds(fp, mesh.Bounds);
+        for (const auto& bounds : mesh.PrimGroupBounds) {
+            size += writeBounds(fp, bounds);
+        }
+    }
+
     return size;
 }
 
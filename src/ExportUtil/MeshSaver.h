@@ -59,6 +59,39 @@
     uint8_t vertexData[numVertices * vertexSize];
     uint8_t indexData[numIndices * indexSize];
     [optional 2 bytes of padding if odd number of 16-bit indices]
+
+    If the vertex layout has more than one vertex stream, the file is
+    written with the 'OMS2' magic number instead. vertexSize is the sum of
+    all stream strides, the header is followed by the number of vertex
+    streams, and each vertex component has a stream index:
+
+    uint32_t magic = 'OMS2';
+    ... (same header as 'OMSH')
+    uint32_t numVertexStreams;
+    struct {
+        uint32_t attr;
+        uint32_t format;
+        uint32_t stream;
+    } vertexComponents[numVertexComponents];
+    ... (primitive groups)
+    uint8_t vertexData[numVertices * vertexSize];
+
+    The vertex data holds the streams one after another, each stream
+    has numVertices vertices with the components of the stream interleaved
+    (in vertex component order).
+
+    If the mesh has bounds, they follow the (padded) index data, readers
+    which don't know about them stop after the index data. The first
+    bounds are of the whole mesh, followed by the bounds of each
+    primitive group:
+
+    uint32_t tag = 'OBND';
+    struct {
+        float min[3];
+        float max[3];
+        float center[3];    // bounding sphere center
+        float radius;       // bounding sphere radius
+    } bounds[1 + numPrimitiveGroups];
 */
 #include <cstdio>
 #include "ExportUtil/Mesh.h"
@@ -73,6 +106,8 @@ public:
 private:
     /// helper to write an uint32_t value
     static size_t write32(FILE* fp, std::uint32_t val);
+    /// helper to write bounds
+    static size_t writeBounds(FILE* fp, const Bounds& bounds);
 };
 
 } // namespace OryolTools
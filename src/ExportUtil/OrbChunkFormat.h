@@ -0,0 +1,540 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @file OrbChunkFormat.h
+    @brief optional extension chunks appended to ORB files
+
+    The sections described by OrbHeader (see OrbFileFormat.h) are followed
+    by the string pool. Optional extension chunks follow the string pool
+    (starting at the next 4-byte aligned offset) and run to the end of the
+    file. Each chunk starts with an OrbChunkHeader. Readers which don't know
+    a chunk tag can skip it using its Size, and readers which don't know
+    about chunks at all never look past the string pool.
+
+    Chunks which a streaming reader needs before the vertex data (only
+    'PMSH') are written in front of it instead: from the end of the anim
+    clip table (AnimClipOffset + NumAnimClips * sizeof(OrbAnimClip)) to
+    VertexDataOffset. Readers which find sections by their header offsets
+    never look at this gap.
+*/
+#include <stdint.h>
+
+namespace Oryol {
+
+#pragma pack(push, 4)
+
+struct OrbChunkHeader {
+    uint32_t Tag = 0;
+    uint32_t Size = 0;      // payload size in bytes (multiple of 4), without the header
+};
+
+//------------------------------------------------------------------------------
+/**
+    'AKBP': bit-packed animation keys
+
+    When present, the anim key data section holds bit-packed keys instead of
+    16-bit signed normalized keys. Each clip's keys are stored as key frames
+    of KeyStride bytes (a multiple of 4). Within a key frame, each packed
+    component occupies Bits bits starting at BitOffset (LSB first). Since
+    a component has at most 16 bits, it always fits into an unaligned 32-bit
+    load from byte (BitOffset>>3), so all components can be unpacked with the
+    same branch-free load/shift/mask/scale sequence.
+    The key data section is padded with 4 extra bytes so the last load
+    never reads past the end. A component with 0 bits is constant (Min).
+
+        value = Min + float((load32(frame + (BitOffset>>3)) >> (BitOffset&7)) & ((1<<Bits)-1)) * Scale
+
+    OrbAnimCurve::KeyOffset of a non-static curve is the index of its first
+    packed component, relative to the clip's FirstComponent.
+
+    Payload: OrbPackedAnimHeader, OrbPackedAnimClip[NumClips],
+    OrbPackedAnimComponent[NumComponents]
+*/
+struct OrbPackedAnimHeader {
+    uint32_t NumClips = 0;
+    uint32_t NumComponents = 0;
+};
+
+struct OrbPackedAnimClip {
+    uint32_t FirstComponent = 0;
+    uint32_t NumComponents = 0;
+    uint32_t KeyDataOffset = 0;     // byte offset relative to start of anim key data
+    uint32_t KeyStride = 0;         // byte size of one key frame
+};
+
+struct OrbPackedAnimComponent {
+    uint16_t Curve = 0;             // curve index in clip
+    uint8_t Index = 0;              // key component index (0..3)
+    uint8_t Bits = 0;               // 0..16
+    uint32_t BitOffset = 0;         // bit offset in key frame
+    float Min = 0.0f;
+    float Scale = 0.0f;
+};
+
+//------------------------------------------------------------------------------
+/**
+    'AKLY': anim key layout
+
+    Describes how the 16-bit anim keys are arranged in the anim key data
+    section. Without this chunk, keys are Interleaved: all non-static curves
+    of a clip key by key, and the key of a curve at frame i is at
+    (KeyOffset + i * clipStride), with clipStride being the number of
+    key components of all non-static curves of the clip.
+
+    With the Contiguous layout, the keys of each curve are stored as one
+    block, the key at frame i is at (KeyOffset + i * numCurveComponents).
+    Identical curves (also in different clips) may share the same
+    KeyOffset.
+
+    With the Segmented layout, each clip is split into segments of
+    SegmentLength keys (the last segment of a clip may be shorter), which
+    are described by the OrbAnimKeySegment headers following the
+    OrbAnimKeyLayout struct. The segments of clip n start at segment index
+    sum(ceil(Length/SegmentLength)) of all clips before n. Within a segment,
+    the keys of each non-static curve are stored as one block, in curve
+    order. KeyOffset is the curve's component offset in a clip key (as if
+    interleaved, without the clip's base offset), so the key at frame i is at:
+
+        seg = segments[clipFirstSegment + i / SegmentLength]
+        seg.KeyDataOffset + KeyOffset * seg.NumKeys + (i - seg.FirstKey) * numCurveComponents
+
+    All offsets are in number of 16-bit key components.
+
+    Payload: OrbAnimKeyLayout, OrbAnimKeySegment[NumSegments]
+*/
+struct OrbAnimKeyLayout {
+    enum Enum : uint32_t {
+        Interleaved = 0,
+        Contiguous = 1,
+        Segmented = 2,
+    };
+    uint32_t Layout = Interleaved;
+    uint32_t SegmentLength = 0;
+    uint32_t NumSegments = 0;
+};
+
+struct OrbAnimKeySegment {
+    uint32_t FirstKey = 0;
+    uint32_t NumKeys = 0;
+    uint32_t KeyDataOffset = 0;
+};
+
+//------------------------------------------------------------------------------
+/**
+    'ABPC': bind pose curves
+
+    Marks the static anim curves whose StaticKey is identical with the
+    bone's bind pose (OrbBone Translate, Rotate or Scale), so that samplers
+    can skip them and start from the bind pose instead.
+
+    Payload: for each anim clip, (NumCurves+31)/32 uint32_t bit masks, bit
+    (curveIndex & 31) of word (curveIndex >> 5) is set for bind pose curves.
+*/
+
+//------------------------------------------------------------------------------
+/**
+    'MSKN': mesh skinning
+
+    Per-mesh skinning information, in mesh order. MaxInfluences is the max
+    number of non-zero skin weights of the mesh's vertices (so shaders can
+    be selected by the actual influence count). If NumJoints is > 0, the
+    vertex bone indices of the mesh are local indices into a joint palette
+    of NumJoints bone indices starting at FirstJoint, otherwise they are
+    bone indices.
+
+    Payload: OrbMeshSkin[NumMeshes], uint32_t bone indices[sum(NumJoints)]
+*/
+struct OrbMeshSkin {
+    uint32_t FirstJoint = 0;
+    uint32_t NumJoints = 0;
+    uint32_t MaxInfluences = 0;
+};
+
+//------------------------------------------------------------------------------
+/**
+    'HIER': sorted hierarchy
+
+    When present, bones and nodes are sorted parents-first and grouped by
+    hierarchy depth (all roots first, then all depth-1 items, and so on),
+    so that a parent index is always smaller than the item's own index and
+    world transforms can be updated in a single linear pass. The items of
+    depth level i are in the range [First[i], First[i+1]). If the bones are
+    ordered for skeleton LOD (see 'BLOD'), they are parents-first but not
+    grouped by depth, and NumBoneLevels is 0.
+
+    Payload: OrbHierarchy, uint32_t FirstBone[NumBoneLevels+1],
+    uint32_t FirstNode[NumNodeLevels+1]
+*/
+struct OrbHierarchy {
+    uint32_t NumBoneLevels = 0;
+    uint32_t NumNodeLevels = 0;
+};
+
+//------------------------------------------------------------------------------
+/**
+    'BIBM': inverse bind matrices
+
+    The inverse of each bone's bind pose model-space matrix, as 16 floats
+    (column-major), in bone order. Skinning matrices are computed as
+    boneModelMatrix * inverseBindMatrix.
+
+    Payload: float[16][NumBones]
+*/
+
+//------------------------------------------------------------------------------
+/**
+    'BLOD': skeleton LOD levels
+
+    Bones are ordered by importance (parents-first), so that skeleton LOD
+    level i only needs to evaluate the first NumLevelBones[i] bones. Vertices
+    skinned to bones outside a level are reskinned to the nearest ancestor
+    inside the level with a per-level joint remap table: in level i, bone b
+    uses the skinning matrix of bone Remap[i * NumBones + b] (which is b for
+    bones inside the level).
+
+    Payload: OrbBoneLod, uint32_t NumLevelBones[NumLevels],
+    uint32_t Remap[NumLevels * NumBones]
+*/
+struct OrbBoneLod {
+    uint32_t NumLevels = 0;
+    uint32_t NumBones = 0;
+};
+
+//------------------------------------------------------------------------------
+/**
+    'VQNT': per-mesh vertex quantization
+
+    Per mesh (in mesh order), the dequantization transform of vertex
+    positions and texture coordinates, computed from the mesh's (or the
+    node's) bounding box:
+
+        value = decoded * Scale + Offset
+
+    where decoded is the value as defined by the vertex format (-1..+1 for
+    signed normalized, 0..1 for unsigned normalized formats). Float formats
+    are not quantized and have an identity transform. Without this chunk,
+    Short4N positions are scaled by OrbHeader::VertexMagnitude.
+
+    Payload: OrbMeshQuantization[NumMeshes]
+*/
+struct OrbMeshQuantization {
+    float PositionOffset[3] = { 0.0f, 0.0f, 0.0f };
+    float PositionScale[3] = { 1.0f, 1.0f, 1.0f };
+    float TexCoordOffset[4][2] = { };
+    float TexCoordScale[4][2] = { { 1.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, 1.0f } };
+};
+
+//------------------------------------------------------------------------------
+/**
+    'MVLY': per-mesh vertex layouts
+
+    When present, the vertex data section is split into vertex streams, one
+    per distinct mesh vertex layout. A mesh layout is the header's vertex
+    layout without the attributes which are constant across the mesh (see
+    'MCON' chunk). Each stream holds the vertices of all its meshes in
+    mesh order (level by level with 'PMSH'), starting at DataOffset
+    (relative to the start of the vertex data section), and
+    OrbMesh::FirstVertex is relative to the start of the mesh's stream.
+
+    Payload: OrbVertexLayouts, OrbVertexStream[NumStreams],
+    OrbVertexComponent[NumComponents], uint32_t MeshStream[NumMeshes]
+*/
+struct OrbVertexLayouts {
+    uint32_t NumStreams = 0;
+    uint32_t NumComponents = 0;
+};
+
+struct OrbVertexStream {
+    uint32_t FirstComponent = 0;
+    uint32_t NumComponents = 0;
+    uint32_t Stride = 0;            // byte size of one vertex
+    uint32_t DataOffset = 0;        // byte offset relative to start of vertex data
+    uint32_t NumVertices = 0;
+};
+
+//------------------------------------------------------------------------------
+/**
+    'MCON': constant vertex attributes
+
+    Always present with the 'MVLY' chunk. The vertex attributes which have
+    been removed from a mesh layout because they are constant across the
+    mesh, with their value to bind as default vertex attribute. Skin indices
+    of meshes without skin weights are recorded as zero. Values are not
+    quantized, the constants of mesh i are the items from
+    FirstConstant[i] to FirstConstant[i+1].
+
+    Payload: uint32_t FirstConstant[NumMeshes + 1], OrbVertexConstant[NumConstants]
+*/
+struct OrbVertexConstant {
+    uint32_t Attr = 0;              // OrbVertexAttr
+    float Value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+//------------------------------------------------------------------------------
+/**
+    'QTAN': quaternion tangent frames
+
+    When present, the vertex attribute OrbVertexAttr (usually Normal) holds
+    the tangent frame as Short4N quaternion, and there are no Tangent and
+    Binormal attributes. The sign of w is the handedness of the binormal:
+
+        normal = rotate(q, (0,0,1))
+        tangent = rotate(q, (1,0,0))
+        binormal = cross(normal, tangent) * sign(q.w)
+
+    Payload: uint32_t OrbVertexAttr
+*/
+
+//------------------------------------------------------------------------------
+/**
+    'DPTH': position-only depth stream
+
+    A separate vertex stream for shadow and depth passes which only holds
+    positions (and skin weights and indices, if present) in the same
+    formats and quantization as the vertex data section (see 'VQNT').
+    The vertices of each mesh are welded across normal and texcoord seams,
+    and each mesh has its own range of welded vertices and 16-bit indices.
+    Indices are relative to the start of the depth stream. Triangles which
+    became degenerate by welding are removed.
+
+    Payload: OrbDepthStream, OrbVertexComponent[NumComponents],
+    OrbDepthMesh[NumMeshes], vertex data (NumVertices * Stride bytes,
+    padded to 4 bytes), uint16_t indices[NumIndices] (padded to 4 bytes)
+*/
+struct OrbDepthStream {
+    uint32_t NumComponents = 0;
+    uint32_t Stride = 0;
+    uint32_t NumVertices = 0;
+    uint32_t NumIndices = 0;
+};
+
+struct OrbDepthMesh {
+    uint32_t FirstVertex = 0;
+    uint32_t NumVertices = 0;
+    uint32_t FirstIndex = 0;
+    uint32_t NumIndices = 0;
+};
+
+//------------------------------------------------------------------------------
+/**
+    'VSTR': non-interleaved vertex attribute streams
+
+    When present, the vertex attributes are split into NumStreams attribute
+    streams, each written as a separate array with its own stride (the
+    byte size of the attributes in the stream). This applies to each vertex
+    data region, which is the whole vertex data section, or each vertex
+    stream of the 'MVLY' chunk. Inside a region of numVertices vertices,
+    attribute stream s starts at:
+
+        regionOffset + numVertices * (stride(0) + ... + stride(s-1))
+
+    and vertex i of stream s is at (streamOffset + i * stride(s)). The
+    attributes of a stream are interleaved in vertex component order.
+
+    Payload: uint32_t NumStreams, uint32_t Stream[OrbVertexAttr::Num]
+*/
+
+//------------------------------------------------------------------------------
+/**
+    'BVOL': mesh and node bounding volumes
+
+    An axis-aligned bounding box and a bounding sphere of each mesh and
+    node, so the runtime can cull without touching vertex data. Mesh bounds
+    are in the space of the mesh's (decoded) vertices, the bounds of skinned
+    meshes enclose the mesh in all keys of all anim clips. Node bounds
+    enclose the node's meshes and its child nodes (transformed by the child
+    node's local transform), culling a node culls its whole subtree.
+
+    Payload: OrbBounds[NumMeshes] (in mesh order), OrbBounds[NumNodes]
+*/
+struct OrbBounds {
+    float Min[3] = { };
+    float Max[3] = { };
+    float Center[3] = { };      // bounding sphere center
+    float Radius = 0.0f;        // bounding sphere radius
+};
+
+//------------------------------------------------------------------------------
+/**
+    'TBVH': triangle bounding volume hierarchies
+
+    A binary BVH over the triangles of each static node (or of all nodes,
+    with skinned meshes in their bind pose), built with the surface area
+    heuristic, for raycasts and overlap queries without a runtime build.
+
+    The nodes of a tree are stored depth-first (a node's first inner child
+    directly follows it), the root is the tree's first node. Each node holds
+    the bounds of its 2 children, quantized to 16 bits relative to the
+    tree bounds (rounded outwards):
+
+        childMin = tree.Min + ChildMin * (tree.Max - tree.Min) / 65535
+
+    A child reference with the Leaf bit set is a leaf with
+    ((ref >> LeafCountShift) & LeafCountMask) triangles starting at
+    triangle (ref & LeafFirstMask), otherwise the index of the child node.
+    Leaves with 0 triangles are empty (only in single-leaf trees). Trees
+    have at most MaxDepth levels, so queries can use a fixed-size stack. Node and
+    triangle indices are relative to the tree's FirstNode and FirstTriangle.
+    Triangle vertices are in the space of the node's (decoded) vertices.
+
+    Payload: OrbBvhHeader, OrbBvhTree[NumTrees], OrbBvhNode[NumNodes],
+    OrbBvhTriangle[NumTriangles]
+*/
+struct OrbBvhHeader {
+    uint32_t NumTrees = 0;
+    uint32_t NumNodes = 0;
+    uint32_t NumTriangles = 0;
+};
+
+struct OrbBvhTree {
+    uint32_t Node = 0;              // index of the ORB node
+    uint32_t FirstNode = 0;
+    uint32_t NumNodes = 0;
+    uint32_t FirstTriangle = 0;
+    uint32_t NumTriangles = 0;
+    float Min[3] = { };
+    float Max[3] = { };
+};
+
+struct OrbBvhNode {
+    enum : uint32_t {
+        Leaf = 0x80000000,
+        LeafCountShift = 24,
+        LeafCountMask = 0x7F,
+        LeafFirstMask = 0x00FFFFFF,
+        MaxDepth = 64,
+    };
+    uint16_t ChildMin[2][3] = { };
+    uint16_t ChildMax[2][3] = { };
+    uint32_t Child[2] = { };
+};
+
+struct OrbBvhTriangle {
+    float Vertex[3][3] = { };
+    uint32_t Mesh = 0;              // index of the ORB mesh
+    uint32_t FirstIndex = 0;        // first index of the triangle, relative to the mesh
+};
+
+//------------------------------------------------------------------------------
+/**
+    'INST': mesh instances
+
+    Meshes with identical vertices, indices, joint palette and material
+    (typically the same geometry placed under different nodes) share
+    their vertex and index data: the OrbMesh entries of all instances
+    have the same FirstVertex and FirstIndex, so readers which don't know
+    this chunk simply draw every mesh. Each group lists the meshes sharing
+    one geometry (the source mesh first), together with the node of each
+    instance, whose model transform is the instance transform of an
+    instanced draw. Meshes without instances are in no group.
+
+    Payload: OrbInstanceHeader, OrbInstanceGroup[NumGroups],
+    OrbMeshInstance[NumInstances]
+*/
+struct OrbInstanceHeader {
+    uint32_t NumGroups = 0;
+    uint32_t NumInstances = 0;
+};
+
+struct OrbInstanceGroup {
+    uint32_t Mesh = 0;              // index of the source mesh
+    uint32_t FirstInstance = 0;
+    uint32_t NumInstances = 0;
+};
+
+struct OrbMeshInstance {
+    uint32_t Mesh = 0;              // index of the ORB mesh
+    uint32_t Node = 0;              // index of the mesh's ORB node
+};
+
+//------------------------------------------------------------------------------
+/**
+    'SPCH': spatial chunks
+
+    Large static nodes can be split into spatial chunks: child nodes with
+    an identity transform, each holding the triangles (by centroid) of one
+    cell of a uniform grid in the parent node's space. The chunk's meshes
+    are its OrbNode mesh range, and its bounds are in the 'BVOL' chunk,
+    so the runtime can cull and stream each chunk separately. Chunks of a
+    node are written in Morton order of their grid cells (the cell
+    coordinates are the deinterleaved bits of MortonCode, x in bit 0), so
+    the nodes, meshes and vertex and index data of spatially near chunks
+    are near to each other in the file.
+
+    Payload: OrbSpatialChunk[] (in node order)
+*/
+struct OrbSpatialChunk {
+    uint32_t Node = 0;              // index of the ORB node
+    uint32_t MortonCode = 0;        // 10 bits per axis
+};
+
+//------------------------------------------------------------------------------
+/**
+    'PMSH': progressive meshes
+
+    Written in front of the vertex data (see above), so that a reader has
+    it before any vertex and index data. The vertices and triangles of each
+    mesh are ordered coarse to fine by an edge collapse simplification into
+    mesh levels: the base mesh, then vertex prefixes which roughly double
+    the vertex count, the last one is the full mesh. Mesh levels are aligned
+    into NumLevels global levels at the full mesh: a mesh with n levels has
+    its base mesh in level 0, and its mesh level k > 0 in level
+    NumLevels - n + k. Error is the max distance error of the simplified
+    surfaces of a level in model units (0 for the last level).
+
+    The vertex data of each vertex data region (the whole vertex data
+    section, or each vertex stream of 'MVLY', in each attribute stream of
+    'VSTR') and the index data are written level by level, and inside a
+    level mesh by mesh: each mesh adds a slice of vertices and triangles
+    per level (instances share the slices of their source mesh). So the
+    first NumStreamVertices[level][stream] vertices of a vertex stream and
+    the first NumIndices indices of the index data hold the level and all
+    coarser levels. Since the meshes are interleaved, OrbMesh::FirstVertex
+    and FirstIndex only give the first vertex and index of a mesh, and
+    mesh-relative index positions (e.g. in 'TBVH') count along the slices
+    of the mesh in level order.
+
+    Each vertex has a parent vertex with a smaller index in the same
+    stream (the vertex it was collapsed into), base vertices are their own
+    parent. The parents of stream s start after the vertices of all
+    earlier streams (NumStreamVertices[NumLevels - 1][...]). To load and
+    draw level L:
+
+        1. read the file up to VertexDataOffset
+        2. read the first NumStreamVertices[L][s] vertices of each vertex
+           stream s (from each attribute stream), and the first
+           Level[L].NumIndices indices of the index data
+        3. draw each mesh as its slices of levels 0..L, with each index i
+           (relative to the mesh's stream) replaced by Parent[i] until
+           i < NumStreamVertices[L][s], triangles which became degenerate
+           can be dropped
+
+    Refining to level L + 1 only appends vertices and indices, the indices
+    of earlier slices need to be remapped again. At the last level no index
+    is remapped.
+
+    Payload: OrbProgressiveHeader, OrbProgressiveLevel[NumLevels],
+    uint32_t NumStreamVertices[NumLevels][NumStreams],
+    OrbProgressiveSlice[NumLevels][NumMeshes],
+    uint16_t Parent[NumVertices] (padded to 4 bytes)
+*/
+struct OrbProgressiveHeader {
+    uint32_t NumLevels = 0;
+    uint32_t NumMeshes = 0;
+    uint32_t NumStreams = 0;        // 1 without 'MVLY' chunk
+    uint32_t NumVertices = 0;       // vertices of all streams
+};
+
+struct OrbProgressiveLevel {
+    uint32_t NumIndices = 0;        // indices of this and all coarser levels
+    float Error = 0.0f;
+};
+
+struct OrbProgressiveSlice {
+    uint32_t FirstIndex = 0;        // first index in the index data
+    uint32_t NumIndices = 0;
+};
+
+#pragma pack(pop)
+
+} // namespace Oryol
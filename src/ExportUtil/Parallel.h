@@ -0,0 +1,40 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @file ExportUtil/Parallel.h
+    @brief run independent jobs on all hardware threads
+
+    ParallelFor() calls func(i) for each i in [0, num). The jobs are handed
+    out one at a time to min(num, hardware threads) workers, the calling
+    thread is one of them, and it returns when all jobs are done. Jobs
+    shouldn't call Log::FailIf(), but record their errors so that they can
+    be reported after ParallelFor() returns.
+*/
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace OryolTools {
+
+inline void
+ParallelFor(int num, const std::function<void(int)>& func) {
+    const int numThreads = std::min(num, std::max(1, int(std::thread::hardware_concurrency())));
+    std::atomic<int> nextJob(0);
+    auto worker = [num, &func, &nextJob]() {
+        for (int i = nextJob++; i < num; i = nextJob++) {
+            func(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numThreads; i++) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace OryolTools
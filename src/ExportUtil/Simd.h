@@ -0,0 +1,63 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @file ExportUtil/Simd.h
+    @brief minimal 4-wide float SIMD wrapper
+
+    Maps to SSE where available, with a scalar fallback otherwise. The
+    loads and stores are unaligned.
+*/
+#include <math.h>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define ORYOL_TOOLS_SSE (1)
+#include <xmmintrin.h>
+#endif
+
+namespace OryolTools {
+
+#if ORYOL_TOOLS_SSE
+typedef __m128 f4;
+inline f4 f4_load(const float* p) { return _mm_loadu_ps(p); }
+inline void f4_store(float* p, f4 a) { _mm_storeu_ps(p, a); }
+inline f4 f4_splat(float f) { return _mm_set1_ps(f); }
+inline f4 f4_add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+inline f4 f4_sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+inline f4 f4_mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+inline f4 f4_div(f4 a, f4 b) { return _mm_div_ps(a, b); }
+inline f4 f4_min(f4 a, f4 b) { return _mm_min_ps(a, b); }
+inline f4 f4_max(f4 a, f4 b) { return _mm_max_ps(a, b); }
+inline f4 f4_sqrt(f4 a) { return _mm_sqrt_ps(a); }
+// exact 1/sqrt(a), not the _mm_rsqrt_ps() approximation
+inline f4 f4_rsqrt(f4 a) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(a)); }
+// -1.0 where a is negative, otherwise +1.0
+inline f4 f4_sign(f4 a) { return _mm_or_ps(_mm_and_ps(a, _mm_set1_ps(-0.0f)), _mm_set1_ps(1.0f)); }
+inline void f4_transpose(f4& a, f4& b, f4& c, f4& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+#else
+struct f4 { float v[4]; };
+#define F4_OP(expr) f4 r; for (int i = 0; i < 4; i++) { r.v[i] = expr; } return r;
+inline f4 f4_load(const float* p) { F4_OP(p[i]) }
+inline void f4_store(float* p, f4 a) { for (int i = 0; i < 4; i++) { p[i] = a.v[i]; } }
+inline f4 f4_splat(float f) { F4_OP(f) }
+inline f4 f4_add(f4 a, f4 b) { F4_OP(a.v[i] + b.v[i]) }
+inline f4 f4_sub(f4 a, f4 b) { F4_OP(a.v[i] - b.v[i]) }
+inline f4 f4_mul(f4 a, f4 b) { F4_OP(a.v[i] * b.v[i]) }
+inline f4 f4_div(f4 a, f4 b) { F4_OP(a.v[i] / b.v[i]) }
+inline f4 f4_min(f4 a, f4 b) { F4_OP(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline f4 f4_max(f4 a, f4 b) { F4_OP(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline f4 f4_sqrt(f4 a) { F4_OP(sqrtf(a.v[i])) }
+inline f4 f4_rsqrt(f4 a) { F4_OP(1.0f / sqrtf(a.v[i])) }
+inline f4 f4_sign(f4 a) { F4_OP(copysignf(1.0f, a.v[i])) }
+inline void f4_transpose(f4& a, f4& b, f4& c, f4& d) {
+    f4* rows[4] = { &a, &b, &c, &d };
+    for (int i = 0; i < 4; i++) {
+        for (int j = i + 1; j < 4; j++) {
+            const float tmp = rows[i]->v[j];
+            rows[i]->v[j] = rows[j]->v[i];
+            rows[j]->v[i] = tmp;
+        }
+    }
+}
+#undef F4_OP
+#endif
+
+} // namespace OryolTools
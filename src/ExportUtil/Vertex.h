@@ -182,6 +182,8 @@ struct VertexComponent {
     VertexFormat::Code Format = VertexFormat::Invalid;
     float Scale = 1.0f;
     float Bias = 0.0f;
+    /// vertex stream index, each stream is a separate non-interleaved array
+    int Stream = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -239,4 +241,52 @@ public:
         }
         return offset;
     }
+
+    /// get component by attr (must exist)
+    const VertexComponent& AttrComponent(VertexAttr::Code attr) const {
+        for (const auto& comp : this->Components) {
+            if (comp.Attr == attr) {
+                return comp;
+            }
+        }
+        assert(false);
+        return this->Components[0];
+    }
+
+    /// get number of vertex streams (highest stream index + 1)
+    int NumStreams() const {
+        int numStreams = 1;
+        for (const auto& comp : this->Components) {
+            if (comp.Stream >= numStreams) {
+                numStreams = comp.Stream + 1;
+            }
+        }
+        return numStreams;
+    }
+
+    /// compute byte size of one vertex in a stream
+    int StreamByteSize(int stream) const {
+        int size = 0;
+        for (const auto& comp : this->Components) {
+            if (comp.Stream == stream) {
+                size += VertexFormat::ByteSize(comp.Format);
+            }
+        }
+        return size;
+    }
+
+    /// get byte-offset of attr in its stream
+    int StreamOffset(VertexAttr::Code attr) const {
+        int offset = 0;
+        const int stream = this->AttrComponent(attr).Stream;
+        for (const auto& comp : this->Components) {
+            if (comp.Attr == attr) {
+                break;
+            }
+            if (comp.Stream == stream) {
+                offset += VertexFormat::ByteSize(comp.Format);
+            }
+        }
+        return offset;
+    }
 };
@@ -73,6 +73,17 @@ VertexBuffer::GetDataSize() const {
     return size;
 }
 
+//------------------------------------------------------------------------------
+int
+VertexBuffer::GetStreamOffset(int stream) const {
+    assert(this->IsValid());
+    int offset = 0;
+    for (int i = 0; i < stream; i++) {
+        offset += this->allNumVertices * this->layout.StreamByteSize(i);
+    }
+    return offset;
+}
+
 //------------------------------------------------------------------------------
 template<VertexFormat::Code FORMAT> void
 VertexBuffer::write(VertexAttr::Code attr,
@@ -82,8 +93,9 @@ VertexBuffer::write(VertexAttr::Code attr,
                     int numInputComps,
                     int inputStride)
 {
-    const int dstStride = this->layout.ByteSize();
-    const glm::vec4 scale(this->layout.Components[attr].Scale);
+    const VertexComponent& comp = this->layout.AttrComponent(attr);
+    const int dstStride = this->layout.StreamByteSize(comp.Stream);
+    const glm::vec4 scale(comp.Scale);
     for (int i = 0; i < numVerts; i++) {
         VertexCodec::Encode<FORMAT>(dstPtr, scale, input, numInputComps);
         dstPtr += dstStride;
@@ -106,13 +118,14 @@ VertexBuffer::Write(VertexAttr::Code attr,
     assert(nullptr != input);
     assert((numInputComps >= 1) && (numInputComps <= 4));
     assert(inputStride > 0);
-    assert(VertexFormat::Invalid != this->layout.Components[attr].Format);
+    assert(this->layout.HasAttr(attr));
 
-    const int vertexByteSize = this->layout.ByteSize();
-    const int compOffset = this->layout.Offset(attr);
-    uint8_t* ptr = this->buffer + startVertexIndex * vertexByteSize + compOffset;
+    const VertexComponent& comp = this->layout.AttrComponent(attr);
+    const int vertexByteSize = this->layout.StreamByteSize(comp.Stream);
+    const int compOffset = this->layout.StreamOffset(attr);
+    uint8_t* ptr = this->buffer + this->GetStreamOffset(comp.Stream) + startVertexIndex * vertexByteSize + compOffset;
 
-    switch (this->layout.Components[attr].Format) {
+    switch (comp.Format) {
         case VertexFormat::Float:
             this->write<VertexFormat::Float>(attr, ptr, numVertices, input, numInputComps, inputStride);
             break;
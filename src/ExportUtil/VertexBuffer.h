@@ -3,6 +3,9 @@
 /**
     @class VertexBuffer
     @brief holds exported vertex data
+
+    The vertex components of each stream (see VertexComponent::Stream) are
+    interleaved, and the streams are stored one after another.
 */
 #include "ExportUtil/Vertex.h"
 #include <cstdint>
@@ -30,6 +33,8 @@ public:
     const std::uint8_t* GetDataPointer() const;
     /// get size of vertex data in bytes
     int GetDataSize() const;
+    /// get byte offset of a vertex stream in the vertex data (streams are stored one after another)
+    int GetStreamOffset(int stream) const;
 
 private:
     /// internal specialized vertex writer method
@@ -3,6 +3,7 @@
 //------------------------------------------------------------------------------
 #include "VertexCodec.h"
 #include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
 
 //------------------------------------------------------------------------------
 template<> uint8_t*
@@ -242,7 +243,7 @@ VertexCodec::Encode<VertexFormat::Short4>(uint8_t* dst, const glm::vec4& scale,
 //------------------------------------------------------------------------------
 template<> void
 VertexCodec::Decode<VertexFormat::Short4>(float* dst, float scale, float bias, const uint8_t* src, int numSrcComps, int numDstComps) {
-    const int16_t* p = (const int16_t*) dst;
+    const int16_t* p = (const int16_t*) src;
     for (int i = 0; i < 4; i++) {
         if (i < numDstComps) {
             *dst++ = (numSrcComps > i) ? float(p[i]) * scale + bias : 0.0f;
@@ -268,10 +269,94 @@ VertexCodec::Encode<VertexFormat::Short4N>(uint8_t* dst, const glm::vec4& scale,
 template<> void
 VertexCodec::Decode<VertexFormat::Short4N>(float* dst, float scale, float bias, const uint8_t* src, int numSrcComps, int numDstComps) {
     scale /= 32767.0f;
-    const int16_t* p = (const int16_t*) dst;
+    const int16_t* p = (const int16_t*) src;
     for (int i = 0; i < 4; i++) {
         if (i < numDstComps) {
             *dst++ = (numSrcComps > i) ? float(p[i]) * scale + bias : 0.0f;
         }
     }
 }
+
+//------------------------------------------------------------------------------
+uint8_t*
+VertexCodec::Encode(VertexFormat::Code fmt, uint8_t* dst, const glm::vec4& scale, const float* src, int numSrcComps) {
+    switch (fmt) {
+        case VertexFormat::Float:   return Encode<VertexFormat::Float>(dst, scale, src, numSrcComps);
+        case VertexFormat::Float2:  return Encode<VertexFormat::Float2>(dst, scale, src, numSrcComps);
+        case VertexFormat::Float3:  return Encode<VertexFormat::Float3>(dst, scale, src, numSrcComps);
+        case VertexFormat::Float4:  return Encode<VertexFormat::Float4>(dst, scale, src, numSrcComps);
+        case VertexFormat::Byte4:   return Encode<VertexFormat::Byte4>(dst, scale, src, numSrcComps);
+        case VertexFormat::Byte4N:  return Encode<VertexFormat::Byte4N>(dst, scale, src, numSrcComps);
+        case VertexFormat::UByte4:  return Encode<VertexFormat::UByte4>(dst, scale, src, numSrcComps);
+        case VertexFormat::UByte4N: return Encode<VertexFormat::UByte4N>(dst, scale, src, numSrcComps);
+        case VertexFormat::Short2:  return Encode<VertexFormat::Short2>(dst, scale, src, numSrcComps);
+        case VertexFormat::Short2N: return Encode<VertexFormat::Short2N>(dst, scale, src, numSrcComps);
+        case VertexFormat::Short4:  return Encode<VertexFormat::Short4>(dst, scale, src, numSrcComps);
+        case VertexFormat::Short4N: return Encode<VertexFormat::Short4N>(dst, scale, src, numSrcComps);
+        default:                    return dst;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VertexCodec::Decode(VertexFormat::Code fmt, float* dst, float scale, float bias, const uint8_t* src, int numSrcComps, int numDstComps) {
+    switch (fmt) {
+        case VertexFormat::Float:   Decode<VertexFormat::Float>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Float2:  Decode<VertexFormat::Float2>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Float3:  Decode<VertexFormat::Float3>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Float4:  Decode<VertexFormat::Float4>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Byte4:   Decode<VertexFormat::Byte4>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Byte4N:  Decode<VertexFormat::Byte4N>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::UByte4:  Decode<VertexFormat::UByte4>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::UByte4N: Decode<VertexFormat::UByte4N>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Short2:  Decode<VertexFormat::Short2>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Short2N: Decode<VertexFormat::Short2N>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Short4:  Decode<VertexFormat::Short4>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        case VertexFormat::Short4N: Decode<VertexFormat::Short4N>(dst, scale, bias, src, numSrcComps, numDstComps); break;
+        default: break;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    The tangent frame is orthonormalized (Gram-Schmidt on the normal), so
+    only the handedness of the binormal is preserved. Since q and -q are
+    the same rotation, the sign of w holds the handedness, which requires
+    w to be at least the smallest non-zero Short4N value.
+*/
+uint8_t*
+VertexCodec::EncodeQTangent(uint8_t* dst, const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& binormal) {
+    glm::vec3 n = (glm::dot(normal, normal) > 0.0f) ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 t = tangent - n * glm::dot(n, tangent);
+    if (glm::dot(t, t) < 1e-12f) {
+        // degenerate tangent, pick any vector perpendicular to the normal
+        t = glm::cross(n, (glm::abs(n.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    t = glm::normalize(t);
+    const glm::vec3 b = glm::cross(n, t);
+    glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+    if (q.w < 0.0f) {
+        q = glm::quat(-q.w, -q.x, -q.y, -q.z);
+    }
+    const float minW = 1.0f / 32767.0f;
+    if (q.w < minW) {
+        const float s = glm::sqrt(1.0f - minW * minW) / glm::sqrt(q.x * q.x + q.y * q.y + q.z * q.z);
+        q = glm::quat(minW, q.x * s, q.y * s, q.z * s);
+    }
+    if (glm::dot(b, binormal) < 0.0f) {
+        q = glm::quat(-q.w, -q.x, -q.y, -q.z);
+    }
+    const float src[4] = { q.x, q.y, q.z, q.w };
+    return Encode<VertexFormat::Short4N>(dst, glm::vec4(1.0f), src, 4);
+}
+
+//------------------------------------------------------------------------------
+void
+VertexCodec::DecodeQTangent(const uint8_t* src, glm::vec3& outNormal, glm::vec3& outTangent, glm::vec3& outBinormal) {
+    glm::vec4 v;
+    Decode<VertexFormat::Short4N>(&v.x, 1.0f, 0.0f, src, 4, 4);
+    const glm::quat q = glm::normalize(glm::quat(v.w, v.x, v.y, v.z));
+    outNormal = q * glm::vec3(0.0f, 0.0f, 1.0f);
+    outTangent = q * glm::vec3(1.0f, 0.0f, 0.0f);
+    outBinormal = glm::cross(outNormal, outTangent) * ((v.w < 0.0f) ? -1.0f : 1.0f);
+}
@@ -6,6 +6,7 @@
 */
 #include <stdint.h>
 #include "ExportUtil/Vertex.h"
+#include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
 class VertexCodec {
@@ -14,4 +15,12 @@ public:
     template<VertexFormat::Code FORMAT> static uint8_t* Encode(uint8_t* dst, const glm::vec4& scale, const float* src, int numSrcComps);
     /// decode into generic float vertex data
     template<VertexFormat::Code FORMAT> static void Decode(float* dst, float scale, float bias, const uint8_t* src, int numSrcComps, int numDstComps);
+    /// encode from generic float vertex data into a format selected at runtime
+    static uint8_t* Encode(VertexFormat::Code fmt, uint8_t* dst, const glm::vec4& scale, const float* src, int numSrcComps);
+    /// decode from a format selected at runtime into generic float vertex data
+    static void Decode(VertexFormat::Code fmt, float* dst, float scale, float bias, const uint8_t* src, int numSrcComps, int numDstComps);
+    /// encode a tangent frame as quaternion (Short4N, handedness in the sign of w)
+    static uint8_t* EncodeQTangent(uint8_t* dst, const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& binormal);
+    /// decode a quaternion tangent frame
+    static void DecodeQTangent(const uint8_t* src, glm::vec3& outNormal, glm::vec3& outTangent, glm::vec3& outBinormal);
 };
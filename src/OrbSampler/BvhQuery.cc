@@ -0,0 +1,231 @@
+//------------------------------------------------------------------------------
+//  BvhQuery.cc
+//------------------------------------------------------------------------------
+#include "BvhQuery.h"
+#include "ExportUtil/Log.h"
+#include <glm/glm.hpp>
+#include <float.h>
+#include <math.h>
+
+using namespace OryolTools;
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+void
+BvhQuery::Setup(const OrbFile& orb) {
+    this->Header = nullptr;
+    this->Trees = nullptr;
+    this->Nodes = nullptr;
+    this->Triangles = nullptr;
+    this->NumTrees = 0;
+    uint32_t chunkSize = 0;
+    const uint8_t* chunk = orb.FindChunk('TBVH', chunkSize);
+    if (chunk) {
+        Log::FailIf(chunkSize < sizeof(OrbBvhHeader), "Invalid 'TBVH' chunk\n");
+        this->Header = (const OrbBvhHeader*) chunk;
+        this->Trees = (const OrbBvhTree*) (chunk + sizeof(OrbBvhHeader));
+        this->Nodes = (const OrbBvhNode*) (this->Trees + this->Header->NumTrees);
+        this->Triangles = (const OrbBvhTriangle*) (this->Nodes + this->Header->NumNodes);
+        Log::FailIf(chunkSize != (sizeof(OrbBvhHeader) +
+                                  this->Header->NumTrees * sizeof(OrbBvhTree) +
+                                  this->Header->NumNodes * sizeof(OrbBvhNode) +
+                                  this->Header->NumTriangles * sizeof(OrbBvhTriangle)),
+            "Invalid 'TBVH' chunk size\n");
+        this->NumTrees = this->Header->NumTrees;
+    }
+}
+
+//------------------------------------------------------------------------------
+int
+BvhQuery::TreeIndex(int nodeIndex) const {
+    for (int i = 0; i < this->NumTrees; i++) {
+        if (int(this->Trees[i].Node) == nodeIndex) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+void
+BvhQuery::treeQuantization(const OrbBvhTree& tree, glm::vec3& outMin, glm::vec3& outStep) {
+    for (int i = 0; i < 3; i++) {
+        outMin[i] = tree.Min[i];
+        outStep[i] = (tree.Max[i] - tree.Min[i]) / 65535.0f;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+BvhQuery::childBounds(const glm::vec3& treeMin, const glm::vec3& step, const OrbBvhNode& node, int child, glm::vec3& outMin, glm::vec3& outMax) {
+    for (int i = 0; i < 3; i++) {
+        outMin[i] = treeMin[i] + node.ChildMin[child][i] * step[i];
+        outMax[i] = treeMin[i] + node.ChildMax[child][i] * step[i];
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Moeller-Trumbore ray/triangle intersection (double-sided).
+*/
+float
+BvhQuery::intersectTriangle(const OrbBvhTriangle& tri, const glm::vec3& origin, const glm::vec3& dir) {
+    const glm::vec3 v0(tri.Vertex[0][0], tri.Vertex[0][1], tri.Vertex[0][2]);
+    const glm::vec3 e1 = glm::vec3(tri.Vertex[1][0], tri.Vertex[1][1], tri.Vertex[1][2]) - v0;
+    const glm::vec3 e2 = glm::vec3(tri.Vertex[2][0], tri.Vertex[2][1], tri.Vertex[2][2]) - v0;
+    const glm::vec3 p = glm::cross(dir, e2);
+    const float det = glm::dot(e1, p);
+    if (fabsf(det) < 1e-12f) {
+        return -1.0f;
+    }
+    const float invDet = 1.0f / det;
+    const glm::vec3 s = origin - v0;
+    const float u = glm::dot(s, p) * invDet;
+    if ((u < 0.0f) || (u > 1.0f)) {
+        return -1.0f;
+    }
+    const glm::vec3 q = glm::cross(s, e1);
+    const float v = glm::dot(dir, q) * invDet;
+    if ((v < 0.0f) || ((u + v) > 1.0f)) {
+        return -1.0f;
+    }
+    return glm::dot(e2, q) * invDet;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Slab test, return the entry distance or FLT_MAX if the box is missed.
+*/
+static float
+intersectBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& invDir, float maxDistance) {
+    const glm::vec3 t0 = (min - origin) * invDir;
+    const glm::vec3 t1 = (max - origin) * invDir;
+    const glm::vec3 tmin = glm::min(t0, t1);
+    const glm::vec3 tmax = glm::max(t0, t1);
+    const float tnear = glm::max(glm::max(tmin.x, tmin.y), glm::max(tmin.z, 0.0f));
+    const float tfar = glm::min(glm::min(tmax.x, tmax.y), glm::min(tmax.z, maxDistance));
+    return (tnear <= tfar) ? tnear : FLT_MAX;
+}
+
+//------------------------------------------------------------------------------
+bool
+BvhQuery::Raycast(int treeIndex, const glm::vec3& origin, const glm::vec3& dir, float maxDistance, Hit& outHit) const {
+    const OrbBvhTree& tree = this->Trees[treeIndex];
+    const OrbBvhNode* nodes = this->Nodes + tree.FirstNode;
+    const OrbBvhTriangle* tris = this->Triangles + tree.FirstTriangle;
+    glm::vec3 treeMin, step;
+    treeQuantization(tree, treeMin, step);
+    // a zero direction component gives an infinite inverse, which the slab test handles
+    const glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+    struct entry {
+        uint32_t Ref;
+        float Distance;
+    };
+    entry stack[OrbBvhNode::MaxDepth];
+    int stackSize = 0;
+    float best = maxDistance;
+    int bestTriangle = -1;
+    uint32_t nodeIndex = 0;
+    for (;;) {
+        // test the 2 children, descend into the nearer, push the farther
+        const OrbBvhNode& node = nodes[nodeIndex];
+        float dist[2];
+        for (int i = 0; i < 2; i++) {
+            dist[i] = FLT_MAX;
+            const uint32_t ref = node.Child[i];
+            if ((ref & OrbBvhNode::Leaf) && (((ref >> OrbBvhNode::LeafCountShift) & OrbBvhNode::LeafCountMask) == 0)) {
+                continue;
+            }
+            glm::vec3 min, max;
+            childBounds(treeMin, step, node, i, min, max);
+            dist[i] = intersectBox(min, max, origin, invDir, best);
+        }
+        const int nearChild = (dist[1] < dist[0]) ? 1 : 0;
+        const int farChild = 1 - nearChild;
+        if (dist[farChild] < FLT_MAX) {
+            stack[stackSize++] = { node.Child[farChild], dist[farChild] };
+        }
+        if (dist[nearChild] < FLT_MAX) {
+            stack[stackSize++] = { node.Child[nearChild], dist[nearChild] };
+        }
+
+        // pop the next child closer than the best hit, and test leaf triangles
+        nodeIndex = ~0u;
+        while ((stackSize > 0) && (nodeIndex == ~0u)) {
+            const entry e = stack[--stackSize];
+            if (e.Distance >= best) {
+                continue;
+            }
+            if (e.Ref & OrbBvhNode::Leaf) {
+                const int first = e.Ref & OrbBvhNode::LeafFirstMask;
+                const int count = (e.Ref >> OrbBvhNode::LeafCountShift) & OrbBvhNode::LeafCountMask;
+                for (int i = first; i < first + count; i++) {
+                    const float t = intersectTriangle(tris[i], origin, dir);
+                    if ((t >= 0.0f) && (t < best)) {
+                        best = t;
+                        bestTriangle = i;
+                    }
+                }
+            }
+            else {
+                nodeIndex = e.Ref;
+            }
+        }
+        if (nodeIndex == ~0u) {
+            break;
+        }
+    }
+    if (bestTriangle != -1) {
+        outHit.Distance = best;
+        outHit.Triangle = tree.FirstTriangle + bestTriangle;
+        return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+int
+BvhQuery::Overlap(int treeIndex, const glm::vec3& min, const glm::vec3& max, std::vector<int>& outTriangles) const {
+    const OrbBvhTree& tree = this->Trees[treeIndex];
+    const OrbBvhNode* nodes = this->Nodes + tree.FirstNode;
+    const int numBefore = outTriangles.size();
+    glm::vec3 treeMin, step;
+    treeQuantization(tree, treeMin, step);
+    uint32_t stack[OrbBvhNode::MaxDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const OrbBvhNode& node = nodes[stack[--stackSize]];
+        for (int i = 0; i < 2; i++) {
+            glm::vec3 cmin, cmax;
+            childBounds(treeMin, step, node, i, cmin, cmax);
+            if ((cmin.x > max.x) || (cmin.y > max.y) || (cmin.z > max.z) ||
+                (cmax.x < min.x) || (cmax.y < min.y) || (cmax.z < min.z)) {
+                continue;
+            }
+            const uint32_t ref = node.Child[i];
+            if (ref & OrbBvhNode::Leaf) {
+                const int first = ref & OrbBvhNode::LeafFirstMask;
+                const int count = (ref >> OrbBvhNode::LeafCountShift) & OrbBvhNode::LeafCountMask;
+                for (int t = first; t < first + count; t++) {
+                    const OrbBvhTriangle& tri = this->Triangles[tree.FirstTriangle + t];
+                    glm::vec3 tmin(FLT_MAX), tmax(-FLT_MAX);
+                    for (int v = 0; v < 3; v++) {
+                        const glm::vec3 p(tri.Vertex[v][0], tri.Vertex[v][1], tri.Vertex[v][2]);
+                        tmin = glm::min(tmin, p);
+                        tmax = glm::max(tmax, p);
+                    }
+                    if ((tmin.x <= max.x) && (tmin.y <= max.y) && (tmin.z <= max.z) &&
+                        (tmax.x >= min.x) && (tmax.y >= min.y) && (tmax.z >= min.z)) {
+                        outTriangles.push_back(tree.FirstTriangle + t);
+                    }
+                }
+            }
+            else {
+                stack[stackSize++] = ref;
+            }
+        }
+    }
+    return int(outTriangles.size()) - numBefore;
+}
@@ -0,0 +1,44 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class BvhQuery
+    @brief reference raycast and overlap queries on ORB triangle BVHs
+
+    Traverses the trees of the 'TBVH' chunk directly from the file data,
+    the quantized child bounds of a node are dequantized on the fly.
+    Rays visit the nearer child first and skip children beyond the closest
+    hit so far. Queries are in the space of the tree's node.
+*/
+#include <vector>
+#include <glm/vec3.hpp>
+#include "OrbFile.h"
+
+struct BvhQuery {
+    /// setup from an ORB file (must stay valid), without 'TBVH' chunk there are no trees
+    void Setup(const OrbFile& orb);
+    /// get the tree of an ORB node, or -1
+    int TreeIndex(int nodeIndex) const;
+
+    /// a ray hit
+    struct Hit {
+        float Distance = 0.0f;      // in units of the ray direction
+        int Triangle = -1;          // index in Triangles
+    };
+    /// find the closest hit of a ray with distance < maxDistance, return false if none
+    bool Raycast(int treeIndex, const glm::vec3& origin, const glm::vec3& dir, float maxDistance, Hit& outHit) const;
+    /// find the triangles whose bounding boxes overlap a box, return the number of triangles
+    int Overlap(int treeIndex, const glm::vec3& min, const glm::vec3& max, std::vector<int>& outTriangles) const;
+
+    const Oryol::OrbBvhHeader* Header = nullptr;
+    const Oryol::OrbBvhTree* Trees = nullptr;
+    const Oryol::OrbBvhNode* Nodes = nullptr;
+    const Oryol::OrbBvhTriangle* Triangles = nullptr;
+    int NumTrees = 0;
+
+    /// get the min and dequantization step of a tree's child bounds
+    static void treeQuantization(const Oryol::OrbBvhTree& tree, glm::vec3& outMin, glm::vec3& outStep);
+    /// dequantize the child bounds of a node
+    static void childBounds(const glm::vec3& treeMin, const glm::vec3& step, const Oryol::OrbBvhNode& node, int child, glm::vec3& outMin, glm::vec3& outMax);
+    /// intersect a ray with a triangle, return distance or -1
+    static float intersectTriangle(const Oryol::OrbBvhTriangle& tri, const glm::vec3& origin, const glm::vec3& dir);
+};
@@ -0,0 +1,232 @@
+//------------------------------------------------------------------------------
+//  OrbFile.cc
+//------------------------------------------------------------------------------
+#include "OrbFile.h"
+#include "ExportUtil/Log.h"
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace OryolTools;
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+OrbFile::~OrbFile() {
+    this->Unload();
+}
+
+//------------------------------------------------------------------------------
+void
+OrbFile::Unload() {
+    if (this->mappedView) {
+        #if defined(_WIN32)
+        UnmapViewOfFile(this->mappedView);
+        CloseHandle((HANDLE) this->mappingHandle);
+        #else
+        munmap(this->mappedView, this->Size);
+        #endif
+    }
+    this->mappedView = nullptr;
+    this->mappingHandle = nullptr;
+    this->strings.clear();
+    this->buffer.clear();
+    this->buffer.shrink_to_fit();
+    this->Data = nullptr;
+    this->Size = 0;
+    this->Header = nullptr;
+}
+
+//------------------------------------------------------------------------------
+void
+OrbFile::Load(const std::string& path) {
+    this->Unload();
+
+    // map the file read-only, files above 2 GB are rejected below anyway
+    #if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && (fileSize.QuadPart > 0) && (fileSize.QuadPart < 0x80000000LL)) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                this->mappedView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (this->mappedView) {
+                    this->mappingHandle = mapping;
+                    this->Size = uint32_t(fileSize.QuadPart);
+                }
+                else {
+                    CloseHandle(mapping);
+                }
+            }
+        }
+        // the mapping keeps the file open
+        CloseHandle(file);
+    }
+    #else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd != -1) {
+        struct stat st;
+        if ((fstat(fd, &st) == 0) && (st.st_size > 0) && (st.st_size < 0x80000000LL)) {
+            void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                this->mappedView = view;
+                this->Size = uint32_t(st.st_size);
+            }
+        }
+        // the mapping keeps the file open
+        close(fd);
+    }
+    #endif
+    if (this->mappedView) {
+        this->Data = (const uint8_t*) this->mappedView;
+    }
+    else {
+        // fallback: read the whole file into memory
+        FILE* fp = fopen(path.c_str(), "rb");
+        Log::FailIf(!fp, "Failed to open file '%s'\n", path.c_str());
+        fseek(fp, 0, SEEK_END);
+        const int size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        this->buffer.resize(size);
+        const int bytesRead = fread(this->buffer.data(), 1, size, fp);
+        fclose(fp);
+        Log::FailIf(bytesRead != size, "Failed reading file '%s' into memory\n", path.c_str());
+        this->Data = this->buffer.data();
+        this->Size = size;
+    }
+    const int size = this->Size;
+    Log::FailIf(size < int(sizeof(OrbHeader)), "File '%s' is too small\n", path.c_str());
+
+    const uint8_t* ptr = this->Data;
+    this->Header = (const OrbHeader*) ptr;
+    const OrbHeader* hdr = this->Header;
+    Log::FailIf(hdr->Magic != 'ORB1', "Magic number mismatch for '%s'\n", path.c_str());
+    Log::FailIf((hdr->StringPoolDataOffset + hdr->StringPoolDataSize) > uint32_t(size), "Truncated file '%s'\n", path.c_str());
+    this->Bones = (const OrbBone*) (ptr + hdr->BoneOffset);
+    this->AnimKeyComponents = (const OrbAnimKeyComponent*) (ptr + hdr->AnimKeyComponentOffset);
+    this->AnimCurves = (const OrbAnimCurve*) (ptr + hdr->AnimCurveOffset);
+    this->AnimClips = (const OrbAnimClip*) (ptr + hdr->AnimClipOffset);
+    this->AnimKeyData = ptr + hdr->AnimKeyDataOffset;
+
+    // index the string pool
+    this->strings.clear();
+    const char* str = (const char*) (ptr + hdr->StringPoolDataOffset);
+    const char* end = str + hdr->StringPoolDataSize;
+    while (str < end) {
+        this->strings.push_back(str);
+        str += strlen(str) + 1;
+    }
+
+    // anim key layout
+    uint32_t chunkSize = 0;
+    this->KeyLayout = OrbAnimKeyLayout();
+    this->KeySegments = nullptr;
+    this->ClipFirstSegment.clear();
+    const uint8_t* chunk = this->FindChunk('AKLY', chunkSize);
+    if (chunk) {
+        Log::FailIf(chunkSize < sizeof(OrbAnimKeyLayout), "Invalid 'AKLY' chunk\n");
+        memcpy(&this->KeyLayout, chunk, sizeof(OrbAnimKeyLayout));
+        this->KeySegments = (const OrbAnimKeySegment*) (chunk + sizeof(OrbAnimKeyLayout));
+        Log::FailIf(chunkSize < (sizeof(OrbAnimKeyLayout) + this->KeyLayout.NumSegments * sizeof(OrbAnimKeySegment)),
+            "Invalid 'AKLY' chunk\n");
+        if (this->KeyLayout.Layout == OrbAnimKeyLayout::Segmented) {
+            Log::FailIf(this->KeyLayout.SegmentLength == 0, "Invalid 'AKLY' segment length\n");
+            int segIndex = 0;
+            for (uint32_t clipIndex = 0; clipIndex < hdr->NumAnimClips; clipIndex++) {
+                this->ClipFirstSegment.push_back(segIndex);
+                const uint32_t len = this->AnimClips[clipIndex].Length;
+                segIndex += (len + this->KeyLayout.SegmentLength - 1) / this->KeyLayout.SegmentLength;
+            }
+            Log::FailIf(segIndex != int(this->KeyLayout.NumSegments), "Invalid 'AKLY' segment count\n");
+        }
+    }
+
+    // bit-packed anim keys
+    this->PackedHeader = nullptr;
+    this->PackedClips = nullptr;
+    this->PackedComponents = nullptr;
+    chunk = this->FindChunk('AKBP', chunkSize);
+    if (chunk) {
+        this->PackedHeader = (const OrbPackedAnimHeader*) chunk;
+        this->PackedClips = (const OrbPackedAnimClip*) (chunk + sizeof(OrbPackedAnimHeader));
+        this->PackedComponents = (const OrbPackedAnimComponent*) (this->PackedClips + this->PackedHeader->NumClips);
+        Log::FailIf(chunkSize != (sizeof(OrbPackedAnimHeader) +
+                                  this->PackedHeader->NumClips * sizeof(OrbPackedAnimClip) +
+                                  this->PackedHeader->NumComponents * sizeof(OrbPackedAnimComponent)),
+            "Invalid 'AKBP' chunk\n");
+    }
+
+    // sorted hierarchy and inverse bind matrices
+    this->HierarchySorted = this->FindChunk('HIER', chunkSize) != nullptr;
+    this->InverseBindMatrices = (const float*) this->FindChunk('BIBM', chunkSize);
+    Log::FailIf(this->InverseBindMatrices && (chunkSize != hdr->NumBones * 16 * sizeof(float)), "Invalid 'BIBM' chunk\n");
+
+    // skeleton LOD levels
+    this->BoneLod = (const OrbBoneLod*) this->FindChunk('BLOD', chunkSize);
+    this->BoneLodNumBones = nullptr;
+    this->BoneLodRemap = nullptr;
+    if (this->BoneLod) {
+        this->BoneLodNumBones = (const uint32_t*) (this->BoneLod + 1);
+        this->BoneLodRemap = this->BoneLodNumBones + this->BoneLod->NumLevels;
+        Log::FailIf(chunkSize != (sizeof(OrbBoneLod) + this->BoneLod->NumLevels * (1 + this->BoneLod->NumBones) * sizeof(uint32_t)),
+            "Invalid 'BLOD' chunk\n");
+    }
+}
+
+//------------------------------------------------------------------------------
+static const uint8_t*
+findChunk(const uint8_t* data, uint32_t offset, uint32_t end, uint32_t tag, uint32_t& outSize) {
+    while ((offset + sizeof(OrbChunkHeader)) <= end) {
+        OrbChunkHeader chunkHdr;
+        memcpy(&chunkHdr, &data[offset], sizeof(chunkHdr));
+        offset += sizeof(chunkHdr);
+        Log::FailIf((offset + chunkHdr.Size) > end, "Truncated ORB chunk\n");
+        if (chunkHdr.Tag == tag) {
+            outSize = chunkHdr.Size;
+            return &data[offset];
+        }
+        offset += chunkHdr.Size;
+    }
+    outSize = 0;
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+const uint8_t*
+OrbFile::FindChunk(uint32_t tag, uint32_t& outSize) const {
+    // extension chunks are in front of the vertex data after the anim clip
+    // table, or start at the next 4-byte aligned offset after the string pool
+    const uint32_t frontOffset = this->Header->AnimClipOffset + this->Header->NumAnimClips * sizeof(OrbAnimClip);
+    const uint8_t* chunk = findChunk(this->Data, frontOffset, this->Header->VertexDataOffset, tag, outSize);
+    if (!chunk) {
+        const uint32_t offset = (this->Header->StringPoolDataOffset + this->Header->StringPoolDataSize + 3) & ~3;
+        chunk = findChunk(this->Data, offset, this->Size, tag, outSize);
+    }
+    return chunk;
+}
+
+//------------------------------------------------------------------------------
+const char*
+OrbFile::String(uint32_t index) const {
+    Log::FailIf(index >= this->strings.size(), "Invalid string index %d\n", index);
+    return this->strings[index];
+}
+
+//------------------------------------------------------------------------------
+int
+OrbFile::ClipIndex(const std::string& name) const {
+    for (uint32_t i = 0; i < this->Header->NumAnimClips; i++) {
+        if (name == this->String(this->AnimClips[i].Name)) {
+            return int(i);
+        }
+    }
+    return -1;
+}
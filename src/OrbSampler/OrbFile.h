@@ -0,0 +1,74 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class OrbFile
+    @brief map an ORB file into memory and provide access to its sections
+
+    The file is memory-mapped read-only (mmap or MapViewOfFile), so only
+    the pages which are actually touched are read from disk. If the file
+    can't be mapped, it is read into memory instead. All pointers point
+    into the file data, and stay valid until the OrbFile is destroyed or
+    another file is loaded. The anim key data is
+    described by the anim key layout ('AKLY' chunk) and packed key ('AKBP'
+    chunk) extensions, see OrbChunkFormat.h.
+*/
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "OrbFileFormat.h"
+#include "ExportUtil/OrbChunkFormat.h"
+
+struct OrbFile {
+    OrbFile() = default;
+    OrbFile(const OrbFile&) = delete;
+    OrbFile& operator=(const OrbFile&) = delete;
+    ~OrbFile();
+
+    /// map an ORB file (or read it if it can't be mapped)
+    void Load(const std::string& path);
+    /// unmap or free the file data
+    void Unload();
+    /// find an extension chunk by tag, returns payload pointer or nullptr
+    const uint8_t* FindChunk(uint32_t tag, uint32_t& outSize) const;
+    /// get a string from the string pool
+    const char* String(uint32_t index) const;
+    /// find a clip by name, returns -1 if not found
+    int ClipIndex(const std::string& name) const;
+
+    /// the file data, and its size in bytes
+    const uint8_t* Data = nullptr;
+    uint32_t Size = 0;
+    const Oryol::OrbHeader* Header = nullptr;
+    const Oryol::OrbBone* Bones = nullptr;
+    const Oryol::OrbAnimKeyComponent* AnimKeyComponents = nullptr;
+    const Oryol::OrbAnimCurve* AnimCurves = nullptr;
+    const Oryol::OrbAnimClip* AnimClips = nullptr;
+    const uint8_t* AnimKeyData = nullptr;
+
+    /// 16-bit anim key layout
+    Oryol::OrbAnimKeyLayout KeyLayout;
+    const Oryol::OrbAnimKeySegment* KeySegments = nullptr;
+    /// index of the first key segment of each clip (Segmented layout)
+    std::vector<int> ClipFirstSegment;
+
+    /// bit-packed anim keys (only if the file has an 'AKBP' chunk)
+    const Oryol::OrbPackedAnimHeader* PackedHeader = nullptr;
+    const Oryol::OrbPackedAnimClip* PackedClips = nullptr;
+    const Oryol::OrbPackedAnimComponent* PackedComponents = nullptr;
+
+    /// true if bones and nodes are sorted parents-first ('HIER' chunk)
+    bool HierarchySorted = false;
+    /// inverse bind matrices, 16 floats per bone (only if the file has a 'BIBM' chunk)
+    const float* InverseBindMatrices = nullptr;
+    /// skeleton LOD levels (only if the file has a 'BLOD' chunk)
+    const Oryol::OrbBoneLod* BoneLod = nullptr;
+    const uint32_t* BoneLodNumBones = nullptr;
+    const uint32_t* BoneLodRemap = nullptr;
+
+    std::vector<const char*> strings;
+    /// the file data if it couldn't be mapped
+    std::vector<uint8_t> buffer;
+    /// the mapped file view, and the file mapping object on Windows
+    void* mappedView = nullptr;
+    void* mappingHandle = nullptr;
+};
@@ -0,0 +1,312 @@
+//------------------------------------------------------------------------------
+//  PoseSampler.cc
+//------------------------------------------------------------------------------
+#include "PoseSampler.h"
+#include "ExportUtil/Log.h"
+#include "ExportUtil/Simd.h"
+#include <string.h>
+#include <math.h>
+
+using namespace OryolTools;
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+static int
+numKeyComponents(uint32_t keyFormat) {
+    switch (keyFormat) {
+        case OrbAnimKeyFormat::Float:       return 1;
+        case OrbAnimKeyFormat::Float2:      return 2;
+        case OrbAnimKeyFormat::Float3:      return 3;
+        case OrbAnimKeyFormat::Float4:      return 4;
+        case OrbAnimKeyFormat::Quaternion:  return 4;
+        default:                            return 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+PoseSampler::Setup(const OrbFile& orbFile) {
+    this->orb = &orbFile;
+    const OrbHeader* hdr = orbFile.Header;
+    this->NumBones = hdr->NumBones;
+    this->NumSlots = (this->NumBones + 3) & ~3;
+    Log::FailIf(hdr->NumAnimKeyComponents != uint32_t(this->NumBones * 3),
+        "PoseSampler: expected a translate, rotate and scale curve per bone\n");
+    for (int i = 0; i < int(hdr->NumAnimKeyComponents); i++) {
+        const int expected = ((i % 3) == 1) ? 4 : 3;
+        Log::FailIf(numKeyComponents(orbFile.AnimKeyComponents[i].KeyFormat) != expected,
+            "PoseSampler: unexpected anim key format\n");
+    }
+
+    // the key stride of interleaved 16-bit keys
+    this->clipStrides.clear();
+    for (int clipIndex = 0; clipIndex < int(hdr->NumAnimClips); clipIndex++) {
+        const OrbAnimClip& clip = orbFile.AnimClips[clipIndex];
+        int stride = 0;
+        for (uint32_t i = 0; i < clip.NumCurves; i++) {
+            if (orbFile.AnimCurves[clip.FirstCurve + i].KeyOffset >= 0) {
+                stride += numKeyComponents(orbFile.AnimKeyComponents[i].KeyFormat);
+            }
+        }
+        this->clipStrides.push_back(stride);
+    }
+
+    // bone evaluation order, parents before children, this is the
+    // bone order if the hierarchy is sorted
+    this->boneOrder.clear();
+    std::vector<bool> done(this->NumBones, false);
+    if (orbFile.HierarchySorted) {
+        for (int i = 0; i < this->NumBones; i++) {
+            Log::FailIf(orbFile.Bones[i].Parent >= i, "PoseSampler: bone hierarchy not sorted\n");
+            this->boneOrder.push_back(i);
+        }
+    }
+    while (int(this->boneOrder.size()) < this->NumBones) {
+        const int numOrdered = this->boneOrder.size();
+        for (int i = 0; i < this->NumBones; i++) {
+            const int parent = orbFile.Bones[i].Parent;
+            if (!done[i] && ((parent < 0) || done[parent])) {
+                done[i] = true;
+                this->boneOrder.push_back(i);
+            }
+        }
+        Log::FailIf(numOrdered == int(this->boneOrder.size()), "PoseSampler: cycle in bone hierarchy\n");
+    }
+
+    // the padding slots get an identity pose
+    this->Pose.assign(NumPoseComponents * this->NumSlots, 0.0f);
+    this->key0.assign(NumPoseComponents * this->NumSlots, 0.0f);
+    this->key1.assign(NumPoseComponents * this->NumSlots, 0.0f);
+    this->keyScale.assign(NumPoseComponents * this->NumSlots, 0.0f);
+    for (int slot = this->NumBones; slot < this->NumSlots; slot++) {
+        for (float* keys : { this->key0.data(), this->key1.data() }) {
+            keys[(RotateX + 3) * this->NumSlots + slot] = 1.0f;
+            for (int i = 0; i < 3; i++) {
+                keys[(ScaleX + i) * this->NumSlots + slot] = 1.0f;
+            }
+        }
+    }
+    this->local.assign(NumMatrixComponents * this->NumSlots, 0.0f);
+    this->ModelMatrices.assign(this->NumBones, glm::mat4(1.0f));
+    this->SetLodLevel(0);
+}
+
+//------------------------------------------------------------------------------
+void
+PoseSampler::SetLodLevel(int level) {
+    // skeleton LOD levels are prefixes of the bones, and since the bones
+    // are also sorted parents-first, the bone order is the identity
+    if (this->orb->BoneLod && (level > 0)) {
+        Log::FailIf(uint32_t(level) >= this->orb->BoneLod->NumLevels, "PoseSampler: invalid LOD level\n");
+        Log::FailIf(!this->orb->HierarchySorted, "PoseSampler: LOD levels need a sorted bone hierarchy\n");
+        this->NumActiveBones = this->orb->BoneLodNumBones[level];
+    }
+    else {
+        this->NumActiveBones = this->NumBones;
+    }
+    this->numActiveSlots = (this->NumActiveBones + 3) & ~3;
+}
+
+//------------------------------------------------------------------------------
+const int16_t*
+PoseSampler::key16(int clipIndex, int curveIndex, int keyIndex) const {
+    const OrbAnimCurve& curve = this->orb->AnimCurves[this->orb->AnimClips[clipIndex].FirstCurve + curveIndex];
+    const int16_t* keys = (const int16_t*) this->orb->AnimKeyData;
+    const int numComps = numKeyComponents(this->orb->AnimKeyComponents[curveIndex].KeyFormat);
+    switch (this->orb->KeyLayout.Layout) {
+        case OrbAnimKeyLayout::Interleaved:
+            return keys + curve.KeyOffset + keyIndex * this->clipStrides[clipIndex];
+        case OrbAnimKeyLayout::Contiguous:
+            return keys + curve.KeyOffset + keyIndex * numComps;
+        default:
+            {
+                const int segLength = this->orb->KeyLayout.SegmentLength;
+                const OrbAnimKeySegment& seg = this->orb->KeySegments[this->orb->ClipFirstSegment[clipIndex] + keyIndex / segLength];
+                return keys + seg.KeyDataOffset + curve.KeyOffset * seg.NumKeys + (keyIndex - seg.FirstKey) * numComps;
+            }
+    }
+}
+
+//------------------------------------------------------------------------------
+float
+PoseSampler::packedKey(int clipIndex, int component, int keyIndex) const {
+    const OrbPackedAnimClip& clip = this->orb->PackedClips[clipIndex];
+    const OrbPackedAnimComponent& comp = this->orb->PackedComponents[clip.FirstComponent + component];
+    const uint8_t* frame = this->orb->AnimKeyData + clip.KeyDataOffset + keyIndex * clip.KeyStride;
+    uint32_t word;
+    memcpy(&word, frame + (comp.BitOffset >> 3), sizeof(word));
+    return comp.Min + float((word >> (comp.BitOffset & 7)) & ((1u << comp.Bits) - 1)) * comp.Scale;
+}
+
+//------------------------------------------------------------------------------
+void
+PoseSampler::gatherKeys(int clipIndex, int keyIndex0, int keyIndex1) {
+    // this is the scalar part, the keys of each curve live in different
+    // places, so they are gathered into structure-of-arrays rows first
+    static const int poseComponent[3] = { TranslateX, RotateX, ScaleX };
+    const OrbAnimClip& clip = this->orb->AnimClips[clipIndex];
+    const bool packed = (this->orb->PackedHeader != nullptr);
+    const int numSlots = this->NumSlots;
+    for (int bone = 0; bone < this->NumActiveBones; bone++) {
+        for (int j = 0; j < 3; j++) {
+            const int curveIndex = bone * 3 + j;
+            const OrbAnimCurve& curve = this->orb->AnimCurves[clip.FirstCurve + curveIndex];
+            const int numComps = (j == 1) ? 4 : 3;
+            float* k0 = &this->key0[poseComponent[j] * numSlots + bone];
+            float* k1 = &this->key1[poseComponent[j] * numSlots + bone];
+            float* scale = &this->keyScale[poseComponent[j] * numSlots + bone];
+            if (curve.KeyOffset < 0) {
+                for (int i = 0; i < numComps; i++) {
+                    k0[i * numSlots] = k1[i * numSlots] = curve.StaticKey[i];
+                    scale[i * numSlots] = 1.0f;
+                }
+            }
+            else if (packed) {
+                for (int i = 0; i < numComps; i++) {
+                    k0[i * numSlots] = this->packedKey(clipIndex, curve.KeyOffset + i, keyIndex0);
+                    k1[i * numSlots] = this->packedKey(clipIndex, curve.KeyOffset + i, keyIndex1);
+                    scale[i * numSlots] = 1.0f;
+                }
+            }
+            else {
+                const int16_t* src0 = this->key16(clipIndex, curveIndex, keyIndex0);
+                const int16_t* src1 = this->key16(clipIndex, curveIndex, keyIndex1);
+                for (int i = 0; i < numComps; i++) {
+                    k0[i * numSlots] = float(src0[i]);
+                    k1[i * numSlots] = float(src1[i]);
+                    scale[i * numSlots] = curve.Magnitude[i] * (1.0f / 32767.0f);
+                }
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+PoseSampler::Sample(int clipIndex, float time) {
+    Log::FailIf((clipIndex < 0) || (clipIndex >= int(this->orb->Header->NumAnimClips)), "PoseSampler: invalid clip index\n");
+    const OrbAnimClip& clip = this->orb->AnimClips[clipIndex];
+    Log::FailIf((clip.Length == 0) || (clip.KeyDuration <= 0.0f), "PoseSampler: empty clip\n");
+
+    // find the 2 keys to interpolate between
+    float pos = time / clip.KeyDuration;
+    pos -= floorf(pos / clip.Length) * clip.Length;
+    const int keyIndex0 = int(pos) % clip.Length;
+    const int keyIndex1 = (keyIndex0 + 1) % clip.Length;
+    this->gatherKeys(clipIndex, keyIndex0, keyIndex1);
+
+    // dequantize and interpolate, 4 bones at a time
+    const int n = this->NumSlots;
+    const f4 t = f4_splat(pos - floorf(pos));
+    const float* k0 = this->key0.data();
+    const float* k1 = this->key1.data();
+    const float* s = this->keyScale.data();
+    float* dst = this->Pose.data();
+    for (int b = 0; b < this->numActiveSlots; b += 4) {
+        // translation and scale: lerp
+        static const int lerpComponents[6] = {
+            TranslateX, TranslateX + 1, TranslateX + 2, ScaleX, ScaleX + 1, ScaleX + 2
+        };
+        for (int c : lerpComponents) {
+            const int i = c * n + b;
+            const f4 v0 = f4_mul(f4_load(k0 + i), f4_load(s + i));
+            const f4 v1 = f4_mul(f4_load(k1 + i), f4_load(s + i));
+            f4_store(dst + i, f4_add(v0, f4_mul(f4_sub(v1, v0), t)));
+        }
+
+        // rotation: nlerp along the shortest path
+        f4 q0[4], q1[4];
+        for (int c = 0; c < 4; c++) {
+            const int i = (RotateX + c) * n + b;
+            q0[c] = f4_mul(f4_load(k0 + i), f4_load(s + i));
+            q1[c] = f4_mul(f4_load(k1 + i), f4_load(s + i));
+        }
+        f4 dot = f4_mul(q0[0], q1[0]);
+        for (int c = 1; c < 4; c++) {
+            dot = f4_add(dot, f4_mul(q0[c], q1[c]));
+        }
+        const f4 sign = f4_sign(dot);
+        f4 q[4];
+        f4 len2 = f4_splat(0.0f);
+        for (int c = 0; c < 4; c++) {
+            q[c] = f4_add(q0[c], f4_mul(f4_sub(f4_mul(q1[c], sign), q0[c]), t));
+            len2 = f4_add(len2, f4_mul(q[c], q[c]));
+        }
+        const f4 len = f4_max(f4_sqrt(len2), f4_splat(1e-12f));
+        for (int c = 0; c < 4; c++) {
+            f4_store(dst + (RotateX + c) * n + b, f4_div(q[c], len));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+PoseSampler::ComputeModelMatrices() {
+    // local matrices (translate * rotate * scale, upper 3 rows of
+    // a column-major matrix), 4 bones at a time
+    const int n = this->NumSlots;
+    const float* p = this->Pose.data();
+    float* m = this->local.data();
+    const f4 one = f4_splat(1.0f);
+    const f4 two = f4_splat(2.0f);
+    for (int b = 0; b < this->numActiveSlots; b += 4) {
+        const f4 x = f4_load(p + (RotateX + 0) * n + b);
+        const f4 y = f4_load(p + (RotateX + 1) * n + b);
+        const f4 z = f4_load(p + (RotateX + 2) * n + b);
+        const f4 w = f4_load(p + (RotateX + 3) * n + b);
+        const f4 sx = f4_load(p + (ScaleX + 0) * n + b);
+        const f4 sy = f4_load(p + (ScaleX + 1) * n + b);
+        const f4 sz = f4_load(p + (ScaleX + 2) * n + b);
+        const f4 xx = f4_mul(x, x), yy = f4_mul(y, y), zz = f4_mul(z, z);
+        const f4 xy = f4_mul(x, y), xz = f4_mul(x, z), yz = f4_mul(y, z);
+        const f4 wx = f4_mul(w, x), wy = f4_mul(w, y), wz = f4_mul(w, z);
+        // column 0
+        f4_store(m + 0 * n + b, f4_mul(f4_sub(one, f4_mul(two, f4_add(yy, zz))), sx));
+        f4_store(m + 1 * n + b, f4_mul(f4_mul(two, f4_add(xy, wz)), sx));
+        f4_store(m + 2 * n + b, f4_mul(f4_mul(two, f4_sub(xz, wy)), sx));
+        // column 1
+        f4_store(m + 3 * n + b, f4_mul(f4_mul(two, f4_sub(xy, wz)), sy));
+        f4_store(m + 4 * n + b, f4_mul(f4_sub(one, f4_mul(two, f4_add(xx, zz))), sy));
+        f4_store(m + 5 * n + b, f4_mul(f4_mul(two, f4_add(yz, wx)), sy));
+        // column 2
+        f4_store(m + 6 * n + b, f4_mul(f4_mul(two, f4_add(xz, wy)), sz));
+        f4_store(m + 7 * n + b, f4_mul(f4_mul(two, f4_sub(yz, wx)), sz));
+        f4_store(m + 8 * n + b, f4_mul(f4_sub(one, f4_mul(two, f4_add(xx, yy))), sz));
+        // column 3
+        for (int i = 0; i < 3; i++) {
+            f4_store(m + (9 + i) * n + b, f4_load(p + (TranslateX + i) * n + b));
+        }
+    }
+
+    // concatenate along the hierarchy, parents are always done before children,
+    // each column of the result is a linear combination of the parent's columns
+    for (int i = 0; i < this->NumActiveBones; i++) {
+        const int bone = this->boneOrder[i];
+        float* dst = &this->ModelMatrices[bone][0][0];
+        const int parent = this->orb->Bones[bone].Parent;
+        if (parent < 0) {
+            for (int col = 0; col < 4; col++) {
+                for (int row = 0; row < 3; row++) {
+                    dst[col * 4 + row] = m[(col * 3 + row) * n + bone];
+                }
+                dst[col * 4 + 3] = (col == 3) ? 1.0f : 0.0f;
+            }
+        }
+        else {
+            const float* src = &this->ModelMatrices[parent][0][0];
+            const f4 p0 = f4_load(src + 0);
+            const f4 p1 = f4_load(src + 4);
+            const f4 p2 = f4_load(src + 8);
+            const f4 p3 = f4_load(src + 12);
+            for (int col = 0; col < 4; col++) {
+                f4 c = f4_mul(p0, f4_splat(m[(col * 3 + 0) * n + bone]));
+                c = f4_add(c, f4_mul(p1, f4_splat(m[(col * 3 + 1) * n + bone])));
+                c = f4_add(c, f4_mul(p2, f4_splat(m[(col * 3 + 2) * n + bone])));
+                if (col == 3) {
+                    c = f4_add(c, p3);
+                }
+                f4_store(dst + col * 4, c);
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class PoseSampler
+    @brief reference skeletal pose sampler for ORB anim data
+
+    Samples all bones of a clip at a point in time, dequantizes the keys
+    (16-bit keys scaled by the curve Magnitude, or bit-packed keys),
+    interpolates translation and scale linearly and rotations with nlerp,
+    and computes local-to-model matrices along the bone hierarchy.
+    With a skeleton LOD level set, only the first bones are sampled, the
+    model matrices of the other bones are not updated.
+
+    Interpolation and local matrix setup work on structure-of-arrays data
+    and process 4 bones at a time with SSE (with a scalar fallback).
+
+    Expects character anim data with a translate, rotate and scale curve
+    per bone (in this order).
+*/
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include "OrbFile.h"
+
+struct PoseSampler {
+    /// setup the sampler for an ORB file (must stay valid)
+    void Setup(const OrbFile& orb);
+    /// sample the local bone pose of a clip at a time in seconds (looping)
+    void Sample(int clipIndex, float time);
+    /// compute the model-space bone matrices from the sampled pose
+    void ComputeModelMatrices();
+    /// only sample the bones of a skeleton LOD level ('BLOD' chunk), level 0 is all bones
+    void SetLodLevel(int level);
+
+    /// number of bones
+    int NumBones = 0;
+    /// number of bones rounded up to a multiple of 4
+    int NumSlots = 0;
+    /// number of bones sampled in the current LOD level
+    int NumActiveBones = 0;
+    /// sampled local pose, NumSlots floats per component (tx,ty,tz,qx,qy,qz,qw,sx,sy,sz)
+    std::vector<float> Pose;
+    /// local-to-model matrices of all bones
+    std::vector<glm::mat4> ModelMatrices;
+
+    /// pose components
+    enum {
+        TranslateX = 0,
+        RotateX = 3,
+        ScaleX = 7,
+        NumPoseComponents = 10,
+        NumMatrixComponents = 12,
+    };
+
+    /// gather the 2 keys to interpolate between, and their dequantization scale
+    void gatherKeys(int clipIndex, int key0, int key1);
+    /// get pointer to a 16-bit key
+    const int16_t* key16(int clipIndex, int curveIndex, int keyIndex) const;
+    /// unpack a bit-packed key component
+    float packedKey(int clipIndex, int component, int keyIndex) const;
+
+    const OrbFile* orb = nullptr;
+    int numActiveSlots = 0;
+    std::vector<int> clipStrides;
+    std::vector<int> boneOrder;
+    std::vector<float> key0;
+    std::vector<float> key1;
+    std::vector<float> keyScale;
+    std::vector<float> local;
+};
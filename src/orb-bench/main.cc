@@ -0,0 +1,168 @@
+//------------------------------------------------------------------------------
+//  orb-bench/main.cc
+//  Benchmark sampling the anim data in ORB files with the reference
+//  pose sampler, or raycasts against the triangle BVHs.
+//------------------------------------------------------------------------------
+#include "ExportUtil/CmdLineArgs.h"
+#include "ExportUtil/Log.h"
+#include "OrbSampler/OrbFile.h"
+#include "OrbSampler/PoseSampler.h"
+#include "OrbSampler/BvhQuery.h"
+#include <chrono>
+#include <stdlib.h>
+#include <random>
+#include <math.h>
+#include <glm/glm.hpp>
+
+using namespace OryolTools;
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+static double
+elapsedNs(std::chrono::high_resolution_clock::time_point start) {
+    auto dur = std::chrono::high_resolution_clock::now() - start;
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count();
+}
+
+//------------------------------------------------------------------------------
+static const char*
+keyEncodingName(const OrbFile& orb) {
+    if (orb.PackedHeader) {
+        return "bit-packed";
+    }
+    switch (orb.KeyLayout.Layout) {
+        case OrbAnimKeyLayout::Interleaved: return "16-bit interleaved";
+        case OrbAnimKeyLayout::Contiguous:  return "16-bit contiguous";
+        default:                            return "16-bit segmented";
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Cast random rays at each triangle BVH, from points on a sphere around
+    the tree bounds towards random points inside the bounds.
+*/
+static void
+benchRays(const OrbFile& orb, const std::string& inFile, int numRays) {
+    BvhQuery query;
+    query.Setup(orb);
+    Log::FailIf(query.NumTrees == 0, "'%s' has no triangle BVH (convert with -bvh)\n", inFile.c_str());
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> uni(0.0f, 1.0f);
+    double totalNs = 0.0;
+    int numHits = 0;
+    float checkSum = 0.0f;
+    std::vector<glm::vec3> origins(numRays), dirs(numRays);
+    for (int treeIndex = 0; treeIndex < query.NumTrees; treeIndex++) {
+        const OrbBvhTree& tree = query.Trees[treeIndex];
+        const glm::vec3 min(tree.Min[0], tree.Min[1], tree.Min[2]);
+        const glm::vec3 max(tree.Max[0], tree.Max[1], tree.Max[2]);
+        const glm::vec3 center = (min + max) * 0.5f;
+        const float radius = glm::length(max - min);
+        for (int i = 0; i < numRays; i++) {
+            const float z = uni(rng) * 2.0f - 1.0f;
+            const float a = uni(rng) * 6.2831853f;
+            const float r = sqrtf(1.0f - z * z);
+            origins[i] = center + glm::vec3(r * cosf(a), r * sinf(a), z) * radius;
+            const glm::vec3 target = min + (max - min) * glm::vec3(uni(rng), uni(rng), uni(rng));
+            dirs[i] = glm::normalize(target - origins[i]);
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < numRays; i++) {
+            BvhQuery::Hit hit;
+            if (query.Raycast(treeIndex, origins[i], dirs[i], 1.0e30f, hit)) {
+                numHits++;
+                checkSum += hit.Distance;
+            }
+        }
+        totalNs += elapsedNs(start);
+    }
+    const double numAllRays = double(numRays) * query.NumTrees;
+    Log::Info("%s: %d trees, %d nodes, %d triangles, %d rays per tree (checksum %f)\n",
+        inFile.c_str(), query.NumTrees, query.Header->NumNodes, query.Header->NumTriangles, numRays, checkSum);
+    Log::Info("  raycast: %.2f ns/ray, %.2f Mrays/s, %.1f%% hits\n", totalNs / numAllRays,
+        (numAllRays * 1000.0) / totalNs, (100.0 * numHits) / numAllRays);
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, const char** argv) {
+    CmdLineArgs args;
+    args.AddBool("-help", "show help");
+    args.AddString("-in", "input .orb file", "");
+    args.AddString("-clip", "only sample this clip (default: all clips)", "");
+    args.AddString("-samples", "number of samples per clip", "1000");
+    args.AddString("-lod", "skeleton LOD level (default: 0, all bones)", "0");
+    args.AddString("-rays", "benchmark this number of raycasts per triangle BVH instead of anim sampling", "");
+    if (!args.Parse(argc, argv)) {
+        Log::Fatal("Failed to parse args\n");
+    }
+    if (args.HasArg("-help")) {
+        Log::Info("Oryol ORB anim sampling and raycast benchmark\n");
+        args.ShowHelp();
+        return 0;
+    }
+    const std::string inFile = args.GetString("-in");
+    Log::FailIf(inFile.empty(), "no input file provided (-in)\n");
+    const int numSamples = atoi(args.GetString("-samples").c_str());
+    Log::FailIf(numSamples <= 0, "-samples must be > 0\n");
+
+    OrbFile orb;
+    orb.Load(inFile);
+    if (args.HasArg("-rays")) {
+        const int numRays = atoi(args.GetString("-rays").c_str());
+        Log::FailIf(numRays <= 0, "-rays must be > 0\n");
+        benchRays(orb, inFile, numRays);
+        return 0;
+    }
+    Log::FailIf(orb.Header->NumAnimClips == 0, "'%s' has no anim clips\n", inFile.c_str());
+    std::vector<int> clips;
+    if (args.GetString("-clip").empty()) {
+        for (int i = 0; i < int(orb.Header->NumAnimClips); i++) {
+            clips.push_back(i);
+        }
+    }
+    else {
+        const int clipIndex = orb.ClipIndex(args.GetString("-clip"));
+        Log::FailIf(clipIndex < 0, "clip '%s' not found\n", args.GetString("-clip").c_str());
+        clips.push_back(clipIndex);
+    }
+
+    PoseSampler sampler;
+    sampler.Setup(orb);
+    sampler.SetLodLevel(atoi(args.GetString("-lod").c_str()));
+
+    // sample each clip at evenly spaced times over its whole length (the
+    // sample times don't fall onto keys), first only the local pose, then
+    // including the model matrices
+    double sampleNs = 0.0;
+    double totalNs = 0.0;
+    float checkSum = 0.0f;
+    for (int clipIndex : clips) {
+        const OrbAnimClip& clip = orb.AnimClips[clipIndex];
+        const float duration = clip.KeyDuration * clip.Length;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < numSamples; i++) {
+            sampler.Sample(clipIndex, (duration * (i + 0.37f)) / numSamples);
+            checkSum += sampler.Pose[i % sampler.Pose.size()];
+        }
+        sampleNs += elapsedNs(start);
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < numSamples; i++) {
+            sampler.Sample(clipIndex, (duration * (i + 0.37f)) / numSamples);
+            sampler.ComputeModelMatrices();
+            checkSum += sampler.ModelMatrices[i % sampler.NumActiveBones][3][i % 3];
+        }
+        totalNs += elapsedNs(start);
+    }
+    const double matrixNs = totalNs - sampleNs;
+
+    const double numBoneSamples = double(sampler.NumActiveBones) * numSamples * clips.size();
+    Log::Info("%s: %d of %d bones, %d clips, %s keys (%d bytes), %d samples per clip (checksum %f)\n",
+        inFile.c_str(), sampler.NumActiveBones, sampler.NumBones, int(clips.size()), keyEncodingName(orb),
+        orb.Header->AnimKeyDataSize, numSamples, checkSum);
+    Log::Info("  sample:   %.2f ns/bone/sample\n", sampleNs / numBoneSamples);
+    Log::Info("  matrices: %.2f ns/bone/sample\n", matrixNs / numBoneSamples);
+    Log::Info("  total:    %.2f ns/bone/sample, %.2f us/sample\n", totalNs / numBoneSamples,
+        totalNs / (double(numSamples) * clips.size() * 1000.0));
+    return 0;
+}
@@ -0,0 +1,236 @@
+//------------------------------------------------------------------------------
+//  AnimBench.cc
+//------------------------------------------------------------------------------
+#include "AnimBench.h"
+#include "AnimQuantizer.h"
+#include "AnimKeyEncoder.h"
+#include "ExportUtil/Log.h"
+#include <glm/glm.hpp>
+#include <chrono>
+
+using namespace OryolTools;
+using namespace Oryol;
+
+static const int NumIterations = 100;
+
+//------------------------------------------------------------------------------
+static double
+elapsedNs(std::chrono::high_resolution_clock::time_point start) {
+    auto dur = std::chrono::high_resolution_clock::now() - start;
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count();
+}
+
+//------------------------------------------------------------------------------
+void
+AnimBench::DecodeKeys(const IRep& irep, float maxError) {
+    Log::FailIf(irep.AnimClips.empty(), "AnimBench: no anim clips to decode!\n");
+
+    AnimKeyEncoder encoder;
+    encoder.Encode(irep);
+    const std::vector<int16_t>& fixed16 = encoder.Keys;
+    Log::FailIf(fixed16.empty(), "AnimBench: no animated curves to decode!\n");
+    AnimQuantizer quantizer;
+    quantizer.MaxError = maxError;
+    quantizer.Quantize(irep);
+
+    // per-clip dequantization tables for the 16-bit keys
+    std::vector<std::vector<float>> fixed16Scale(irep.AnimClips.size());
+    int maxClipComps = 0;
+    int64_t numFrames = 0;
+    for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
+        for (const auto& curve : irep.AnimClips[clipIndex].Curves) {
+            if (!curve.IsStatic) {
+                for (int i = 0; i < IRep::KeyType::NumComponents(curve.Type); i++) {
+                    fixed16Scale[clipIndex].push_back(curve.Magnitude[i] / 32767.0f);
+                }
+            }
+        }
+        maxClipComps = glm::max(maxClipComps, int(fixed16Scale[clipIndex].size()));
+        numFrames += irep.AnimClipLength(clipIndex);
+    }
+    std::vector<float> dst(maxClipComps + 4);
+
+    // decode all key frames of all clips with 16-bit keys
+    float checkSum = 0.0f;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int iter = 0; iter < NumIterations; iter++) {
+        const int16_t* src = fixed16.data();
+        for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
+            const int numComps = fixed16Scale[clipIndex].size();
+            const float* scale = fixed16Scale[clipIndex].data();
+            const int numKeys = irep.AnimClipLength(clipIndex);
+            for (int keyIndex = 0; keyIndex < numKeys; keyIndex++) {
+                for (int i = 0; i < numComps; i++) {
+                    dst[i] = float(src[i]) * scale[i];
+                }
+                checkSum += dst[0];
+                src += numComps;
+            }
+        }
+    }
+    const double fixed16Ns = elapsedNs(start);
+
+    // decode all key frames of all clips with bit-packed keys
+    start = std::chrono::high_resolution_clock::now();
+    for (int iter = 0; iter < NumIterations; iter++) {
+        for (int clipIndex = 0; clipIndex < int(quantizer.Clips.size()); clipIndex++) {
+            const int numKeys = quantizer.Clips[clipIndex].NumKeys;
+            for (int keyIndex = 0; keyIndex < numKeys; keyIndex++) {
+                quantizer.Unpack(clipIndex, keyIndex, &dst[0]);
+                checkSum += dst[0];
+            }
+        }
+    }
+    const double packedNs = elapsedNs(start);
+
+    // max decoding error of the bit-packed keys
+    float maxDecodeError = 0.0f;
+    for (int clipIndex = 0; clipIndex < int(quantizer.Clips.size()); clipIndex++) {
+        const auto& clip = quantizer.Clips[clipIndex];
+        for (int keyIndex = 0; keyIndex < clip.NumKeys; keyIndex++) {
+            quantizer.Unpack(clipIndex, keyIndex, &dst[0]);
+            for (int i = 0; i < clip.NumComponents; i++) {
+                const auto& comp = quantizer.Components[clip.FirstComponent + i];
+                const float orig = irep.AnimClips[clipIndex].KeyPtr(comp.Curve, keyIndex)[comp.Index];
+                maxDecodeError = glm::max(maxDecodeError, glm::abs(orig - dst[i]));
+            }
+        }
+    }
+
+    const int64_t numComps = fixed16.size();
+    const double numDecodedFrames = double(numFrames) * NumIterations;
+    Log::Info("anim key decode benchmark (%d clips, %d key frames, %d iterations, checksum %f):\n",
+        int(irep.AnimClips.size()), int(numFrames), NumIterations, checkSum);
+    Log::Info("  16-bit:     %8d bytes, %.2f ns/frame, %.3f ns/component\n",
+        int(numComps * 2), fixed16Ns / numDecodedFrames, fixed16Ns / (double(numComps) * NumIterations));
+    Log::Info("  bit-packed: %8d bytes, %.2f ns/frame, %.3f ns/component, %.2f avg bits, max key error %f\n",
+        int(quantizer.KeyData.size()), packedNs / numDecodedFrames, packedNs / (double(numComps) * NumIterations),
+        (numComps > 0) ? double(quantizer.NumBits()) / double(numComps) : 0.0, maxDecodeError);
+}
+
+//------------------------------------------------------------------------------
+static const char*
+layoutName(OrbAnimKeyLayout::Enum layout) {
+    switch (layout) {
+        case OrbAnimKeyLayout::Interleaved: return "interleaved";
+        case OrbAnimKeyLayout::Contiguous:  return "contiguous";
+        default:                            return "segmented";
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Reference sampler: sample a subset of the curves of a clip at a
+    position between two keys, dequantize the 16-bit keys, lerp them and
+    renormalize quaternions (nlerp).
+*/
+static void
+samplePose(const IRep& irep, const AnimKeyEncoder& encoder, int clipIndex, float pos,
+           const std::vector<int>& curves, glm::vec4* dst) {
+    const auto& clip = irep.AnimClips[clipIndex];
+    const int clipLength = irep.AnimClipLength(clipIndex);
+    const int key0 = int(pos) % clipLength;
+    const int key1 = (key0 + 1) % clipLength;
+    const float t = pos - glm::floor(pos);
+    const int16_t* keys = encoder.Keys.data();
+    for (int i = 0; i < int(curves.size()); i++) {
+        const auto& curve = clip.Curves[curves[i]];
+        if (curve.IsStatic) {
+            dst[i] = curve.StaticKey;
+            continue;
+        }
+        const int globalIndex = irep.AnimCurveIndex(clipIndex, curves[i]);
+        const int16_t* k0 = keys + encoder.KeyIndex(clipIndex, globalIndex, key0);
+        const int16_t* k1 = keys + encoder.KeyIndex(clipIndex, globalIndex, key1);
+        const glm::vec4 scale = curve.Magnitude / 32767.0f;
+        glm::vec4 v0(0.0f), v1(0.0f);
+        for (int c = 0; c < encoder.NumCurveComponents[globalIndex]; c++) {
+            v0[c] = float(k0[c]) * scale[c];
+            v1[c] = float(k1[c]) * scale[c];
+        }
+        glm::vec4 v = glm::mix(v0, v1, t);
+        if (curve.Type == IRep::KeyType::Quaternion) {
+            const float len = glm::length(v);
+            if (len > 0.0f) {
+                v /= len;
+            }
+        }
+        dst[i] = v;
+    }
+}
+
+//------------------------------------------------------------------------------
+static double
+benchSampling(const IRep& irep, const AnimKeyEncoder& encoder, const std::vector<int>& curves,
+              bool randomAccess, float& checkSum) {
+    std::vector<glm::vec4> pose(curves.size());
+    uint32_t rnd = 12345;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int iter = 0; iter < NumIterations; iter++) {
+        for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
+            const int clipLength = irep.AnimClipLength(clipIndex);
+            if (clipLength == 0) {
+                continue;
+            }
+            // sample each clip twice per key (sequential), or at the same
+            // number of random positions
+            for (int s = 0; s < clipLength * 2; s++) {
+                float pos;
+                if (randomAccess) {
+                    rnd = rnd * 1664525 + 1013904223;
+                    pos = float(rnd >> 8) * (1.0f / 16777216.0f) * clipLength;
+                }
+                else {
+                    pos = s * 0.5f;
+                }
+                samplePose(irep, encoder, clipIndex, pos, curves, pose.data());
+                checkSum += pose[curves.size() / 2].y;
+            }
+        }
+    }
+    return elapsedNs(start);
+}
+
+//------------------------------------------------------------------------------
+void
+AnimBench::SampleLayouts(const IRep& irep, int segmentLength) {
+    Log::FailIf(irep.AnimClips.empty(), "AnimBench: no anim clips to sample!\n");
+    int64_t numSamples = 0;
+    for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
+        numSamples += irep.AnimClipLength(clipIndex) * 2;
+    }
+    numSamples *= NumIterations;
+
+    // full pose, and a quarter of the curves (e.g. an upper-body layer)
+    std::vector<int> allCurves;
+    std::vector<int> subsetCurves;
+    const int numCurves = irep.NumAnimCurvesPerClip();
+    for (int i = 0; i < numCurves; i++) {
+        allCurves.push_back(i);
+        if (i < glm::max(1, numCurves / 4)) {
+            subsetCurves.push_back(i);
+        }
+    }
+
+    Log::Info("anim sampling benchmark (%d clips, %d curves, %d samples per run, segment length %d):\n",
+        int(irep.AnimClips.size()), numCurves, int(numSamples), segmentLength);
+    const OrbAnimKeyLayout::Enum layouts[] = {
+        OrbAnimKeyLayout::Interleaved, OrbAnimKeyLayout::Contiguous, OrbAnimKeyLayout::Segmented
+    };
+    float checkSum = 0.0f;
+    for (auto layout : layouts) {
+        AnimKeyEncoder encoder;
+        encoder.Layout = layout;
+        encoder.SegmentLength = segmentLength;
+        encoder.Encode(irep);
+        const double fullSeqNs = benchSampling(irep, encoder, allCurves, false, checkSum);
+        const double fullRndNs = benchSampling(irep, encoder, allCurves, true, checkSum);
+        const double subSeqNs = benchSampling(irep, encoder, subsetCurves, false, checkSum);
+        const double subRndNs = benchSampling(irep, encoder, subsetCurves, true, checkSum);
+        Log::Info("  %-12s %8d bytes, full pose: %.1f / %.1f ns/sample, %d curves: %.1f / %.1f ns/sample (sequential / random)\n",
+            layoutName(layout), int(encoder.Keys.size() * sizeof(int16_t)),
+            fullSeqNs / numSamples, fullRndNs / numSamples,
+            int(subsetCurves.size()), subSeqNs / numSamples, subRndNs / numSamples);
+    }
+    Log::Info("  (checksum %f)\n", checkSum);
+}
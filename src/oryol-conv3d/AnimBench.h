@@ -0,0 +1,14 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class AnimBench
+    @brief anim key encoding benchmarks
+*/
+#include "IRep.h"
+
+struct AnimBench {
+    /// benchmark decoding of 16-bit keys vs bit-packed keys
+    static void DecodeKeys(const IRep& irep, float maxError);
+    /// benchmark pose sampling with the different 16-bit key layouts
+    static void SampleLayouts(const IRep& irep, int segmentLength);
+};
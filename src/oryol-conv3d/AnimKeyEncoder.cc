@@ -0,0 +1,120 @@
+//------------------------------------------------------------------------------
+//  AnimKeyEncoder.cc
+//------------------------------------------------------------------------------
+#include "AnimKeyEncoder.h"
+#include "ExportUtil/Log.h"
+#include <glm/glm.hpp>
+
+using namespace OryolTools;
+using namespace Oryol;
+
+//------------------------------------------------------------------------------
+static int16_t
+encodeKeyComponent(float val, float magnitude) {
+    float f = 0.0f;
+    if (magnitude > 0.0f) {
+        f = val / magnitude;
+    }
+    // f is now between -1.0 and +1.0
+    return (int16_t) glm::round(glm::clamp(f*32767.0f, -32768.0f, 32767.0f));
+}
+
+//------------------------------------------------------------------------------
+static void
+encodeKeys(std::vector<int16_t>& dst, const IRep::AnimClip& clip, int curveIndex, int firstKey, int numKeys) {
+    const auto& curve = clip.Curves[curveIndex];
+    const int num = IRep::KeyType::NumComponents(curve.Type);
+    for (int keyIndex = firstKey; keyIndex < (firstKey + numKeys); keyIndex++) {
+        const float* key = clip.KeyPtr(curveIndex, keyIndex);
+        for (int i = 0; i < num; i++) {
+            dst.push_back(encodeKeyComponent(key[i], curve.Magnitude[i]));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+AnimKeyEncoder::Encode(const IRep& irep) {
+    Log::FailIf((this->Layout == OrbAnimKeyLayout::Segmented) && (this->SegmentLength <= 0),
+        "AnimKeyEncoder: SegmentLength must be > 0\n");
+    this->Keys.clear();
+    this->Keys.reserve(irep.AnimKeyDataSize() / 2);
+    this->KeyOffsets.assign(irep.NumAnimCurves(), -1);
+    this->NumCurveComponents.assign(irep.NumAnimCurves(), 0);
+    this->ClipStrides.clear();
+    this->ClipFirstSegment.clear();
+    this->Segments.clear();
+
+    for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
+        const auto& clip = irep.AnimClips[clipIndex];
+        const int clipLength = irep.AnimClipLength(clipIndex);
+        const int clipKeyBase = this->Keys.size();
+
+        // key component offsets of the curves in a clip key
+        int stride = 0;
+        for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+            const auto& curve = clip.Curves[curveIndex];
+            if (!curve.IsStatic) {
+                const int globalIndex = irep.AnimCurveIndex(clipIndex, curveIndex);
+                this->KeyOffsets[globalIndex] = stride;
+                this->NumCurveComponents[globalIndex] = IRep::KeyType::NumComponents(curve.Type);
+                stride += this->NumCurveComponents[globalIndex];
+            }
+        }
+        this->ClipStrides.push_back(stride);
+        this->ClipFirstSegment.push_back(this->Segments.size());
+
+        switch (this->Layout) {
+            case OrbAnimKeyLayout::Interleaved:
+                for (int keyIndex = 0; keyIndex < clipLength; keyIndex++) {
+                    for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+                        if (!clip.Curves[curveIndex].IsStatic) {
+                            encodeKeys(this->Keys, clip, curveIndex, keyIndex, 1);
+                        }
+                    }
+                }
+                for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+                    if (!clip.Curves[curveIndex].IsStatic) {
+                        this->KeyOffsets[irep.AnimCurveIndex(clipIndex, curveIndex)] += clipKeyBase;
+                    }
+                }
+                break;
+
+            case OrbAnimKeyLayout::Contiguous:
+                for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+                    const auto& curve = clip.Curves[curveIndex];
+                    if (curve.IsStatic) {
+                        continue;
+                    }
+                    const int globalIndex = irep.AnimCurveIndex(clipIndex, curveIndex);
+                    if (curve.SharedKeys != -1) {
+                        // shared curves always reference an earlier curve
+                        Log::FailIf(curve.SharedKeys >= globalIndex, "AnimKeyEncoder: invalid shared curve index\n");
+                        this->KeyOffsets[globalIndex] = this->KeyOffsets[curve.SharedKeys];
+                    }
+                    else {
+                        this->KeyOffsets[globalIndex] = this->Keys.size();
+                        encodeKeys(this->Keys, clip, curveIndex, 0, clipLength);
+                    }
+                }
+                break;
+
+            default:
+                // segments of SegmentLength keys, KeyOffset stays the curve's
+                // component offset in a clip key
+                for (int firstKey = 0; firstKey < clipLength; firstKey += this->SegmentLength) {
+                    Segment seg;
+                    seg.FirstKey = firstKey;
+                    seg.NumKeys = glm::min(this->SegmentLength, clipLength - firstKey);
+                    seg.KeyDataOffset = this->Keys.size();
+                    for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+                        if (!clip.Curves[curveIndex].IsStatic) {
+                            encodeKeys(this->Keys, clip, curveIndex, seg.FirstKey, seg.NumKeys);
+                        }
+                    }
+                    this->Segments.push_back(seg);
+                }
+                break;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class AnimKeyEncoder
+    @brief encode anim keys into 16-bit signed normalized keys
+
+    The keys can be arranged in one of the layouts described in
+    OrbChunkFormat.h ('AKLY'):
+
+    - Interleaved: all non-static curves of a clip key by key, best for
+      sampling full poses
+    - Contiguous: all keys of a curve in one block, best for sampling
+      a subset of the curves, identical curves can share their keys
+    - Segmented: each clip is split into segments of SegmentLength keys,
+      within a segment the keys of each curve are in one block, so
+      seeking only touches one segment
+*/
+#include <vector>
+#include <stdint.h>
+#include "IRep.h"
+#include "ExportUtil/OrbChunkFormat.h"
+
+struct AnimKeyEncoder {
+    /// the key layout
+    Oryol::OrbAnimKeyLayout::Enum Layout = Oryol::OrbAnimKeyLayout::Interleaved;
+    /// number of keys per segment (Segmented layout)
+    int SegmentLength = 16;
+
+    /// encode the anim keys of an IRep
+    void Encode(const IRep& irep);
+    /// get index of first key component in Keys
+    int KeyIndex(int clipIndex, int globalCurveIndex, int keyIndex) const;
+
+    struct Segment {
+        int FirstKey = 0;
+        int NumKeys = 0;
+        int KeyDataOffset = 0;          // in number of 16-bit key components
+    };
+    /// the encoded keys
+    std::vector<int16_t> Keys;
+    /// the OrbAnimCurve::KeyOffset of each global curve (-1 for static curves)
+    std::vector<int> KeyOffsets;
+    /// the number of key components of each global curve (0 for static curves)
+    std::vector<int> NumCurveComponents;
+    /// the number of key components in one key of all non-static curves of a clip
+    std::vector<int> ClipStrides;
+    /// index of the first segment of each clip (Segmented layout)
+    std::vector<int> ClipFirstSegment;
+    /// all segments (Segmented layout), in clip order
+    std::vector<Segment> Segments;
+};
+
+//------------------------------------------------------------------------------
+inline int
+AnimKeyEncoder::KeyIndex(int clipIndex, int globalCurveIndex, int keyIndex) const {
+    const int keyOffset = this->KeyOffsets[globalCurveIndex];
+    switch (this->Layout) {
+        case Oryol::OrbAnimKeyLayout::Interleaved:
+            return keyOffset + keyIndex * this->ClipStrides[clipIndex];
+        case Oryol::OrbAnimKeyLayout::Contiguous:
+            return keyOffset + keyIndex * this->NumCurveComponents[globalCurveIndex];
+        default:
+            {
+                const Segment& seg = this->Segments[this->ClipFirstSegment[clipIndex] + keyIndex / this->SegmentLength];
+                return seg.KeyDataOffset + keyOffset * seg.NumKeys + (keyIndex - seg.FirstKey) * this->NumCurveComponents[globalCurveIndex];
+            }
+    }
+}
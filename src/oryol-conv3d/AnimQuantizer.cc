@@ -0,0 +1,233 @@
+//------------------------------------------------------------------------------
+//  AnimQuantizer.cc
+//------------------------------------------------------------------------------
+#include "AnimQuantizer.h"
+#include "ExportUtil/Log.h"
+#include <glm/glm.hpp>
+#include <string.h>
+#include <math.h>
+
+using namespace OryolTools;
+
+//------------------------------------------------------------------------------
+std::vector<float>
+AnimQuantizer::curveTolerances(const IRep& irep) const {
+    const int numCurves = irep.NumAnimCurvesPerClip();
+    const int numBones = irep.Bones.size();
+
+    // curves which can't be associated with a bone get the same precision
+    // as the default 16-bit key format
+    std::vector<float> tolerances(numCurves, 0.0f);
+    if ((numCurves == 0) || (irep.AnimCurveBone(0) == -1)) {
+        return tolerances;
+    }
+
+    // bind pose bone positions and hierarchy depth
+    const std::vector<glm::mat4> boneMatrices = irep.BoneModelMatrices();
+    std::vector<glm::vec3> bonePos(numBones);
+    std::vector<int> depth(numBones, 0);
+    for (int i = 0; i < numBones; i++) {
+        bonePos[i] = glm::vec3(boneMatrices[i][3]);
+        for (int p = irep.Bones[i].Parent; p != -1; p = irep.Bones[p].Parent) {
+            depth[i]++;
+        }
+    }
+
+    // max distance of vertices skinned by a bone to the bone pivot
+    std::vector<float> reach(numBones, 0.0f);
+    if (irep.HasVertexAttr(VertexAttr::Weights) && irep.HasVertexAttr(VertexAttr::Indices)) {
+        for (const auto& node : irep.Nodes) {
+            for (const auto& mesh : node.Meshes) {
+                for (const auto& vtx : mesh.Vertices) {
+                    const glm::vec3 pos(vtx[VertexAttr::Position]);
+                    for (int i = 0; i < 4; i++) {
+                        const int boneIndex = mesh.BoneIndex(vtx, i);
+                        if ((vtx[VertexAttr::Weights][i] > 0.0f) && (boneIndex < numBones)) {
+                            reach[boneIndex] = glm::max(reach[boneIndex], glm::distance(pos, bonePos[boneIndex]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // errors of a bone also move all vertices of its child bones, and the
+    // errors along a bone chain add up, so propagate the vertex reach up to
+    // the ancestors, and the chain length down to the bone
+    std::vector<float> subtreeReach = reach;
+    std::vector<int> chainLength(numBones, 1);
+    for (int i = 0; i < numBones; i++) {
+        for (int p = irep.Bones[i].Parent; p != -1; p = irep.Bones[p].Parent) {
+            subtreeReach[p] = glm::max(subtreeReach[p], reach[i] + glm::distance(bonePos[i], bonePos[p]));
+            chainLength[p] = glm::max(chainLength[p], depth[i] + 1);
+        }
+        chainLength[i] = glm::max(chainLength[i], depth[i] + 1);
+    }
+
+    // bones without skinned vertices still carry attached objects, so
+    // don't let the reach go to zero
+    float minReach = glm::max(glm::max(irep.VertexMagnitude.x, irep.VertexMagnitude.y), irep.VertexMagnitude.z) * 0.01f;
+    if (minReach <= 0.0f) {
+        minReach = 1.0f;
+    }
+    for (int curveIndex = 0; curveIndex < numCurves; curveIndex++) {
+        const int boneIndex = irep.AnimCurveBone(curveIndex);
+        const float budget = this->MaxError / float(chainLength[boneIndex]);
+        const float r = glm::max(subtreeReach[boneIndex], minReach);
+        switch (curveIndex % 3) {
+            // translation: error moves vertices 1:1
+            case 0: tolerances[curveIndex] = budget; break;
+            // rotation: an error of d per quaternion component rotates by at most ~4*d radians
+            case 1: tolerances[curveIndex] = budget / (4.0f * r); break;
+            // scale: error scales the vertex distance to the pivot
+            default: tolerances[curveIndex] = budget / r; break;
+        }
+    }
+    return tolerances;
+}
+
+//------------------------------------------------------------------------------
+static int
+bitsForRange(float range, float tolerance) {
+    if (range <= 0.0f) {
+        return 0;
+    }
+    if (tolerance <= 0.0f) {
+        return 16;
+    }
+    // max rounding error is half a quantization step
+    const float numSteps = range / (2.0f * tolerance);
+    return glm::clamp(int(ceilf(log2f(numSteps + 1.0f))), 1, 16);
+}
+
+//------------------------------------------------------------------------------
+static void
+writeBits(std::vector<uint8_t>& data, int byteOffset, int bitOffset, uint32_t val) {
+    // data is padded so that a 32-bit write never goes past the end
+    uint32_t word;
+    memcpy(&word, &data[byteOffset + (bitOffset>>3)], sizeof(word));
+    word |= val << (bitOffset & 7);
+    memcpy(&data[byteOffset + (bitOffset>>3)], &word, sizeof(word));
+}
+
+//------------------------------------------------------------------------------
+void
+AnimQuantizer::Quantize(const IRep& irep) {
+    this->Clips.clear();
+    this->Components.clear();
+    this->KeyData.clear();
+
+    const std::vector<float> tolerances = this->curveTolerances(irep);
+    int keyDataSize = 0;
+    for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
+        const auto& src = irep.AnimClips[clipIndex];
+        Clip clip;
+        clip.FirstComponent = this->Components.size();
+        clip.KeyDataOffset = keyDataSize;
+        clip.NumKeys = irep.AnimClipLength(clipIndex);
+        int bitOffset = 0;
+        for (int curveIndex = 0; curveIndex < int(src.Curves.size()); curveIndex++) {
+            const auto& curve = src.Curves[curveIndex];
+            if (curve.IsStatic) {
+                continue;
+            }
+            const int numComps = IRep::KeyType::NumComponents(curve.Type);
+            for (int i = 0; i < numComps; i++) {
+                float minVal = (curve.NumKeys == 0) ? 0.0f : src.KeyPtr(curveIndex, 0)[i];
+                float maxVal = minVal;
+                for (int keyIndex = 0; keyIndex < curve.NumKeys; keyIndex++) {
+                    const float val = src.KeyPtr(curveIndex, keyIndex)[i];
+                    minVal = glm::min(minVal, val);
+                    maxVal = glm::max(maxVal, val);
+                }
+                float tolerance = tolerances[curveIndex];
+                if (tolerance <= 0.0f) {
+                    // same precision as 16-bit signed normalized keys
+                    tolerance = curve.Magnitude[i] / 65534.0f;
+                }
+                Component comp;
+                comp.Curve = curveIndex;
+                comp.Index = i;
+                comp.Bits = bitsForRange(maxVal - minVal, tolerance);
+                comp.BitOffset = bitOffset;
+                comp.Min = minVal;
+                comp.Scale = (comp.Bits > 0) ? (maxVal - minVal) / float((1<<comp.Bits) - 1) : 0.0f;
+                this->Components.push_back(comp);
+                bitOffset += comp.Bits;
+            }
+        }
+        clip.NumComponents = this->Components.size() - clip.FirstComponent;
+        clip.KeyStride = ((bitOffset + 31) / 32) * 4;
+        keyDataSize += clip.KeyStride * clip.NumKeys;
+        this->Clips.push_back(clip);
+    }
+
+    // pack the keys, with 4 bytes of padding for the unaligned 32-bit loads
+    this->KeyData.resize(keyDataSize + 4, 0);
+    for (int clipIndex = 0; clipIndex < int(this->Clips.size()); clipIndex++) {
+        const auto& clip = this->Clips[clipIndex];
+        const auto& src = irep.AnimClips[clipIndex];
+        for (int keyIndex = 0; keyIndex < clip.NumKeys; keyIndex++) {
+            const int frameOffset = clip.KeyDataOffset + keyIndex * clip.KeyStride;
+            for (int ci = clip.FirstComponent; ci < (clip.FirstComponent + clip.NumComponents); ci++) {
+                const auto& comp = this->Components[ci];
+                if (comp.Bits > 0) {
+                    const float f = (src.KeyPtr(comp.Curve, keyIndex)[comp.Index] - comp.Min) / comp.Scale;
+                    const uint32_t q = uint32_t(glm::clamp(int(roundf(f)), 0, (1<<comp.Bits) - 1));
+                    writeBits(this->KeyData, frameOffset, comp.BitOffset, q);
+                }
+            }
+        }
+    }
+    this->setupUnpackTables();
+}
+
+//------------------------------------------------------------------------------
+void
+AnimQuantizer::setupUnpackTables() {
+    const int num = this->Components.size();
+    this->unpackByteOffset.resize(num);
+    this->unpackShift.resize(num);
+    this->unpackMask.resize(num);
+    this->unpackMin.resize(num);
+    this->unpackScale.resize(num);
+    for (int i = 0; i < num; i++) {
+        const auto& comp = this->Components[i];
+        this->unpackByteOffset[i] = comp.BitOffset >> 3;
+        this->unpackShift[i] = comp.BitOffset & 7;
+        this->unpackMask[i] = (1<<comp.Bits) - 1;
+        this->unpackMin[i] = comp.Min;
+        this->unpackScale[i] = comp.Scale;
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+AnimQuantizer::Unpack(int clipIndex, int keyIndex, float* dst) const {
+    // all components go through the same load/shift/mask/scale sequence,
+    // over structure-of-arrays tables, so the loop can be vectorized
+    const auto& clip = this->Clips[clipIndex];
+    const uint8_t* frame = &this->KeyData[clip.KeyDataOffset + keyIndex * clip.KeyStride];
+    const uint32_t* byteOffset = this->unpackByteOffset.data() + clip.FirstComponent;
+    const uint32_t* shift = this->unpackShift.data() + clip.FirstComponent;
+    const uint32_t* mask = this->unpackMask.data() + clip.FirstComponent;
+    const float* minVal = this->unpackMin.data() + clip.FirstComponent;
+    const float* scale = this->unpackScale.data() + clip.FirstComponent;
+    for (int i = 0; i < clip.NumComponents; i++) {
+        uint32_t word;
+        memcpy(&word, frame + byteOffset[i], sizeof(word));
+        dst[i] = minVal[i] + float((word >> shift[i]) & mask[i]) * scale[i];
+    }
+}
+
+//------------------------------------------------------------------------------
+int64_t
+AnimQuantizer::NumBits() const {
+    int64_t numBits = 0;
+    for (const auto& clip : this->Clips) {
+        for (int i = clip.FirstComponent; i < (clip.FirstComponent + clip.NumComponents); i++) {
+            numBits += int64_t(this->Components[i].Bits) * clip.NumKeys;
+        }
+    }
+    return numBits;
+}
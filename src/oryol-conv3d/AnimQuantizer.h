@@ -0,0 +1,60 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class AnimQuantizer
+    @brief quantize anim keys into a variable bit-width key stream
+
+    Each component of each non-static curve gets the smallest bit width
+    (0..16) which keeps the error of skinned vertices below MaxError. The
+    per-curve error tolerance is derived from the bone hierarchy depth
+    (errors accumulate down the bone chain) and the distance of the
+    vertices skinned by the bone (and its children) to the bone pivot.
+
+    The result is stored as described in OrbChunkFormat.h ('AKBP').
+*/
+#include <vector>
+#include <stdint.h>
+#include "IRep.h"
+
+struct AnimQuantizer {
+    /// max position error of skinned vertices in model units
+    float MaxError = 0.0005f;
+
+    /// quantize the anim keys of an IRep
+    void Quantize(const IRep& irep);
+    /// unpack one key frame of a clip into dst (one float per clip component)
+    void Unpack(int clipIndex, int keyIndex, float* dst) const;
+    /// number of bits in all packed keys
+    int64_t NumBits() const;
+
+    struct Clip {
+        int FirstComponent = 0;
+        int NumComponents = 0;
+        int KeyDataOffset = 0;      // in bytes
+        int KeyStride = 0;          // in bytes, multiple of 4
+        int NumKeys = 0;
+    };
+    struct Component {
+        int Curve = 0;
+        int Index = 0;
+        int Bits = 0;
+        int BitOffset = 0;
+        float Min = 0.0f;
+        float Scale = 0.0f;
+    };
+    std::vector<Clip> Clips;
+    std::vector<Component> Components;
+    std::vector<uint8_t> KeyData;
+
+    /// compute the allowed error of each clip curve (in key units)
+    std::vector<float> curveTolerances(const IRep& irep) const;
+    /// setup the structure-of-arrays unpack tables
+    void setupUnpackTables();
+
+    // structure-of-arrays unpack tables, one entry per component
+    std::vector<uint32_t> unpackByteOffset;
+    std::vector<uint32_t> unpackShift;
+    std::vector<uint32_t> unpackMask;
+    std::vector<float> unpackMin;
+    std::vector<float> unpackScale;
+};
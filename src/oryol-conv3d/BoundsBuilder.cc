@@ -0,0 +1,158 @@
+//------------------------------------------------------------------------------
+//  BoundsBuilder.cc
+//------------------------------------------------------------------------------
+#include "BoundsBuilder.h"
+#include "ExportUtil/Log.h"
+#include "ExportUtil/Parallel.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+
+using namespace OryolTools;
+
+//------------------------------------------------------------------------------
+static glm::vec4
+curveKey(const IRep::AnimClip& clip, int curveIndex, int keyIndex) {
+    const IRep::AnimCurve& curve = clip.Curves[curveIndex];
+    if (curve.IsStatic || (curve.NumKeys == 0)) {
+        return curve.StaticKey;
+    }
+    return clip.Key(curveIndex, std::min(keyIndex, curve.NumKeys - 1));
+}
+
+//------------------------------------------------------------------------------
+void
+BoundsBuilder::poseSkinMatrices(const IRep& irep, const IRep::AnimClip& clip, int keyIndex, const std::vector<glm::mat4>& invBind, std::vector<glm::mat4>& model, std::vector<glm::mat4>& outSkin) {
+    // bones are sorted parents-first, so the parent's model matrix is ready
+    const int numBones = irep.Bones.size();
+    for (int boneIndex = 0; boneIndex < numBones; boneIndex++) {
+        const glm::mat4 local = IRep::LocalMatrix(
+            glm::vec3(curveKey(clip, boneIndex * 3 + 0, keyIndex)),
+            curveKey(clip, boneIndex * 3 + 1, keyIndex),
+            glm::vec3(curveKey(clip, boneIndex * 3 + 2, keyIndex)));
+        const int parent = irep.Bones[boneIndex].Parent;
+        model[boneIndex] = (parent == -1) ? local : model[parent] * local;
+        outSkin[boneIndex] = model[boneIndex] * invBind[boneIndex];
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+BoundsBuilder::boneBoxes(const IRep& irep, const IRep::Mesh& mesh, std::vector<Bounds>& outBoxes) {
+    // bind-space box of the vertices influenced by each bone
+    const int numBones = irep.Bones.size();
+    outBoxes.assign(numBones, Bounds());
+    for (const auto& vtx : mesh.Vertices) {
+        const glm::vec3 pos(vtx[VertexAttr::Position]);
+        for (int i = 0; i < 4; i++) {
+            if (vtx[VertexAttr::Weights][i] > 0.0f) {
+                const int boneIndex = mesh.BoneIndex(vtx, i);
+                Log::FailIf((boneIndex < 0) || (boneIndex >= numBones), "BoundsBuilder: invalid bone index!\n");
+                outBoxes[boneIndex].ExtendBox(pos, pos);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+BoundsBuilder::extendSkinned(const std::vector<Bounds>& boneBoxes, const std::vector<glm::mat4>& skin, Bounds& inOutBounds) {
+    for (int boneIndex = 0; boneIndex < int(boneBoxes.size()); boneIndex++) {
+        const Bounds& box = boneBoxes[boneIndex];
+        if (!box.IsEmpty()) {
+            const Bounds skinned = box.Transform(skin[boneIndex]);
+            inOutBounds.ExtendBox(skinned.Min, skinned.Max);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+BoundsBuilder::Build(const IRep& irep) {
+    Log::FailIf(!irep.IsHierarchySorted(), "BoundsBuilder: IRep hierarchy must be sorted!\n");
+    this->MeshBounds.clear();
+    this->NodeBounds.clear();
+
+    std::vector<const IRep::Mesh*> meshes;
+    for (const auto& node : irep.Nodes) {
+        for (const auto& mesh : node.Meshes) {
+            meshes.push_back(&mesh);
+        }
+    }
+
+    // compute the bounds of static meshes, and the per-bone boxes and bind
+    // pose bounds of skinned meshes in parallel
+    this->MeshBounds.resize(meshes.size());
+    std::vector<std::vector<Bounds>> meshBoneBoxes(meshes.size());
+    std::vector<int> skinnedMeshes;
+    for (int i = 0; i < int(meshes.size()); i++) {
+        if (irep.IsSkinned(*meshes[i])) {
+            skinnedMeshes.push_back(i);
+        }
+    }
+    const std::vector<glm::mat4> identity(irep.Bones.size(), glm::mat4(1.0f));
+    ParallelFor(meshes.size(), [this, &irep, &meshes, &meshBoneBoxes, &identity](int i) {
+        const IRep::Mesh& mesh = *meshes[i];
+        if (irep.IsSkinned(mesh)) {
+            boneBoxes(irep, mesh, meshBoneBoxes[i]);
+            extendSkinned(meshBoneBoxes[i], identity, this->MeshBounds[i]);
+        }
+        else if (!mesh.Vertices.empty()) {
+            const float* points = &mesh.Vertices[0][VertexAttr::Position].x;
+            this->MeshBounds[i] = Bounds::FromPoints(points, mesh.Vertices.size(), sizeof(IRep::Vertex) / sizeof(float));
+        }
+    });
+
+    // extend the skinned mesh bounds by every key of every clip, clips are
+    // processed in parallel, each one key at a time, so only the skinning
+    // matrices of one pose per clip are alive
+    if (!skinnedMeshes.empty() && !irep.AnimClips.empty() && (irep.AnimCurveBone(0) != -1)) {
+        std::vector<glm::mat4> invBind = irep.BoneModelMatrices();
+        for (auto& m : invBind) {
+            m = glm::inverse(m);
+        }
+        const int numClips = irep.AnimClips.size();
+        std::vector<std::vector<Bounds>> clipBounds(numClips);
+        ParallelFor(numClips, [&irep, &meshBoneBoxes, &skinnedMeshes, &invBind, &clipBounds](int clipIndex) {
+            const int numBones = irep.Bones.size();
+            std::vector<glm::mat4> model(numBones), skin(numBones);
+            const IRep::AnimClip& clip = irep.AnimClips[clipIndex];
+            std::vector<Bounds>& bounds = clipBounds[clipIndex];
+            bounds.resize(skinnedMeshes.size());
+            const int numKeys = std::max(1, clip.Length);
+            for (int keyIndex = 0; keyIndex < numKeys; keyIndex++) {
+                poseSkinMatrices(irep, clip, keyIndex, invBind, model, skin);
+                for (int i = 0; i < int(skinnedMeshes.size()); i++) {
+                    extendSkinned(meshBoneBoxes[skinnedMeshes[i]], skin, bounds[i]);
+                }
+            }
+        });
+        for (const auto& bounds : clipBounds) {
+            for (int i = 0; i < int(skinnedMeshes.size()); i++) {
+                if (!bounds[i].IsEmpty()) {
+                    this->MeshBounds[skinnedMeshes[i]].ExtendBox(bounds[i].Min, bounds[i].Max);
+                }
+            }
+        }
+    }
+    for (int meshIndex : skinnedMeshes) {
+        this->MeshBounds[meshIndex].SphereFromBox();
+    }
+
+    // node bounds, children come after their parents in the sorted
+    // hierarchy, so going backwards merges each subtree into its root
+    const int numNodes = irep.Nodes.size();
+    this->NodeBounds.resize(numNodes);
+    int meshIndex = 0;
+    for (int nodeIndex = 0; nodeIndex < numNodes; nodeIndex++) {
+        for (int i = 0; i < int(irep.Nodes[nodeIndex].Meshes.size()); i++) {
+            this->NodeBounds[nodeIndex].Merge(this->MeshBounds[meshIndex++]);
+        }
+    }
+    for (int nodeIndex = numNodes - 1; nodeIndex >= 0; nodeIndex--) {
+        const IRep::Node& node = irep.Nodes[nodeIndex];
+        if (node.Parent != -1) {
+            const glm::mat4 local = IRep::LocalMatrix(node.Translate, node.Rotate, node.Scale);
+            this->NodeBounds[node.Parent].Merge(this->NodeBounds[nodeIndex].Transform(local));
+        }
+    }
+}
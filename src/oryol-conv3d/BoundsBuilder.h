@@ -0,0 +1,37 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class BoundsBuilder
+    @brief compute bounding boxes and spheres of all meshes and nodes
+
+    Mesh bounds are in the mesh's vertex space. The bounds of skinned
+    meshes enclose the mesh in every key of every anim clip (and the
+    bind pose): each bone's bind-space box of the vertices it influences
+    is transformed by the bone's skinning matrix of each key, since a
+    skinned vertex is a weighted blend of its bone-transformed positions.
+    Poses are computed one key at a time (clips in parallel), so memory
+    doesn't grow with the animation length.
+    Node bounds enclose the node's meshes and the bounds of its child
+    nodes (transformed by the child's local transform), so a culled node
+    culls its whole subtree.
+    Meshes are processed in parallel, the IRep hierarchy must be sorted.
+*/
+#include <vector>
+#include "ExportUtil/Bounds.h"
+#include "IRep.h"
+
+struct BoundsBuilder {
+    /// the bounds of each mesh (in node/mesh order)
+    std::vector<OryolTools::Bounds> MeshBounds;
+    /// the bounds of each node and its subtree
+    std::vector<OryolTools::Bounds> NodeBounds;
+
+    /// compute the mesh and node bounds
+    void Build(const IRep& irep);
+    /// compute the skinning matrices of all bones for one key of a clip (model is scratch space)
+    static void poseSkinMatrices(const IRep& irep, const IRep::AnimClip& clip, int keyIndex, const std::vector<glm::mat4>& invBind, std::vector<glm::mat4>& model, std::vector<glm::mat4>& outSkin);
+    /// compute the bind-space box of the vertices influenced by each bone
+    static void boneBoxes(const IRep& irep, const IRep::Mesh& mesh, std::vector<OryolTools::Bounds>& outBoxes);
+    /// grow a box by the bone boxes transformed by the skinning matrices of a pose
+    static void extendSkinned(const std::vector<OryolTools::Bounds>& boneBoxes, const std::vector<glm::mat4>& skin, OryolTools::Bounds& inOutBounds);
+};
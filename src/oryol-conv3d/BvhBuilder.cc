@@ -0,0 +1,330 @@
+//------------------------------------------------------------------------------
+//  BvhBuilder.cc
+//------------------------------------------------------------------------------
+#include "BvhBuilder.h"
+#include "OrbSaver.h"
+#include "ExportUtil/Log.h"
+#include "ExportUtil/Parallel.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+
+using namespace OryolTools;
+using namespace Oryol;
+
+/// below this depth splits are in the middle, so trees stay within OrbBvhNode::MaxDepth
+static const int MaxSahDepth = 32;
+
+/// a triangle during the build
+struct bvhPrim {
+    glm::vec3 Min;
+    glm::vec3 Max;
+    glm::vec3 Centroid;
+    int Triangle = 0;       // index into the unsorted triangles
+};
+
+/// a node during the build, leaves have no children
+struct bvhNode {
+    glm::vec3 Min;
+    glm::vec3 Max;
+    int Child[2] = { -1, -1 };
+    int FirstPrim = 0;
+    int NumPrims = 0;
+};
+
+//------------------------------------------------------------------------------
+static float
+surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+    const glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Recursively build the node of a range of prims (reordering the prims),
+    returns the node index.
+*/
+static int
+buildNode(std::vector<bvhNode>& nodes, std::vector<bvhPrim>& prims, int first, int count, int depth, int maxLeafSize, int numBins) {
+    const int nodeIndex = nodes.size();
+    nodes.push_back(bvhNode());
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+    for (int i = first; i < first + count; i++) {
+        min = glm::min(min, prims[i].Min);
+        max = glm::max(max, prims[i].Max);
+        cmin = glm::min(cmin, prims[i].Centroid);
+        cmax = glm::max(cmax, prims[i].Centroid);
+    }
+    nodes[nodeIndex].Min = min;
+    nodes[nodeIndex].Max = max;
+    nodes[nodeIndex].FirstPrim = first;
+    nodes[nodeIndex].NumPrims = count;
+
+    // find the cheapest split between centroid bins along any axis, the
+    // cost of a split is the summed surface area weighted by the number
+    // of triangles on each side
+    struct bin {
+        glm::vec3 Min = glm::vec3(FLT_MAX);
+        glm::vec3 Max = glm::vec3(-FLT_MAX);
+        int Count = 0;
+    };
+    std::vector<bin> bins(numBins);
+    std::vector<float> rightCost(numBins);
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; (axis < 3) && (depth < MaxSahDepth); axis++) {
+        const float extent = cmax[axis] - cmin[axis];
+        if (extent <= 0.0f) {
+            continue;
+        }
+        const float binScale = numBins / extent;
+        std::fill(bins.begin(), bins.end(), bin());
+        for (int i = first; i < first + count; i++) {
+            const int b = std::min(numBins - 1, int((prims[i].Centroid[axis] - cmin[axis]) * binScale));
+            bins[b].Min = glm::min(bins[b].Min, prims[i].Min);
+            bins[b].Max = glm::max(bins[b].Max, prims[i].Max);
+            bins[b].Count++;
+        }
+        bin right;
+        for (int b = numBins - 1; b > 0; b--) {
+            right.Min = glm::min(right.Min, bins[b].Min);
+            right.Max = glm::max(right.Max, bins[b].Max);
+            right.Count += bins[b].Count;
+            rightCost[b] = (right.Count > 0) ? right.Count * surfaceArea(right.Min, right.Max) : 0.0f;
+        }
+        bin left;
+        for (int b = 0; b < numBins - 1; b++) {
+            left.Min = glm::min(left.Min, bins[b].Min);
+            left.Max = glm::max(left.Max, bins[b].Max);
+            left.Count += bins[b].Count;
+            if ((left.Count > 0) && (left.Count < count)) {
+                const float cost = left.Count * surfaceArea(left.Min, left.Max) + rightCost[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+    }
+
+    // a leaf if splitting isn't cheaper (1 for the child box tests, plus
+    // the cost of the triangle tests relative to the node's surface area)
+    int mid = first + count / 2;
+    if (bestAxis == -1) {
+        // all centroids are identical (or the tree is getting too deep
+        // for the query stack), split in the middle if too many triangles
+        if (count <= maxLeafSize) {
+            return nodeIndex;
+        }
+    }
+    else {
+        const float area = surfaceArea(min, max);
+        const float splitCost = 1.0f + ((area > 0.0f) ? (bestCost / area) : 0.0f);
+        if ((count <= maxLeafSize) && (float(count) <= splitCost)) {
+            return nodeIndex;
+        }
+        const float binScale = numBins / (cmax[bestAxis] - cmin[bestAxis]);
+        auto iter = std::partition(prims.begin() + first, prims.begin() + first + count, [&](const bvhPrim& prim) {
+            return std::min(numBins - 1, int((prim.Centroid[bestAxis] - cmin[bestAxis]) * binScale)) <= bestSplit;
+        });
+        mid = int(iter - prims.begin());
+    }
+    const int left = buildNode(nodes, prims, first, mid - first, depth + 1, maxLeafSize, numBins);
+    const int right = buildNode(nodes, prims, mid, first + count - mid, depth + 1, maxLeafSize, numBins);
+    nodes[nodeIndex].Child[0] = left;
+    nodes[nodeIndex].Child[1] = right;
+    return nodeIndex;
+}
+
+//------------------------------------------------------------------------------
+static uint32_t
+leafRef(int firstPrim, int numPrims) {
+    return OrbBvhNode::Leaf | (uint32_t(numPrims) << OrbBvhNode::LeafCountShift) | uint32_t(firstPrim);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Quantize child bounds relative to the tree bounds, rounded outwards
+    (with one extra step against float rounding in the dequantization).
+*/
+static void
+quantizeBounds(const glm::vec3& treeMin, const glm::vec3& treeMax, const glm::vec3& min, const glm::vec3& max, uint16_t* outMin, uint16_t* outMax) {
+    for (int i = 0; i < 3; i++) {
+        const float extent = treeMax[i] - treeMin[i];
+        const float scale = (extent > 0.0f) ? (65535.0f / extent) : 0.0f;
+        const float qmin = floorf((min[i] - treeMin[i]) * scale) - 1.0f;
+        const float qmax = ceilf((max[i] - treeMin[i]) * scale) + 1.0f;
+        outMin[i] = uint16_t(glm::clamp(qmin, 0.0f, 65535.0f));
+        outMax[i] = uint16_t(glm::clamp(qmax, 0.0f, 65535.0f));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write an inner build node and its inner children depth-first, returns
+    the index of the written node.
+*/
+static uint32_t
+writeNode(const std::vector<bvhNode>& nodes, int nodeIndex, const glm::vec3& treeMin, const glm::vec3& treeMax, std::vector<OrbBvhNode>& out) {
+    const uint32_t outIndex = out.size();
+    out.push_back(OrbBvhNode());
+    for (int i = 0; i < 2; i++) {
+        const bvhNode& child = nodes[nodes[nodeIndex].Child[i]];
+        uint16_t qmin[3], qmax[3];
+        quantizeBounds(treeMin, treeMax, child.Min, child.Max, qmin, qmax);
+        uint32_t ref;
+        if (child.Child[0] == -1) {
+            ref = leafRef(child.FirstPrim, child.NumPrims);
+        }
+        else {
+            ref = writeNode(nodes, nodes[nodeIndex].Child[i], treeMin, treeMax, out);
+        }
+        OrbBvhNode& dst = out[outIndex];
+        for (int j = 0; j < 3; j++) {
+            dst.ChildMin[i][j] = qmin[j];
+            dst.ChildMax[i][j] = qmax[j];
+        }
+        dst.Child[i] = ref;
+    }
+    return outIndex;
+}
+
+//------------------------------------------------------------------------------
+void
+BvhBuilder::buildTree(const IRep& irep, int nodeIndex, int firstMesh, Tree& tree) const {
+    const IRep::Node& node = irep.Nodes[nodeIndex];
+    tree.Node = nodeIndex;
+
+    // gather the triangles of all meshes
+    std::vector<OrbBvhTriangle> tris;
+    std::vector<bvhPrim> prims;
+    for (int meshIndex = 0; meshIndex < int(node.Meshes.size()); meshIndex++) {
+        const IRep::Mesh& mesh = node.Meshes[meshIndex];
+        for (int i = 0; (i + 2) < int(mesh.Indices.size()); i += 3) {
+            OrbBvhTriangle tri;
+            bvhPrim prim;
+            prim.Min = glm::vec3(FLT_MAX);
+            prim.Max = glm::vec3(-FLT_MAX);
+            for (int v = 0; v < 3; v++) {
+                const glm::vec3 pos(mesh.Vertices[mesh.Indices[i + v]][VertexAttr::Position]);
+                for (int j = 0; j < 3; j++) {
+                    tri.Vertex[v][j] = pos[j];
+                }
+                prim.Min = glm::min(prim.Min, pos);
+                prim.Max = glm::max(prim.Max, pos);
+            }
+            tri.Mesh = firstMesh + meshIndex;
+            tri.FirstIndex = i;
+            prim.Centroid = (prim.Min + prim.Max) * 0.5f;
+            prim.Triangle = tris.size();
+            tris.push_back(tri);
+            prims.push_back(prim);
+        }
+    }
+    Log::FailIf(prims.size() > OrbBvhNode::LeafFirstMask, "BvhBuilder: too many triangles in node '%s'\n", node.Name.c_str());
+
+    // build the tree, and write it depth-first with quantized child bounds
+    std::vector<bvhNode> nodes;
+    nodes.reserve(prims.size() * 2);
+    buildNode(nodes, prims, 0, prims.size(), 0, this->MaxLeafSize, this->NumBins);
+    tree.Min = nodes[0].Min;
+    tree.Max = nodes[0].Max;
+    tree.Nodes.clear();
+    if (nodes[0].Child[0] == -1) {
+        // a single leaf, the other child is empty
+        OrbBvhNode root;
+        quantizeBounds(tree.Min, tree.Max, tree.Min, tree.Max, root.ChildMin[0], root.ChildMax[0]);
+        root.Child[0] = leafRef(0, nodes[0].NumPrims);
+        root.Child[1] = leafRef(0, 0);
+        tree.Nodes.push_back(root);
+    }
+    else {
+        writeNode(nodes, 0, tree.Min, tree.Max, tree.Nodes);
+    }
+    tree.Triangles.clear();
+    for (const auto& prim : prims) {
+        tree.Triangles.push_back(tris[prim.Triangle]);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+BvhBuilder::Build(const IRep& irep) {
+    Log::FailIf(!irep.IsHierarchySorted(), "BvhBuilder: IRep hierarchy must be sorted!\n");
+    Log::FailIf((this->MaxLeafSize < 1) || (this->MaxLeafSize > int(OrbBvhNode::LeafCountMask)), "BvhBuilder: invalid MaxLeafSize\n");
+    Log::FailIf(this->NumBins < 2, "BvhBuilder: invalid NumBins\n");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // one job per node with triangles (and without skinned meshes)
+    struct job {
+        int Node;
+        int FirstMesh;
+    };
+    std::vector<job> jobs;
+    int firstMesh = 0;
+    for (int nodeIndex = 0; nodeIndex < int(irep.Nodes.size()); nodeIndex++) {
+        const IRep::Node& node = irep.Nodes[nodeIndex];
+        bool hasTriangles = false;
+        bool skinned = false;
+        for (const auto& mesh : node.Meshes) {
+            hasTriangles |= (mesh.Indices.size() >= 3);
+            skinned |= irep.IsSkinned(mesh);
+        }
+        if (hasTriangles && (this->SkinnedNodes || !skinned)) {
+            jobs.push_back({ nodeIndex, firstMesh });
+        }
+        firstMesh += node.Meshes.size();
+    }
+
+    // build the trees in parallel
+    this->Trees.clear();
+    this->Trees.resize(jobs.size());
+    ParallelFor(jobs.size(), [this, &irep, &jobs](int i) {
+        this->buildTree(irep, jobs[i].Node, jobs[i].FirstMesh, this->Trees[i]);
+    });
+    auto dur = std::chrono::high_resolution_clock::now() - start;
+    this->BuildTimeMs = std::chrono::duration_cast<std::chrono::microseconds>(dur).count() / 1000.0;
+}
+
+//------------------------------------------------------------------------------
+void
+BvhBuilder::Write(std::vector<uint8_t>& payload) const {
+    OrbBvhHeader hdr;
+    hdr.NumTrees = this->Trees.size();
+    for (const auto& tree : this->Trees) {
+        hdr.NumNodes += tree.Nodes.size();
+        hdr.NumTriangles += tree.Triangles.size();
+    }
+    OrbSaver::appendChunkItem(payload, hdr);
+    uint32_t firstNode = 0;
+    uint32_t firstTriangle = 0;
+    for (const auto& tree : this->Trees) {
+        OrbBvhTree dst;
+        dst.Node = tree.Node;
+        dst.FirstNode = firstNode;
+        dst.NumNodes = tree.Nodes.size();
+        dst.FirstTriangle = firstTriangle;
+        dst.NumTriangles = tree.Triangles.size();
+        for (int i = 0; i < 3; i++) {
+            dst.Min[i] = tree.Min[i];
+            dst.Max[i] = tree.Max[i];
+        }
+        OrbSaver::appendChunkItem(payload, dst);
+        firstNode += dst.NumNodes;
+        firstTriangle += dst.NumTriangles;
+    }
+    for (const auto& tree : this->Trees) {
+        for (const auto& node : tree.Nodes) {
+            OrbSaver::appendChunkItem(payload, node);
+        }
+    }
+    for (const auto& tree : this->Trees) {
+        for (const auto& tri : tree.Triangles) {
+            OrbSaver::appendChunkItem(payload, tri);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class BvhBuilder
+    @brief build triangle BVHs of IRep nodes with the surface area heuristic
+
+    One binary BVH is built per node over the triangles of all its meshes
+    (see the 'TBVH' chunk in OrbChunkFormat.h). Splits are selected with a
+    binned SAH over the triangle centroids, a set of triangles becomes a
+    leaf when splitting it isn't cheaper than testing all its triangles
+    (and it has at most MaxLeafSize triangles). The trees of different
+    nodes are built in parallel. The IRep hierarchy must be sorted (node
+    and mesh indices are written as ORB indices).
+*/
+#include <vector>
+#include "IRep.h"
+#include "ExportUtil/OrbChunkFormat.h"
+
+struct BvhBuilder {
+    /// max number of triangles in a leaf (<= OrbBvhNode::LeafCountMask)
+    int MaxLeafSize = 4;
+    /// number of SAH bins per axis
+    int NumBins = 16;
+    /// if true, also build trees of nodes with skinned meshes (in their bind pose)
+    bool SkinnedNodes = false;
+
+    /// a built tree, node and triangle indices are relative to the tree
+    struct Tree {
+        int Node = 0;
+        glm::vec3 Min;
+        glm::vec3 Max;
+        std::vector<Oryol::OrbBvhNode> Nodes;
+        std::vector<Oryol::OrbBvhTriangle> Triangles;
+    };
+    std::vector<Tree> Trees;
+    /// wall-clock time of the last Build() in milliseconds
+    double BuildTimeMs = 0.0;
+
+    /// build the trees of all static nodes (or all nodes with SkinnedNodes)
+    void Build(const IRep& irep);
+    /// append the 'TBVH' chunk payload
+    void Write(std::vector<uint8_t>& payload) const;
+    /// build the tree of one node
+    void buildTree(const IRep& irep, int nodeIndex, int firstMesh, Tree& tree) const;
+};
@@ -0,0 +1,159 @@
+//------------------------------------------------------------------------------
+//  CodecTest.cc
+//------------------------------------------------------------------------------
+#include "CodecTest.h"
+#include "ExportUtil/VertexCodec.h"
+#include "ExportUtil/Log.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <random>
+#include <vector>
+#include <math.h>
+
+using namespace OryolTools;
+
+/// an input tangent frame to encode
+struct qtFrame {
+    glm::vec3 Normal;
+    glm::vec3 Tangent;
+    glm::vec3 Binormal;
+    /// the input tangent is degenerate, any tangent perpendicular to the normal is fine
+    bool AnyTangent = false;
+};
+
+//------------------------------------------------------------------------------
+static qtFrame
+rotatedFrame(const glm::quat& q, float handedness) {
+    qtFrame frame;
+    frame.Normal = q * glm::vec3(0.0f, 0.0f, 1.0f);
+    frame.Tangent = q * glm::vec3(1.0f, 0.0f, 0.0f);
+    frame.Binormal = glm::cross(frame.Normal, frame.Tangent) * handedness;
+    return frame;
+}
+
+//------------------------------------------------------------------------------
+static glm::quat
+axisAngle(const glm::vec3& axis, float angle) {
+    const glm::vec3 a = glm::normalize(axis) * sinf(angle * 0.5f);
+    return glm::quat(cosf(angle * 0.5f), a.x, a.y, a.z);
+}
+
+//------------------------------------------------------------------------------
+static float
+maxDiff(const glm::vec3& a, const glm::vec3& b) {
+    const glm::vec3 d = glm::abs(a - b);
+    return glm::max(glm::max(d.x, d.y), d.z);
+}
+
+//------------------------------------------------------------------------------
+bool
+CodecTest::QTangents(float maxError) {
+    std::vector<qtFrame> frames;
+
+    // the 24 axis-aligned rotations (several have w = 0), both handedness signs
+    const glm::vec3 axes[6] = {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+    };
+    for (const auto& n : axes) {
+        for (const auto& t : axes) {
+            if (glm::dot(n, t) == 0.0f) {
+                for (float h : { 1.0f, -1.0f }) {
+                    frames.push_back({ n, t, glm::cross(n, t) * h });
+                }
+            }
+        }
+    }
+
+    // random frames, and rotations close to 180 degrees (w close to 0)
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto randomAxis = [&rng, &uniform]() {
+        glm::vec3 v;
+        do {
+            v = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+        }
+        while ((glm::dot(v, v) < 0.01f) || (glm::dot(v, v) > 1.0f));
+        return glm::normalize(v);
+    };
+    const float pi = 3.14159265f;
+    for (int i = 0; i < 20000; i++) {
+        const float handedness = (i & 1) ? -1.0f : 1.0f;
+        frames.push_back(rotatedFrame(axisAngle(randomAxis(), uniform(rng) * pi), handedness));
+        const float nearPi = pi - fabsf(uniform(rng)) * ((i & 2) ? 1e-2f : 1e-5f);
+        frames.push_back(rotatedFrame(axisAngle(randomAxis(), nearPi), handedness));
+    }
+
+    // degenerate and unnormalized input: zero tangents, tangents parallel
+    // to the normal, non-orthogonal and scaled tangents
+    for (int i = 0; i < 2000; i++) {
+        const float handedness = (i & 1) ? -1.0f : 1.0f;
+        const qtFrame ref = rotatedFrame(axisAngle(randomAxis(), uniform(rng) * pi), handedness);
+        qtFrame frame = ref;
+        switch (i % 4) {
+            case 0:
+                frame.Tangent = glm::vec3(0.0f);
+                frame.AnyTangent = true;
+                break;
+            case 1:
+                frame.Tangent = ref.Normal * (2.0f * uniform(rng));
+                frame.AnyTangent = true;
+                break;
+            case 2:
+                frame.Tangent = ref.Tangent + ref.Normal * uniform(rng);
+                break;
+            default:
+                frame.Normal = ref.Normal * 3.0f;
+                frame.Tangent = ref.Tangent * 0.25f;
+                frame.Binormal = ref.Binormal * 5.0f;
+                break;
+        }
+        frames.push_back(frame);
+    }
+
+    // the expected frame is the normalized input, with the tangent
+    // orthogonalized to the normal
+    float maxNormalError = 0.0f;
+    float maxTangentError = 0.0f;
+    float maxBinormalError = 0.0f;
+    int numFailed = 0;
+    for (const auto& frame : frames) {
+        uint8_t encoded[8];
+        VertexCodec::EncodeQTangent(encoded, frame.Normal, frame.Tangent, frame.Binormal);
+        glm::vec3 n, t, b;
+        VertexCodec::DecodeQTangent(encoded, n, t, b);
+
+        const glm::vec3 refNormal = glm::normalize(frame.Normal);
+        const float normalError = maxDiff(n, refNormal);
+        float tangentError, binormalError;
+        if (frame.AnyTangent) {
+            // decoded tangent must be a unit vector perpendicular to the normal,
+            // and the binormal on the same side as the input binormal
+            tangentError = glm::max(fabsf(glm::dot(t, refNormal)), fabsf(glm::length(t) - 1.0f));
+            const glm::vec3 refBinormal = glm::cross(refNormal, t) * ((glm::dot(glm::cross(refNormal, t), frame.Binormal) < 0.0f) ? -1.0f : 1.0f);
+            binormalError = maxDiff(b, refBinormal);
+        }
+        else {
+            const glm::vec3 refTangent = glm::normalize(frame.Tangent - refNormal * glm::dot(refNormal, frame.Tangent));
+            tangentError = maxDiff(t, refTangent);
+            binormalError = maxDiff(b, glm::normalize(frame.Binormal));
+        }
+        maxNormalError = glm::max(maxNormalError, normalError);
+        maxTangentError = glm::max(maxTangentError, tangentError);
+        maxBinormalError = glm::max(maxBinormalError, binormalError);
+        // NaN compares false, so test for the good case
+        if (!((normalError <= maxError) && (tangentError <= maxError) && (binormalError <= maxError))) {
+            if (numFailed < 10) {
+                Log::Warn("QTangent round-trip failed: normal (%f,%f,%f) tangent (%f,%f,%f) binormal (%f,%f,%f), errors %f %f %f\n",
+                    frame.Normal.x, frame.Normal.y, frame.Normal.z,
+                    frame.Tangent.x, frame.Tangent.y, frame.Tangent.z,
+                    frame.Binormal.x, frame.Binormal.y, frame.Binormal.z,
+                    normalError, tangentError, binormalError);
+            }
+            numFailed++;
+        }
+    }
+    Log::Info("QTangent self-test: %d frames, max normal error %f, max tangent error %f, max binormal error %f (tolerance %f), %d failed\n",
+        int(frames.size()), maxNormalError, maxTangentError, maxBinormalError, maxError, numFailed);
+    return 0 == numFailed;
+}
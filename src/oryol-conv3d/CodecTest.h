@@ -0,0 +1,11 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class CodecTest
+    @brief vertex codec round-trip self-tests (run with -qtangent-selftest)
+*/
+
+struct CodecTest {
+    /// encode and decode tangent frames as quaternions, return false if any error is above maxError
+    static bool QTangents(float maxError);
+};
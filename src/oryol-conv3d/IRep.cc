@@ -3,7 +3,10 @@
 //------------------------------------------------------------------------------
 #include "IRep.h"
 #include "ExportUtil/Log.h"
+#include <algorithm>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 using namespace OryolTools;
 
@@ -28,15 +31,36 @@ IRep::ComputeVertexMagnitude() {
 void
 IRep::ComputeCurveMagnitudes() {
     for (auto& clip : this->AnimClips) {
-        for (auto& curve : clip.Curves) {
+        for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+            auto& curve = clip.Curves[curveIndex];
             curve.Magnitude = glm::vec4(0.0f);
-            for (const auto& key : curve.Keys) {
-                curve.Magnitude = glm::max(curve.Magnitude, glm::abs(key));
+            for (int keyIndex = 0; keyIndex < curve.NumKeys; keyIndex++) {
+                curve.Magnitude = glm::max(curve.Magnitude, glm::abs(clip.Key(curveIndex, keyIndex)));
             }
         }
     }
 }
 
+//------------------------------------------------------------------------------
+void
+IRep::AnimClip::CompactKeys() {
+    std::vector<float> keyData;
+    keyData.reserve(this->KeyData.size());
+    for (auto& curve : this->Curves) {
+        if (curve.IsStatic || (curve.NumKeys == 0)) {
+            curve.KeyOffset = -1;
+            curve.NumKeys = 0;
+        }
+        else {
+            const int num = curve.NumKeys * KeyType::NumComponents(curve.Type);
+            const float* src = &this->KeyData[curve.KeyOffset];
+            curve.KeyOffset = keyData.size();
+            keyData.insert(keyData.end(), src, src + num);
+        }
+    }
+    this->KeyData = std::move(keyData);
+}
+
 //------------------------------------------------------------------------------
 bool
 IRep::HasVertexAttr(VertexAttr::Code attr) const {
@@ -48,6 +72,23 @@ IRep::HasVertexAttr(VertexAttr::Code attr) const {
     return false;
 }
 
+//------------------------------------------------------------------------------
+bool
+IRep::IsSkinned(const Mesh& mesh) const {
+    // vertex weights and indices are shared by all meshes, so a rigid mesh
+    // in a skinned model is one without any non-zero weight
+    if (this->Bones.empty() || !this->HasVertexAttr(VertexAttr::Weights) || !this->HasVertexAttr(VertexAttr::Indices)) {
+        return false;
+    }
+    for (const auto& vtx : mesh.Vertices) {
+        const glm::vec4& weights = vtx[VertexAttr::Weights];
+        if ((weights.x != 0.0f) || (weights.y != 0.0f) || (weights.z != 0.0f) || (weights.w != 0.0f)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 //------------------------------------------------------------------------------
 int
 IRep::MaterialIndex(const std::string& name) const {
@@ -163,13 +204,9 @@ IRep::AnimClipKeyStride(int clipIndex) const {
 //------------------------------------------------------------------------------
 int
 IRep::AnimClipLength(int clipIndex) const {
-    for (const auto& curve : this->AnimClips[clipIndex].Curves) {
-        // all curves in the clip either have no keys, or the same number of keys
-        if (!curve.Keys.empty()) {
-            return curve.Keys.size();
-        }
-    }
-    return 0;
+    // all non-static curves in the clip have the same number of keys, the
+    // length is tracked separately since all curves may be static
+    return this->AnimClips[clipIndex].Length;
 }
 
 //------------------------------------------------------------------------------
@@ -199,6 +236,252 @@ IRep::AnimKeyOffset(int clipIndex, int curveIndex) const {
     return keyOffset;
 }
 
+//------------------------------------------------------------------------------
+int
+IRep::AnimCurveIndex(int clipIndex, int curveIndex) const {
+    return clipIndex * this->NumAnimCurvesPerClip() + curveIndex;
+}
+
+//------------------------------------------------------------------------------
+int
+IRep::AnimCurveBone(int curveIndex) const {
+    // character clips have a translate, rotate and scale curve per bone
+    if (!this->Bones.empty() && (this->NumAnimCurvesPerClip() == int(this->Bones.size()) * 3)) {
+        return curveIndex / 3;
+    }
+    else {
+        return -1;
+    }
+}
+
+//------------------------------------------------------------------------------
+glm::mat4
+IRep::LocalMatrix(const glm::vec3& translate, const glm::vec4& rotate, const glm::vec3& scale) {
+    const glm::quat rot(rotate.w, rotate.x, rotate.y, rotate.z);
+    glm::mat4 m = glm::translate(glm::mat4(1.0f), translate);
+    m = m * glm::mat4_cast(rot);
+    m = glm::scale(m, scale);
+    return m;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compute the model matrices of bones or nodes, these are not guaranteed
+    to be sorted parent-first, so resolve the hierarchy by walking up the
+    parent chain where needed.
+*/
+template<class TYPE> static std::vector<glm::mat4>
+modelMatrices(const std::vector<TYPE>& items) {
+    const int num = items.size();
+    std::vector<glm::mat4> res(num, glm::mat4(1.0f));
+    std::vector<bool> done(num, false);
+    std::vector<int> chain;
+    for (int index = 0; index < num; index++) {
+        chain.clear();
+        for (int i = index; (i != -1) && !done[i]; i = items[i].Parent) {
+            chain.push_back(i);
+            Log::FailIf(int(chain.size()) > num, "IRep: cycle in hierarchy!\n");
+        }
+        for (auto iter = chain.rbegin(); iter != chain.rend(); iter++) {
+            const auto& item = items[*iter];
+            const glm::mat4 local = IRep::LocalMatrix(item.Translate, item.Rotate, item.Scale);
+            res[*iter] = (item.Parent == -1) ? local : res[item.Parent] * local;
+            done[*iter] = true;
+        }
+    }
+    return res;
+}
+
+//------------------------------------------------------------------------------
+std::vector<glm::mat4>
+IRep::BoneModelMatrices() const {
+    return modelMatrices(this->Bones);
+}
+
+//------------------------------------------------------------------------------
+std::vector<glm::mat4>
+IRep::NodeModelMatrices() const {
+    return modelMatrices(this->Nodes);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the hierarchy depth of bones or nodes (anything with a Parent index).
+*/
+template<class TYPE> static std::vector<int>
+hierarchyDepths(const std::vector<TYPE>& items) {
+    const int num = items.size();
+    std::vector<int> depth(num, 0);
+    for (int i = 0; i < num; i++) {
+        for (int p = items[i].Parent; p != -1; p = items[p].Parent) {
+            Log::FailIf(++depth[i] > num, "IRep: cycle in hierarchy!\n");
+        }
+    }
+    return depth;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get a parents-first order grouped by depth (stable within a depth),
+    the result maps new to old indices.
+*/
+template<class TYPE> static std::vector<int>
+hierarchyOrder(const std::vector<TYPE>& items) {
+    const std::vector<int> depth = hierarchyDepths(items);
+    std::vector<int> order(items.size());
+    for (int i = 0; i < int(order.size()); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&depth](int a, int b) {
+        return depth[a] < depth[b];
+    });
+    return order;
+}
+
+//------------------------------------------------------------------------------
+template<class TYPE> static bool
+isHierarchySorted(const std::vector<TYPE>& items) {
+    const std::vector<int> order = hierarchyOrder(items);
+    for (int i = 0; i < int(order.size()); i++) {
+        if (order[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sort nodes parents-first grouped by depth, and fix their parent indices.
+*/
+template<class TYPE> static void
+sortHierarchy(std::vector<TYPE>& items) {
+    const std::vector<int> order = hierarchyOrder(items);
+    std::vector<int> indexMap(items.size());
+    for (int i = 0; i < int(order.size()); i++) {
+        indexMap[order[i]] = i;
+    }
+    std::vector<TYPE> sorted;
+    sorted.reserve(items.size());
+    for (int oldIndex : order) {
+        sorted.push_back(std::move(items[oldIndex]));
+        if (sorted.back().Parent != -1) {
+            sorted.back().Parent = indexMap[sorted.back().Parent];
+        }
+    }
+    items = std::move(sorted);
+}
+
+//------------------------------------------------------------------------------
+bool
+IRep::IsHierarchySorted() const {
+    // bones ordered for skeleton LOD only need to be parents-first
+    bool bonesSorted = true;
+    if (this->BoneLodCutoffs.empty()) {
+        bonesSorted = isHierarchySorted(this->Bones);
+    }
+    else {
+        for (int i = 0; i < int(this->Bones.size()); i++) {
+            bonesSorted &= (this->Bones[i].Parent < i);
+        }
+    }
+    return bonesSorted && isHierarchySorted(this->Nodes);
+}
+
+//------------------------------------------------------------------------------
+void
+IRep::SortHierarchy() {
+    // nodes only need their parent indices fixed, meshes move with their node
+    sortHierarchy(this->Nodes);
+    if (!this->IsHierarchySorted()) {
+        Log::FailIf(!this->BoneLodCutoffs.empty(), "IRep::SortHierarchy: LOD-ordered bones aren't parents-first!\n");
+        this->ReorderBones(hierarchyOrder(this->Bones));
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+IRep::ReorderBones(const std::vector<int>& order) {
+    const int numBones = this->Bones.size();
+    Log::FailIf(int(order.size()) != numBones, "IRep::ReorderBones: invalid bone order!\n");
+    const bool curvesMatchBones = this->AnimClips.empty() || (this->AnimCurveBone(0) != -1);
+    std::vector<int> boneMap(numBones, -1);
+    for (int i = 0; i < numBones; i++) {
+        boneMap[order[i]] = i;
+    }
+    std::vector<Bone> bones;
+    bones.reserve(numBones);
+    for (int oldIndex : order) {
+        bones.push_back(this->Bones[oldIndex]);
+        if (bones.back().Parent != -1) {
+            bones.back().Parent = boneMap[bones.back().Parent];
+        }
+    }
+    this->Bones = std::move(bones);
+
+    // remap skinned vertex bone indices, or the joint palettes
+    if (this->HasVertexAttr(VertexAttr::Weights) && this->HasVertexAttr(VertexAttr::Indices)) {
+        for (auto& node : this->Nodes) {
+            for (auto& mesh : node.Meshes) {
+                for (int& boneIndex : mesh.JointPalette) {
+                    boneIndex = boneMap[boneIndex];
+                }
+                if (!mesh.JointPalette.empty()) {
+                    continue;
+                }
+                for (auto& vtx : mesh.Vertices) {
+                    for (int i = 0; i < 4; i++) {
+                        const int boneIndex = int(vtx[VertexAttr::Indices][i] + 0.5f);
+                        if (boneIndex < numBones) {
+                            vtx[VertexAttr::Indices][i] = float(boneMap[boneIndex]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // reorder the anim curves (translate, rotate, scale per bone)
+    if (!curvesMatchBones) {
+        Log::Warn("IRep::ReorderBones: anim curves don't match bones, not reordered\n");
+        return;
+    }
+    const int numCurves = this->NumAnimCurvesPerClip();
+    for (auto& clip : this->AnimClips) {
+        std::vector<AnimCurve> curves(numCurves);
+        for (int curveIndex = 0; curveIndex < numCurves; curveIndex++) {
+            curves[boneMap[curveIndex / 3] * 3 + (curveIndex % 3)] = clip.Curves[curveIndex];
+        }
+        clip.Curves = std::move(curves);
+    }
+
+    // shared keys must point to an earlier curve, which might have changed,
+    // so the first curve of each group of identical curves becomes the new owner
+    const int numAllCurves = this->NumAnimCurves();
+    auto newIndex = [&boneMap, numCurves](int globalIndex) {
+        const int curveIndex = globalIndex % numCurves;
+        return (globalIndex - curveIndex) + boneMap[curveIndex / 3] * 3 + (curveIndex % 3);
+    };
+    std::vector<int> owner(numAllCurves, -1);
+    for (int i = 0; i < numAllCurves; i++) {
+        AnimCurve& curve = this->AnimClips[i / numCurves].Curves[i % numCurves];
+        if (curve.SharedKeys != -1) {
+            curve.SharedKeys = newIndex(curve.SharedKeys);
+            if (owner[curve.SharedKeys] == -1) {
+                owner[curve.SharedKeys] = i;
+            }
+        }
+    }
+    for (int i = 0; i < numAllCurves; i++) {
+        AnimCurve& curve = this->AnimClips[i / numCurves].Curves[i % numCurves];
+        const int group = (curve.SharedKeys != -1) ? curve.SharedKeys : ((owner[i] != -1) ? i : -1);
+        if (group != -1) {
+            const int first = glm::min(group, owner[group]);
+            curve.SharedKeys = (first == i) ? -1 : first;
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 std::vector<std::string>
 IRep::NodeNames() const {
@@ -9,6 +9,7 @@
 #include <array>
 #include <glm/vec4.hpp>
 #include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
 #include "ExportUtil/Vertex.h"
 
 struct IRep {
@@ -55,10 +56,20 @@ struct IRep {
         std::vector<TextureProperty> Textures;
     };
     typedef std::array<glm::vec4, VertexAttr::Num> Vertex;
+    /// max number of vertices which 16-bit vertex indices can address
+    static const int MaxIndexedVertices = 0x10000;
     struct Mesh {
         std::vector<Vertex> Vertices;
         std::vector<uint16_t> Indices;
         uint32_t Material = 0;
+        /// if not empty, vertex bone indices are local indices into this list of bone indices
+        std::vector<int> JointPalette;
+
+        /// get the global bone index of a vertex skin influence
+        int BoneIndex(const Vertex& vtx, int influence) const {
+            const int index = int(vtx[VertexAttr::Indices][influence] + 0.5f);
+            return this->JointPalette.empty() ? index : this->JointPalette[index];
+        }
     };
     struct Bone {
         std::string Name;
@@ -74,6 +85,8 @@ struct IRep {
         glm::vec3 Translate = glm::vec3(0.0f, 0.0f, 0.0f);
         glm::vec3 Scale = glm::vec3(1.0f, 1.0f, 1.0f);
         glm::vec4 Rotate = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        /// if >= 0, the node is a spatial chunk of its parent, with the Morton code of its grid cell
+        int32_t SpatialChunk = -1;
     };
     struct KeyType {
         enum Enum {
@@ -117,15 +130,43 @@ struct IRep {
     };
     struct AnimCurve {
         bool IsStatic = false;
+        bool IsBindPose = false;    // static and identical with the bone's bind pose
+        int SharedKeys = -1;        // global index of an identical curve whose keys are shared, or -1
         KeyType::Enum Type = KeyType::Invalid;
         glm::vec4 StaticKey;
         glm::vec4 Magnitude;
-        std::vector<glm::vec4> Keys;
+        int KeyOffset = -1;         // index of the curve's first key component in the clip's KeyData
+        int NumKeys = 0;
     };
     struct AnimClip {
         std::string Name;
         float KeyDuration = 0.0f;
+        int Length = 0;             // number of keys in the clip's non-static curves
         std::vector<AnimCurve> Curves;
+        /// keys of all curves, curve by curve, KeyType::NumComponents() floats per key
+        std::vector<float> KeyData;
+
+        /// get pointer to the components of a curve key
+        const float* KeyPtr(int curveIndex, int keyIndex) const {
+            const AnimCurve& curve = this->Curves[curveIndex];
+            return &this->KeyData[curve.KeyOffset + keyIndex * KeyType::NumComponents(curve.Type)];
+        }
+        /// get writable pointer to the components of a curve key
+        float* KeyPtr(int curveIndex, int keyIndex) {
+            const AnimCurve& curve = this->Curves[curveIndex];
+            return &this->KeyData[curve.KeyOffset + keyIndex * KeyType::NumComponents(curve.Type)];
+        }
+        /// get a curve key as vec4 (missing components are 0)
+        glm::vec4 Key(int curveIndex, int keyIndex) const {
+            glm::vec4 key(0.0f);
+            const float* src = this->KeyPtr(curveIndex, keyIndex);
+            for (int i = 0; i < KeyType::NumComponents(this->Curves[curveIndex].Type); i++) {
+                key[i] = src[i];
+            }
+            return key;
+        }
+        /// remove the key data of static curves
+        void CompactKeys();
     };
 
     std::vector<VertexComponent> VertexComponents;
@@ -134,6 +175,9 @@ struct IRep {
     std::vector<Bone> Bones;
     std::vector<Node> Nodes;
     std::vector<AnimClip> AnimClips;
+    /// if not empty, bones are ordered by importance (parents-first), and the
+    /// first BoneLodCutoffs[i] bones form the skeleton of LOD level i
+    std::vector<int> BoneLodCutoffs;
 
     /// compute the vertex position magnitude
     void ComputeVertexMagnitude();
@@ -141,6 +185,8 @@ struct IRep {
     void ComputeCurveMagnitudes();
     /// computed getters
     bool HasVertexAttr(VertexAttr::Code attr) const;
+    /// return true if a mesh has skinned vertices (any non-zero vertex weight)
+    bool IsSkinned(const Mesh& mesh) const;
     int MaterialIndex(const std::string& name) const;
     int NumVertices() const;
     int NumIndices() const;
@@ -154,6 +200,22 @@ struct IRep {
     int AnimClipLength(int clipIndex) const;
     int AnimKeyDataSize() const;
     int AnimKeyOffset(int clipIndex, int curveIndex) const;
+    /// get the global curve index (clipIndex * NumAnimCurvesPerClip() + curveIndex)
+    int AnimCurveIndex(int clipIndex, int curveIndex) const;
+    /// get the bone index of an anim curve (3 curves per bone: translate, rotate, scale), or -1
+    int AnimCurveBone(int curveIndex) const;
+    /// compute a local matrix from translation, rotation quaternion (x,y,z,w) and scale
+    static glm::mat4 LocalMatrix(const glm::vec3& translate, const glm::vec4& rotate, const glm::vec3& scale);
+    /// compute bind-pose model-space matrices of all bones
+    std::vector<glm::mat4> BoneModelMatrices() const;
+    /// compute model-space matrices of all nodes (accumulated node transforms)
+    std::vector<glm::mat4> NodeModelMatrices() const;
+    /// return true if bones and nodes are sorted parents-first, grouped by hierarchy depth
+    bool IsHierarchySorted() const;
+    /// sort bones and nodes parents-first grouped by hierarchy depth, and remap all references
+    void SortHierarchy();
+    /// reorder bones (order maps new to old index), and remap all bone and curve references
+    void ReorderBones(const std::vector<int>& order);
     std::vector<std::string> NodeNames() const;
     std::vector<std::string> ClipNames() const;
 };
@@ -67,6 +67,9 @@ IRepJsonDumper::DumpIRep(const IRep& irep) {
             cJSON_AddItemToObject(bone, "rotate", cJSON_CreateFloatArray(&item.Rotate.x, 4));
             cJSON_AddItemToObject(bone, "scale", cJSON_CreateFloatArray(&item.Scale.x, 3));
         }
+        if (!irep.BoneLodCutoffs.empty()) {
+            cJSON_AddItemToObject(root, "bone_lod_cutoffs", cJSON_CreateIntArray(&irep.BoneLodCutoffs[0], irep.BoneLodCutoffs.size()));
+        }
     }
 
     // nodes
@@ -90,6 +93,13 @@ IRepJsonDumper::DumpIRep(const IRep& irep) {
                     cJSON_AddItemToObject(mesh, "material", cJSON_CreateNumber(meshItem.Material));
                     cJSON_AddItemToObject(mesh, "num_vertices", cJSON_CreateNumber(meshItem.Vertices.size()));
                     cJSON_AddItemToObject(mesh, "num_indices", cJSON_CreateNumber(meshItem.Indices.size()));
+                    if (!meshItem.JointPalette.empty()) {
+                        cJSON* palette = cJSON_CreateArray();
+                        cJSON_AddItemToObject(mesh, "joint_palette", palette);
+                        for (int boneIndex : meshItem.JointPalette) {
+                            cJSON_AddItemToArray(palette, cJSON_CreateNumber(boneIndex));
+                        }
+                    }
                 }
             }
         }
@@ -104,6 +114,7 @@ IRepJsonDumper::DumpIRep(const IRep& irep) {
             cJSON_AddItemToArray(clips, clip);
             cJSON_AddItemToObject(clip, "name", cJSON_CreateString(item.Name.c_str()));
             cJSON_AddItemToObject(clip, "key_duration", cJSON_CreateNumber(item.KeyDuration));
+            cJSON_AddItemToObject(clip, "length", cJSON_CreateNumber(item.Length));
             cJSON* curves = cJSON_CreateArray();
             cJSON_AddItemToObject(clip, "curves", curves);
             for (const auto& curveItem : item.Curves) {
@@ -112,7 +123,9 @@ IRepJsonDumper::DumpIRep(const IRep& irep) {
                 cJSON_AddItemToObject(curve, "type", cJSON_CreateString(IRep::KeyType::ToString(curveItem.Type)));
                 cJSON_AddItemToObject(curve, "static_key", cJSON_CreateFloatArray(&curveItem.StaticKey.x, 4));
                 cJSON_AddItemToObject(curve, "magnitude", cJSON_CreateFloatArray(&curveItem.Magnitude.x, 4));
-                cJSON_AddItemToObject(curve, "num_keys", cJSON_CreateNumber(curveItem.Keys.size()));
+                cJSON_AddItemToObject(curve, "num_keys", cJSON_CreateNumber(curveItem.NumKeys));
+                cJSON_AddItemToObject(curve, "bind_pose", cJSON_CreateBool(curveItem.IsBindPose));
+                cJSON_AddItemToObject(curve, "shared_keys", cJSON_CreateNumber(curveItem.SharedKeys));
             }
         }
     }
@@ -140,6 +153,23 @@ IRepJsonDumper::DumpIRepProcessor(const IRep& irep) {
     for (const auto& clip : irep.AnimClips) {
         cJSON_AddItemToArray(clips, cJSON_CreateString(clip.Name.c_str()));
     }
+    cJSON* anim = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "anim", anim);
+    cJSON_AddItemToObject(anim, "curve_epsilon", cJSON_CreateNumber(0.0));
+    cJSON_AddItemToObject(anim, "share_curves", cJSON_CreateBool(false));
+    cJSON* skeleton = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "skeleton", skeleton);
+    cJSON_AddItemToObject(skeleton, "prune_bones", cJSON_CreateBool(false));
+    cJSON_AddItemToObject(skeleton, "lod_levels", cJSON_CreateArray());
+    cJSON* skin = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "skin", skin);
+    cJSON_AddItemToObject(skin, "max_influences", cJSON_CreateNumber(0));
+    cJSON_AddItemToObject(skin, "max_palette_size", cJSON_CreateNumber(0));
+    cJSON* mesh = cJSON_CreateObject();
+    cJSON_AddItemToObject(root, "mesh", mesh);
+    cJSON_AddItemToObject(mesh, "merge_materials", cJSON_CreateBool(false));
+    cJSON_AddItemToObject(mesh, "flatten_hierarchy", cJSON_CreateBool(false));
+    cJSON_AddItemToObject(mesh, "chunk_size", cJSON_CreateNumber(0));
     char* rawStr = cJSON_Print(root);
     std::string jsonStr(rawStr);
     free(rawStr);
@@ -2,9 +2,18 @@
 //  IRepProcessor.cc
 //------------------------------------------------------------------------------
 #include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <float.h>
+#include <string.h>
+#include <math.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "IRepProcessor.h"
 #include "LoadUtil.h"
+#include "ExportUtil/Hash.h"
+#include "ExportUtil/Simd.h"
 #include "cJSON.h"
 extern "C" {
 #include "cJSON_Utils.h"
@@ -17,6 +26,15 @@ void
 IRepProcessor::Clear() {
     this->Nodes.clear();
     this->Clips.clear();
+    this->AnimCurveEpsilon = 0.0f;
+    this->ShareAnimCurves = false;
+    this->PruneBones = false;
+    this->MaxSkinInfluences = 0;
+    this->MaxJointPaletteSize = 0;
+    this->BoneLodLevels.clear();
+    this->MergeMaterials = false;
+    this->FlattenHierarchy = false;
+    this->SpatialChunkSize = 0.0f;
 }
 
 //------------------------------------------------------------------------------
@@ -29,6 +47,26 @@ static void parseStringArray(const char* path, cJSON* arrayNode, vector<string>&
     }
 }
 
+//------------------------------------------------------------------------------
+static float parseNumber(const char* path, cJSON* numberNode) {
+    Log::FailIf(!cJSON_IsNumber(numberNode), "JSON '%s' must be a number\n", path);
+    return (float) numberNode->valuedouble;
+}
+
+//------------------------------------------------------------------------------
+static void parseNumberArray(const char* path, cJSON* arrayNode, vector<float>& dst) {
+    Log::FailIf(!cJSON_IsArray(arrayNode), "JSON '%s' must be an array of numbers\n", path);
+    for (int i = 0; i < cJSON_GetArraySize(arrayNode); i++) {
+        dst.push_back(parseNumber(path, cJSON_GetArrayItem(arrayNode, i)));
+    }
+}
+
+//------------------------------------------------------------------------------
+static bool parseBool(const char* path, cJSON* boolNode) {
+    Log::FailIf(!cJSON_IsBool(boolNode), "JSON '%s' must be a bool\n", path);
+    return cJSON_IsTrue(boolNode);
+}
+
 //------------------------------------------------------------------------------
 void
 IRepProcessor::Load(const string& path) {
@@ -46,6 +84,42 @@ IRepProcessor::Load(const string& path) {
     if ((node = cJSONUtils_GetPointer(json, "/filter/clips"))) {
         parseStringArray("/filter/clips", node, this->Clips);
     }
+    if ((node = cJSONUtils_GetPointer(json, "/anim/curve_epsilon"))) {
+        this->AnimCurveEpsilon = parseNumber("/anim/curve_epsilon", node);
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/anim/share_curves"))) {
+        this->ShareAnimCurves = parseBool("/anim/share_curves", node);
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/skeleton/prune_bones"))) {
+        this->PruneBones = parseBool("/skeleton/prune_bones", node);
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/skeleton/lod_levels"))) {
+        parseNumberArray("/skeleton/lod_levels", node, this->BoneLodLevels);
+        for (int i = 0; i < int(this->BoneLodLevels.size()); i++) {
+            Log::FailIf((this->BoneLodLevels[i] <= 0.0f) || (this->BoneLodLevels[i] > 1.0f) ||
+                        ((i > 0) && (this->BoneLodLevels[i] > this->BoneLodLevels[i - 1])),
+                "JSON '/skeleton/lod_levels' must be descending fractions in (0, 1]\n");
+        }
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/mesh/merge_materials"))) {
+        this->MergeMaterials = parseBool("/mesh/merge_materials", node);
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/mesh/flatten_hierarchy"))) {
+        this->FlattenHierarchy = parseBool("/mesh/flatten_hierarchy", node);
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/mesh/chunk_size"))) {
+        this->SpatialChunkSize = parseNumber("/mesh/chunk_size", node);
+        Log::FailIf(this->SpatialChunkSize < 0.0f, "JSON '/mesh/chunk_size' must be >= 0\n");
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/skin/max_influences"))) {
+        this->MaxSkinInfluences = (int) parseNumber("/skin/max_influences", node);
+        Log::FailIf((this->MaxSkinInfluences < 0) || (this->MaxSkinInfluences == 3) || (this->MaxSkinInfluences > 4),
+            "JSON '/skin/max_influences' must be 0 (off), 1, 2 or 4\n");
+    }
+    if ((node = cJSONUtils_GetPointer(json, "/skin/max_palette_size"))) {
+        this->MaxJointPaletteSize = (int) parseNumber("/skin/max_palette_size", node);
+        Log::FailIf(this->MaxJointPaletteSize < 0, "JSON '/skin/max_palette_size' must be >= 0\n");
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -78,6 +152,56 @@ IRepProcessor::Process(IRep& irep) {
     if (!this->Clips.empty()) {
         this->RemoveClips(irep, matchItems(irep.ClipNames(), this->Clips));
     }
+
+    // need to flatten the node hierarchy? (before merging materials,
+    // so that identical materials of former nodes are merged too)
+    if (this->FlattenHierarchy) {
+        this->BakeNodeTransforms(irep);
+    }
+
+    // need to optimize anim curves?
+    if (this->AnimCurveEpsilon > 0.0f) {
+        this->OptimizeAnimCurves(irep, this->AnimCurveEpsilon);
+    }
+
+    // need to remove unused bones? (after optimizing the anim curves,
+    // since this may turn curves static)
+    if (this->PruneBones) {
+        this->RemoveUnusedBones(irep);
+    }
+
+    // need to merge materials and meshes? (before splitting joint
+    // palettes, so that the merged meshes are split as a whole)
+    if (this->MergeMaterials) {
+        this->MergeIdenticalMaterials(irep);
+        this->MergeMeshesByMaterial(irep);
+    }
+
+    // need to split static meshes into spatial chunks? (after merging,
+    // so that each chunk gets one mesh per material)
+    if (this->SpatialChunkSize > 0.0f) {
+        this->SplitSpatialChunks(irep, this->SpatialChunkSize);
+    }
+
+    // need to prepare skinning? (after removing bones, so that the
+    // joint palettes only contain remaining bones)
+    if (this->MaxSkinInfluences > 0) {
+        this->LimitSkinInfluences(irep, this->MaxSkinInfluences);
+    }
+    if (this->MaxJointPaletteSize > 0) {
+        this->SplitJointPalettes(irep, this->MaxJointPaletteSize);
+    }
+
+    // need to order bones for skeleton LOD?
+    if (!this->BoneLodLevels.empty()) {
+        this->OrderBonesByLod(irep, this->BoneLodLevels);
+    }
+
+    // need to share identical anim curves? (must come last since
+    // curves are referenced by their global index)
+    if (this->ShareAnimCurves) {
+        this->ShareCurveKeys(irep);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -169,3 +293,1003 @@ IRepProcessor::RemoveClips(IRep& irep, const vector<string>& clipNames) {
         }
     }
 }
+
+//------------------------------------------------------------------------------
+static bool
+equalKeys(const glm::vec4& k0, const glm::vec4& k1, int numComps, float epsilon) {
+    for (int i = 0; i < numComps; i++) {
+        if (glm::abs(k0[i] - k1[i]) > epsilon) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::OptimizeAnimCurves(IRep& irep, float epsilon) {
+    const int oldKeyDataSize = irep.AnimKeyDataSize();
+    int numStatic = 0;
+    int numBindPose = 0;
+    for (auto& clip : irep.AnimClips) {
+        for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+            auto& curve = clip.Curves[curveIndex];
+            const int numComps = IRep::KeyType::NumComponents(curve.Type);
+
+            // a curve with all keys within epsilon becomes static, with the
+            // center of the key range as static key
+            if (!curve.IsStatic && (curve.NumKeys > 0)) {
+                glm::vec4 minKey = clip.Key(curveIndex, 0);
+                glm::vec4 maxKey = minKey;
+                for (int keyIndex = 1; keyIndex < curve.NumKeys; keyIndex++) {
+                    const glm::vec4 key = clip.Key(curveIndex, keyIndex);
+                    minKey = glm::min(minKey, key);
+                    maxKey = glm::max(maxKey, key);
+                }
+                if (equalKeys(minKey, maxKey, numComps, epsilon)) {
+                    curve.IsStatic = true;
+                    curve.StaticKey = (minKey + maxKey) * 0.5f;
+                    numStatic++;
+                }
+            }
+
+            // a static bone curve identical with the bone's bind pose doesn't
+            // need to be sampled at all
+            curve.IsBindPose = false;
+            const int boneIndex = irep.AnimCurveBone(curveIndex);
+            if (curve.IsStatic && (boneIndex != -1)) {
+                const auto& bone = irep.Bones[boneIndex];
+                switch (curveIndex % 3) {
+                    case 0:
+                        curve.IsBindPose = equalKeys(curve.StaticKey, glm::vec4(bone.Translate, 0.0f), 3, epsilon);
+                        break;
+                    case 1:
+                        // q and -q are the same rotation
+                        curve.IsBindPose = equalKeys(curve.StaticKey, bone.Rotate, 4, epsilon) ||
+                                           equalKeys(curve.StaticKey, -bone.Rotate, 4, epsilon);
+                        break;
+                    default:
+                        curve.IsBindPose = equalKeys(curve.StaticKey, glm::vec4(bone.Scale, 0.0f), 3, epsilon);
+                        break;
+                }
+                if (curve.IsBindPose) {
+                    numBindPose++;
+                }
+            }
+        }
+    }
+    for (auto& clip : irep.AnimClips) {
+        clip.CompactKeys();
+    }
+    irep.ComputeCurveMagnitudes();
+    Log::Info("IRepProcessor::OptimizeAnimCurves: %d curves made static, %d of %d curves match bind pose, key data %d => %d bytes\n",
+        numStatic, numBindPose, irep.NumAnimCurves(), oldKeyDataSize, irep.AnimKeyDataSize());
+}
+
+//------------------------------------------------------------------------------
+static uint64_t
+hashCurveKeys(const IRep::AnimClip& clip, int curveIndex) {
+    // hash over the key type and raw key data
+    Hash hash;
+    const auto& curve = clip.Curves[curveIndex];
+    hash.AddValue(int(curve.Type));
+    if (curve.NumKeys > 0) {
+        hash.Add(clip.KeyPtr(curveIndex, 0), curve.NumKeys * IRep::KeyType::ByteSize(curve.Type));
+    }
+    return hash.Value;
+}
+
+//------------------------------------------------------------------------------
+static bool
+sameCurveKeys(const IRep::AnimClip& clip0, int curveIndex0, const IRep::AnimClip& clip1, int curveIndex1) {
+    const auto& c0 = clip0.Curves[curveIndex0];
+    const auto& c1 = clip1.Curves[curveIndex1];
+    return (c0.Type == c1.Type) && (c0.NumKeys == c1.NumKeys) && (c0.NumKeys > 0) &&
+           (0 == memcmp(clip0.KeyPtr(curveIndex0, 0), clip1.KeyPtr(curveIndex1, 0), c0.NumKeys * IRep::KeyType::ByteSize(c0.Type)));
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::ShareCurveKeys(IRep& irep) {
+    // map key data hashes to the global indices of the unique curves
+    unordered_map<uint64_t, vector<int>> uniqueCurves;
+    int numAnimated = 0;
+    int numShared = 0;
+    int allKeyBytes = 0;
+    int sharedKeyBytes = 0;
+    const int numCurvesPerClip = irep.NumAnimCurvesPerClip();
+    for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
+        auto& clip = irep.AnimClips[clipIndex];
+        for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+            auto& curve = clip.Curves[curveIndex];
+            curve.SharedKeys = -1;
+            if (curve.IsStatic) {
+                continue;
+            }
+            numAnimated++;
+            const int keyBytes = curve.NumKeys * IRep::KeyType::ByteSize(curve.Type);
+            allKeyBytes += keyBytes;
+            auto& candidates = uniqueCurves[hashCurveKeys(clip, curveIndex)];
+            for (int candidate : candidates) {
+                const auto& candidateClip = irep.AnimClips[candidate / numCurvesPerClip];
+                if (sameCurveKeys(candidateClip, candidate % numCurvesPerClip, clip, curveIndex)) {
+                    curve.SharedKeys = candidate;
+                    break;
+                }
+            }
+            if (curve.SharedKeys == -1) {
+                candidates.push_back(irep.AnimCurveIndex(clipIndex, curveIndex));
+            }
+            else {
+                numShared++;
+                sharedKeyBytes += keyBytes;
+            }
+        }
+    }
+    Log::Info("IRepProcessor::ShareCurveKeys: %d of %d animated curves share keys (%.1f%%), key data %d => %d bytes\n",
+        numShared, numAnimated, numAnimated > 0 ? (100.0f * numShared) / numAnimated : 0.0f,
+        allKeyBytes, allKeyBytes - sharedKeyBytes);
+}
+
+//------------------------------------------------------------------------------
+static bool
+isUniformScale(const glm::vec3& s) {
+    const float eps = glm::max(glm::abs(s.x), 1.0f) * 1e-5f;
+    return (glm::abs(s.x - s.y) <= eps) && (glm::abs(s.x - s.z) <= eps);
+}
+
+//------------------------------------------------------------------------------
+static glm::quat
+toQuat(const glm::vec4& v) {
+    return glm::quat(v.w, v.x, v.y, v.z);
+}
+
+//------------------------------------------------------------------------------
+static glm::vec4
+fromQuat(const glm::quat& q) {
+    return glm::vec4(q.x, q.y, q.z, q.w);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Fold the (uniformly scaled) TRS transform of a bone into the TRS keys of
+    a child, child' = parent * child:
+
+    T' = parentT + parentR * (parentS * childT)
+    R' = parentR * childR
+    S' = parentS * childS
+*/
+static glm::vec4
+composeKey(int curveSlot, const glm::vec3& t, const glm::quat& r, float s, const glm::vec4& key) {
+    switch (curveSlot) {
+        case 0:  return glm::vec4(t + r * (glm::vec3(key) * s), 0.0f);
+        case 1:  return fromQuat(r * toQuat(key));
+        default: return glm::vec4(glm::vec3(key) * s, 0.0f);
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::RemoveUnusedBones(IRep& irep) {
+    const int numBones = irep.Bones.size();
+    if (numBones == 0) {
+        return;
+    }
+    if (!irep.AnimClips.empty() && (irep.AnimCurveBone(0) == -1)) {
+        Log::Warn("IRepProcessor::RemoveUnusedBones: anim curves don't match bones, skipped\n");
+        return;
+    }
+
+    // bones are used by skinned vertices, or by animated curves
+    vector<bool> used(numBones, false);
+    if (irep.HasVertexAttr(VertexAttr::Weights) && irep.HasVertexAttr(VertexAttr::Indices)) {
+        for (const auto& node : irep.Nodes) {
+            for (const auto& mesh : node.Meshes) {
+                for (const auto& vtx : mesh.Vertices) {
+                    for (int i = 0; i < 4; i++) {
+                        const int boneIndex = mesh.BoneIndex(vtx, i);
+                        if ((vtx[VertexAttr::Weights][i] > 0.0f) && (boneIndex < numBones)) {
+                            used[boneIndex] = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (const auto& clip : irep.AnimClips) {
+        for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+            if (!clip.Curves[curveIndex].IsStatic) {
+                used[irep.AnimCurveBone(curveIndex)] = true;
+            }
+        }
+    }
+
+    // visit bones parents-first, so that chains of unused bones collapse
+    vector<int> order;
+    vector<bool> visited(numBones, false);
+    while (int(order.size()) < numBones) {
+        const int numOrdered = order.size();
+        for (int i = 0; i < numBones; i++) {
+            const int parent = irep.Bones[i].Parent;
+            if (!visited[i] && ((parent < 0) || visited[parent])) {
+                visited[i] = true;
+                order.push_back(i);
+            }
+        }
+        Log::FailIf(numOrdered == int(order.size()), "IRepProcessor::RemoveUnusedBones: cycle in bone hierarchy\n");
+    }
+
+    vector<bool> removed(numBones, false);
+    int numKept = 0;
+    for (int boneIndex : order) {
+        if (used[boneIndex]) {
+            continue;
+        }
+        IRep::Bone& bone = irep.Bones[boneIndex];
+        vector<int> children;
+        for (int i = 0; i < numBones; i++) {
+            if (!removed[i] && (irep.Bones[i].Parent == boneIndex)) {
+                children.push_back(i);
+            }
+        }
+
+        // the bone's transform must be foldable into its children, which
+        // only works for uniform scaling
+        bool foldable = isUniformScale(bone.Scale);
+        for (const auto& clip : irep.AnimClips) {
+            foldable &= isUniformScale(glm::vec3(clip.Curves[boneIndex * 3 + 2].StaticKey));
+        }
+        if (!children.empty() && !foldable) {
+            numKept++;
+            continue;
+        }
+
+        // fold the bone into its children's bind pose and anim curves
+        for (int childIndex : children) {
+            IRep::Bone& child = irep.Bones[childIndex];
+            const glm::quat boneRot = toQuat(bone.Rotate);
+            child.Translate = bone.Translate + boneRot * (child.Translate * bone.Scale.x);
+            child.Rotate = fromQuat(boneRot * toQuat(child.Rotate));
+            child.Scale *= bone.Scale.x;
+            child.Parent = bone.Parent;
+            for (auto& clip : irep.AnimClips) {
+                const auto& boneT = clip.Curves[boneIndex * 3 + 0];
+                const auto& boneR = clip.Curves[boneIndex * 3 + 1];
+                const auto& boneS = clip.Curves[boneIndex * 3 + 2];
+                const glm::vec3 t(boneT.StaticKey);
+                const glm::quat r = toQuat(boneR.StaticKey);
+                const float s = boneS.StaticKey.x;
+                const bool boneIsBindPose = boneT.IsBindPose && boneR.IsBindPose && boneS.IsBindPose;
+                for (int slot = 0; slot < 3; slot++) {
+                    const int curveIndex = childIndex * 3 + slot;
+                    auto& curve = clip.Curves[curveIndex];
+                    curve.IsBindPose &= boneIsBindPose;
+                    curve.StaticKey = composeKey(slot, t, r, s, curve.StaticKey);
+                    for (int keyIndex = 0; keyIndex < curve.NumKeys; keyIndex++) {
+                        float* key = clip.KeyPtr(curveIndex, keyIndex);
+                        const glm::vec4 dst = composeKey(slot, t, r, s, clip.Key(curveIndex, keyIndex));
+                        for (int i = 0; i < IRep::KeyType::NumComponents(curve.Type); i++) {
+                            key[i] = dst[i];
+                        }
+                    }
+                }
+            }
+        }
+        removed[boneIndex] = true;
+    }
+
+    // build the bone index map, and remove bones
+    vector<int> boneMap(numBones, -1);
+    vector<IRep::Bone> bones;
+    for (int i = 0; i < numBones; i++) {
+        if (!removed[i]) {
+            boneMap[i] = bones.size();
+            bones.push_back(irep.Bones[i]);
+        }
+    }
+    for (auto& bone : bones) {
+        if (bone.Parent >= 0) {
+            bone.Parent = boneMap[bone.Parent];
+            Log::FailIf(bone.Parent < 0, "IRepProcessor::RemoveUnusedBones: parent was removed\n");
+        }
+    }
+    const int numRemoved = numBones - int(bones.size());
+    irep.Bones = std::move(bones);
+
+    // remap skinned vertex bone indices (or the joint palette entries),
+    // unweighted influences can point to a removed bone, those are set to bone 0
+    if (irep.HasVertexAttr(VertexAttr::Weights) && irep.HasVertexAttr(VertexAttr::Indices)) {
+        for (auto& node : irep.Nodes) {
+            for (auto& mesh : node.Meshes) {
+                for (int& boneIndex : mesh.JointPalette) {
+                    boneIndex = glm::max(boneMap[boneIndex], 0);
+                }
+                if (!mesh.JointPalette.empty()) {
+                    continue;
+                }
+                for (auto& vtx : mesh.Vertices) {
+                    for (int i = 0; i < 4; i++) {
+                        const int boneIndex = int(vtx[VertexAttr::Indices][i] + 0.5f);
+                        const int newIndex = (boneIndex < numBones) ? boneMap[boneIndex] : -1;
+                        vtx[VertexAttr::Indices][i] = float(glm::max(newIndex, 0));
+                    }
+                }
+            }
+        }
+    }
+
+    // remove the curves of removed bones, shared curve indices are invalidated
+    for (auto& clip : irep.AnimClips) {
+        vector<IRep::AnimCurve> curves;
+        for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+            if (!removed[curveIndex / 3]) {
+                curves.push_back(clip.Curves[curveIndex]);
+                curves.back().SharedKeys = -1;
+            }
+        }
+        clip.Curves = std::move(curves);
+        clip.CompactKeys();
+    }
+    irep.ComputeCurveMagnitudes();
+    Log::Info("IRepProcessor::RemoveUnusedBones: removed %d of %d bones (%d unused bones kept because of non-uniform scale)\n",
+        numRemoved, numBones, numKept);
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::LimitSkinInfluences(IRep& irep, int maxInfluences) {
+    if (!(irep.HasVertexAttr(VertexAttr::Weights) && irep.HasVertexAttr(VertexAttr::Indices))) {
+        return;
+    }
+    Log::FailIf((maxInfluences < 1) || (maxInfluences > 4), "IRepProcessor::LimitSkinInfluences: invalid max influences\n");
+
+    int numInfluences[5] = { };
+    int numLimited = 0;
+    float maxDroppedWeight = 0.0f;
+    for (auto& node : irep.Nodes) {
+        for (auto& mesh : node.Meshes) {
+            for (auto& vtx : mesh.Vertices) {
+                glm::vec4& weights = vtx[VertexAttr::Weights];
+                glm::vec4& indices = vtx[VertexAttr::Indices];
+
+                // vertices without any weight are rigid (see IRep::IsSkinned),
+                // and stay unweighted
+                if (weights == glm::vec4(0.0f)) {
+                    numInfluences[0]++;
+                    continue;
+                }
+
+                // sort influences by descending weight
+                int order[4] = { 0, 1, 2, 3 };
+                std::stable_sort(order, order + 4, [&weights](int a, int b) {
+                    return weights[a] > weights[b];
+                });
+                glm::vec4 w(0.0f), ix(0.0f);
+                for (int i = 0; i < 4; i++) {
+                    w[i] = glm::max(weights[order[i]], 0.0f);
+                    ix[i] = indices[order[i]];
+                }
+
+                // drop the smallest influences and renormalize
+                float sum = 0.0f;
+                for (int i = 0; i < 4; i++) {
+                    if (i >= maxInfluences) {
+                        if (w[i] > 0.0f) {
+                            maxDroppedWeight = glm::max(maxDroppedWeight, w[i]);
+                            numLimited++;
+                        }
+                        w[i] = 0.0f;
+                    }
+                    sum += w[i];
+                }
+                if (sum <= 0.0f) {
+                    w = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+                    sum = 1.0f;
+                }
+
+                // quantize to 8 bits so that the weights add up to exactly
+                // 255, distribute the rounding remainder by largest fraction
+                int q[4];
+                float frac[4];
+                int qsum = 0;
+                for (int i = 0; i < 4; i++) {
+                    const float f = (w[i] / sum) * 255.0f;
+                    q[i] = int(glm::floor(f));
+                    frac[i] = f - float(q[i]);
+                    qsum += q[i];
+                }
+                for (; qsum < 255; qsum++) {
+                    int best = 0;
+                    for (int i = 1; i < 4; i++) {
+                        if (frac[i] > frac[best]) {
+                            best = i;
+                        }
+                    }
+                    q[best]++;
+                    frac[best] = -1.0f;
+                }
+
+                // store weights as exact multiples of 1/255, so that the
+                // UByte4N encoding is lossless, unused influences point to
+                // the main bone
+                int num = 0;
+                for (int i = 0; i < 4; i++) {
+                    weights[i] = float(q[i]) / 255.0f;
+                    indices[i] = (q[i] > 0) ? ix[i] : ix[0];
+                    num += (q[i] > 0) ? 1 : 0;
+                }
+                numInfluences[num]++;
+            }
+        }
+    }
+    Log::Info("IRepProcessor::LimitSkinInfluences: vertices with 0/1/2/3/4 influences: %d/%d/%d/%d/%d, "
+        "%d influences dropped (max weight %f)\n",
+        numInfluences[0], numInfluences[1], numInfluences[2], numInfluences[3], numInfluences[4], numLimited, maxDroppedWeight);
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::SplitJointPalettes(IRep& irep, int maxPaletteSize) {
+    if (!(irep.HasVertexAttr(VertexAttr::Weights) && irep.HasVertexAttr(VertexAttr::Indices))) {
+        return;
+    }
+    struct paletteMesh {
+        IRep::Mesh Mesh;
+        unordered_map<int, int> BoneToJoint;
+        unordered_map<int, int> VertexMap;
+    };
+    const int numMeshes = irep.NumMeshes();
+    int maxJoints = 0;
+    for (auto& node : irep.Nodes) {
+        vector<IRep::Mesh> meshes;
+        for (const auto& src : node.Meshes) {
+            if (src.Indices.empty()) {
+                meshes.push_back(src);
+                continue;
+            }
+            // distribute triangles first-fit into sub-meshes, each triangle
+            // goes into the first sub-mesh which can take its bones
+            vector<paletteMesh> subMeshes;
+            for (int tri = 0; tri < int(src.Indices.size()) / 3; tri++) {
+                int triBones[12];
+                int numTriBones = 0;
+                for (int v = 0; v < 3; v++) {
+                    const auto& vtx = src.Vertices[src.Indices[tri * 3 + v]];
+                    for (int i = 0; i < 4; i++) {
+                        const int boneIndex = src.BoneIndex(vtx, i);
+                        if ((vtx[VertexAttr::Weights][i] > 0.0f) &&
+                            (std::find(triBones, triBones + numTriBones, boneIndex) == triBones + numTriBones)) {
+                            triBones[numTriBones++] = boneIndex;
+                        }
+                    }
+                }
+                Log::FailIf(numTriBones > maxPaletteSize,
+                    "IRepProcessor::SplitJointPalettes: triangle needs %d bones, max palette size is %d\n",
+                    numTriBones, maxPaletteSize);
+                paletteMesh* dst = nullptr;
+                for (auto& sub : subMeshes) {
+                    int numNew = 0;
+                    for (int i = 0; i < numTriBones; i++) {
+                        numNew += sub.BoneToJoint.count(triBones[i]) ? 0 : 1;
+                    }
+                    if ((int(sub.Mesh.JointPalette.size()) + numNew) <= maxPaletteSize) {
+                        dst = &sub;
+                        break;
+                    }
+                }
+                if (!dst) {
+                    subMeshes.push_back(paletteMesh());
+                    dst = &subMeshes.back();
+                    dst->Mesh.Material = src.Material;
+                }
+                for (int i = 0; i < numTriBones; i++) {
+                    if (!dst->BoneToJoint.count(triBones[i])) {
+                        dst->BoneToJoint[triBones[i]] = dst->Mesh.JointPalette.size();
+                        dst->Mesh.JointPalette.push_back(triBones[i]);
+                    }
+                }
+
+                // copy vertices with palette-local bone indices
+                for (int v = 0; v < 3; v++) {
+                    const int srcIndex = src.Indices[tri * 3 + v];
+                    auto iter = dst->VertexMap.find(srcIndex);
+                    if (iter == dst->VertexMap.end()) {
+                        IRep::Vertex vtx = src.Vertices[srcIndex];
+                        for (int i = 0; i < 4; i++) {
+                            const int boneIndex = src.BoneIndex(src.Vertices[srcIndex], i);
+                            const bool weighted = vtx[VertexAttr::Weights][i] > 0.0f;
+                            vtx[VertexAttr::Indices][i] = weighted ? float(dst->BoneToJoint[boneIndex]) : 0.0f;
+                        }
+                        iter = dst->VertexMap.insert(make_pair(srcIndex, int(dst->Mesh.Vertices.size()))).first;
+                        dst->Mesh.Vertices.push_back(vtx);
+                    }
+                    dst->Mesh.Indices.push_back(uint16_t(iter->second));
+                }
+            }
+            for (auto& sub : subMeshes) {
+                if (sub.Mesh.JointPalette.empty()) {
+                    // only unweighted vertices, which point to joint 0
+                    sub.Mesh.JointPalette.push_back(0);
+                }
+                maxJoints = glm::max(maxJoints, int(sub.Mesh.JointPalette.size()));
+                meshes.push_back(std::move(sub.Mesh));
+            }
+        }
+        node.Meshes = std::move(meshes);
+    }
+    Log::Info("IRepProcessor::SplitJointPalettes: %d meshes split into %d meshes (max %d joints per palette)\n",
+        numMeshes, irep.NumMeshes(), maxJoints);
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::OrderBonesByLod(IRep& irep, const vector<float>& lodLevels) {
+    const int numBones = irep.Bones.size();
+    if (numBones == 0) {
+        return;
+    }
+
+    // skinned vertex weight per bone
+    vector<float> weight(numBones, 0.0f);
+    float totalWeight = 0.0f;
+    if (irep.HasVertexAttr(VertexAttr::Weights) && irep.HasVertexAttr(VertexAttr::Indices)) {
+        for (const auto& node : irep.Nodes) {
+            for (const auto& mesh : node.Meshes) {
+                for (const auto& vtx : mesh.Vertices) {
+                    for (int i = 0; i < 4; i++) {
+                        const float w = vtx[VertexAttr::Weights][i];
+                        const int boneIndex = mesh.BoneIndex(vtx, i);
+                        if ((w > 0.0f) && (boneIndex < numBones)) {
+                            weight[boneIndex] += w;
+                            totalWeight += w;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // the importance of a bone is the skinned weight and size of its
+    // subtree, so a parent is never less important than its children
+    vector<float> subtreeWeight = weight;
+    vector<int> subtreeSize(numBones, 1);
+    for (int i = 0; i < numBones; i++) {
+        int depth = 0;
+        for (int p = irep.Bones[i].Parent; p != -1; p = irep.Bones[p].Parent) {
+            subtreeWeight[p] += weight[i];
+            subtreeSize[p]++;
+            Log::FailIf(++depth > numBones, "IRepProcessor::OrderBonesByLod: cycle in bone hierarchy\n");
+        }
+    }
+    vector<float> importance(numBones);
+    for (int i = 0; i < numBones; i++) {
+        importance[i] = float(subtreeSize[i]) / float(numBones);
+        if (totalWeight > 0.0f) {
+            importance[i] += subtreeWeight[i] / totalWeight;
+        }
+    }
+
+    // pick the most important bone whose parent is already placed
+    vector<int> order;
+    vector<bool> placed(numBones, false);
+    while (int(order.size()) < numBones) {
+        int best = -1;
+        for (int i = 0; i < numBones; i++) {
+            const int parent = irep.Bones[i].Parent;
+            if (!placed[i] && ((parent == -1) || placed[parent])) {
+                if ((best == -1) || (importance[i] > importance[best])) {
+                    best = i;
+                }
+            }
+        }
+        placed[best] = true;
+        order.push_back(best);
+    }
+    irep.ReorderBones(order);
+
+    // the LOD levels are prefixes of the ordered bones
+    irep.BoneLodCutoffs.clear();
+    for (float level : lodLevels) {
+        const int cutoff = glm::clamp(int(glm::ceil(level * numBones)), 1, numBones);
+        float lostWeight = 0.0f;
+        for (int i = cutoff; i < numBones; i++) {
+            lostWeight += weight[order[i]];
+        }
+        irep.BoneLodCutoffs.push_back(cutoff);
+        Log::Info("IRepProcessor::OrderBonesByLod: LOD %d: %d of %d bones, %.2f%% of skin weight reskinned to ancestors\n",
+            int(irep.BoneLodCutoffs.size()) - 1, cutoff, numBones,
+            (totalWeight > 0.0f) ? (100.0f * lostWeight / totalWeight) : 0.0f);
+    }
+}
+
+//------------------------------------------------------------------------------
+static uint64_t
+hashMaterial(const IRep::Material& mat) {
+    // hash over the material content, without the name
+    Hash hash;
+    hash.AddString(mat.Shader);
+    for (const auto& tex : mat.Textures) {
+        hash.AddString(tex.Name);
+        hash.AddString(tex.Location);
+    }
+    for (const auto& val : mat.Values) {
+        hash.AddString(val.Name);
+        hash.AddValue(int(val.Type));
+        hash.Add(&val.Value, IRep::PropType::NumFloats(val.Type) * sizeof(float));
+    }
+    return hash.Value;
+}
+
+//------------------------------------------------------------------------------
+static bool
+sameMaterial(const IRep::Material& m0, const IRep::Material& m1) {
+    if ((m0.Shader != m1.Shader) || (m0.Textures.size() != m1.Textures.size()) || (m0.Values.size() != m1.Values.size())) {
+        return false;
+    }
+    for (int i = 0; i < int(m0.Textures.size()); i++) {
+        if ((m0.Textures[i].Name != m1.Textures[i].Name) || (m0.Textures[i].Location != m1.Textures[i].Location)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < int(m0.Values.size()); i++) {
+        const auto& v0 = m0.Values[i];
+        const auto& v1 = m1.Values[i];
+        if ((v0.Name != v1.Name) || (v0.Type != v1.Type) ||
+            (0 != memcmp(&v0.Value, &v1.Value, IRep::PropType::NumFloats(v0.Type) * sizeof(float)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::MergeIdenticalMaterials(IRep& irep) {
+    // map content hashes to the new indices of the unique materials
+    unordered_map<uint64_t, vector<int>> uniqueMaterials;
+    vector<IRep::Material> materials;
+    vector<uint32_t> materialMap(irep.Materials.size());
+    for (int matIndex = 0; matIndex < int(irep.Materials.size()); matIndex++) {
+        const auto& mat = irep.Materials[matIndex];
+        auto& candidates = uniqueMaterials[hashMaterial(mat)];
+        int dst = -1;
+        for (int candidate : candidates) {
+            if (sameMaterial(materials[candidate], mat)) {
+                dst = candidate;
+                break;
+            }
+        }
+        if (dst == -1) {
+            dst = materials.size();
+            candidates.push_back(dst);
+            materials.push_back(mat);
+        }
+        materialMap[matIndex] = dst;
+    }
+    for (auto& node : irep.Nodes) {
+        for (auto& mesh : node.Meshes) {
+            mesh.Material = materialMap[mesh.Material];
+        }
+    }
+    Log::Info("IRepProcessor::MergeIdenticalMaterials: %d materials merged into %d\n",
+        int(irep.Materials.size()), int(materials.size()));
+    irep.Materials = std::move(materials);
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::MergeMeshesByMaterial(IRep& irep) {
+    // a merged mesh takes the place of the first mesh with its material,
+    // a mesh which would overflow the 16-bit indices starts a new mesh,
+    // rigid and skinned meshes are never merged
+    const int numMeshes = irep.NumMeshes();
+    for (auto& node : irep.Nodes) {
+        vector<IRep::Mesh> meshes;
+        vector<bool> skinned;
+        for (auto& src : node.Meshes) {
+            const bool srcSkinned = irep.IsSkinned(src);
+            IRep::Mesh* dst = nullptr;
+            for (int i = 0; i < int(meshes.size()); i++) {
+                const IRep::Mesh& mesh = meshes[i];
+                if ((mesh.Material == src.Material) && (mesh.JointPalette == src.JointPalette) && (skinned[i] == srcSkinned) &&
+                    (int(mesh.Vertices.size() + src.Vertices.size()) <= IRep::MaxIndexedVertices)) {
+                    dst = &meshes[i];
+                    break;
+                }
+            }
+            if (!dst) {
+                meshes.push_back(std::move(src));
+                skinned.push_back(srcSkinned);
+                continue;
+            }
+            const int baseVertex = dst->Vertices.size();
+            dst->Vertices.insert(dst->Vertices.end(), src.Vertices.begin(), src.Vertices.end());
+            for (uint16_t index : src.Indices) {
+                dst->Indices.push_back(uint16_t(baseVertex + index));
+            }
+        }
+        node.Meshes = std::move(meshes);
+    }
+    Log::Info("IRepProcessor::MergeMeshesByMaterial: %d meshes merged into %d\n", numMeshes, irep.NumMeshes());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Transform a vertex attribute of all vertices as point (w = 1) or
+    direction (w = 0), optionally renormalized. Works on 4 vertices at
+    a time (transposed into x, y, z and w vectors), the attribute's w
+    component (e.g. a tangent sign) is kept.
+*/
+static void
+transformVertexAttr(vector<IRep::Vertex>& vertices, VertexAttr::Code attr, const glm::mat4& m, float w, bool normalize) {
+    const int num = vertices.size();
+    f4 col[4][3];
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 3; row++) {
+            col[c][row] = f4_splat((c == 3) ? m[c][row] * w : m[c][row]);
+        }
+    }
+    for (int base = 0; base < num; base += 4) {
+        // the last batch is padded with copies of the last vertex
+        glm::vec4 items[4];
+        for (int i = 0; i < 4; i++) {
+            items[i] = vertices[std::min(base + i, num - 1)][attr];
+        }
+        f4 x = f4_load(&items[0].x);
+        f4 y = f4_load(&items[1].x);
+        f4 z = f4_load(&items[2].x);
+        f4 ws = f4_load(&items[3].x);
+        f4_transpose(x, y, z, ws);
+        f4 r[3];
+        for (int row = 0; row < 3; row++) {
+            r[row] = f4_add(f4_add(f4_mul(x, col[0][row]), f4_mul(y, col[1][row])), f4_add(f4_mul(z, col[2][row]), col[3][row]));
+        }
+        if (normalize) {
+            // zero-length vectors stay zero
+            const f4 len2 = f4_add(f4_add(f4_mul(r[0], r[0]), f4_mul(r[1], r[1])), f4_mul(r[2], r[2]));
+            const f4 invLen = f4_rsqrt(f4_max(len2, f4_splat(1e-30f)));
+            for (int row = 0; row < 3; row++) {
+                r[row] = f4_mul(r[row], invLen);
+            }
+        }
+        f4_transpose(r[0], r[1], r[2], ws);
+        f4_store(&items[0].x, r[0]);
+        f4_store(&items[1].x, r[1]);
+        f4_store(&items[2].x, r[2]);
+        f4_store(&items[3].x, ws);
+        for (int i = 0; (i < 4) && ((base + i) < num); i++) {
+            vertices[base + i][attr] = items[i];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the handedness of a vertex tangent frame (-1 if the binormal points
+    away from normal x tangent, otherwise +1).
+*/
+static float
+frameHandedness(const IRep::Vertex& vtx) {
+    const glm::vec3 nxt = glm::cross(glm::vec3(vtx[VertexAttr::Normal]), glm::vec3(vtx[VertexAttr::Tangent]));
+    return (glm::dot(nxt, glm::vec3(vtx[VertexAttr::Binormal])) < 0.0f) ? -1.0f : 1.0f;
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::BakeNodeTransforms(IRep& irep) {
+    // rigid meshes are transformed into the space of the first root node
+    // and moved there, skinned meshes stay in their nodes (their vertices
+    // follow the bones), without skinned meshes only one root node with
+    // all transforms baked into the vertices remains
+    if (irep.Nodes.empty()) {
+        return;
+    }
+    int rootIndex = 0;
+    for (int nodeIndex = 0; nodeIndex < int(irep.Nodes.size()); nodeIndex++) {
+        if (irep.Nodes[nodeIndex].Parent == -1) {
+            rootIndex = nodeIndex;
+            break;
+        }
+    }
+    bool hasSkinnedMeshes = false;
+    for (const auto& node : irep.Nodes) {
+        for (const auto& mesh : node.Meshes) {
+            hasSkinnedMeshes |= irep.IsSkinned(mesh);
+        }
+    }
+    vector<glm::mat4> model = irep.NodeModelMatrices();
+    if (hasSkinnedMeshes) {
+        // the root node and its transform are kept
+        const glm::mat4 invRoot = glm::inverse(model[rootIndex]);
+        for (auto& m : model) {
+            m = invRoot * m;
+        }
+    }
+    const int numNodes = irep.Nodes.size();
+    vector<IRep::Mesh> rigidMeshes;
+    int numBakedNodes = 0;
+    for (int nodeIndex = 0; nodeIndex < numNodes; nodeIndex++) {
+        IRep::Node& node = irep.Nodes[nodeIndex];
+        vector<IRep::Mesh> skinnedMeshes;
+        const int numRigidMeshes = rigidMeshes.size();
+        const glm::mat4& m = model[nodeIndex];
+        const glm::mat4 normalMatrix(glm::transpose(glm::inverse(glm::mat3(m))));
+        const glm::mat4 dirMatrix = glm::mat4(glm::mat3(m));
+        // a mirroring transform flips the triangle winding and the
+        // handedness of the tangent frame
+        const bool mirrored = glm::determinant(glm::mat3(m)) < 0.0f;
+        const bool checkHandedness = irep.HasVertexAttr(VertexAttr::Normal) &&
+                                     irep.HasVertexAttr(VertexAttr::Tangent) &&
+                                     irep.HasVertexAttr(VertexAttr::Binormal);
+        vector<float> handedness;
+        for (auto& mesh : node.Meshes) {
+            if (irep.IsSkinned(mesh)) {
+                skinnedMeshes.push_back(std::move(mesh));
+                continue;
+            }
+            if (checkHandedness) {
+                // source handedness, the baked binormal is negated where it doesn't match
+                handedness.resize(mesh.Vertices.size());
+                for (int i = 0; i < int(mesh.Vertices.size()); i++) {
+                    const float h = frameHandedness(mesh.Vertices[i]);
+                    handedness[i] = mirrored ? -h : h;
+                }
+            }
+            if (irep.HasVertexAttr(VertexAttr::Position)) {
+                transformVertexAttr(mesh.Vertices, VertexAttr::Position, m, 1.0f, false);
+            }
+            if (irep.HasVertexAttr(VertexAttr::Normal)) {
+                transformVertexAttr(mesh.Vertices, VertexAttr::Normal, normalMatrix, 0.0f, true);
+            }
+            if (irep.HasVertexAttr(VertexAttr::Tangent)) {
+                transformVertexAttr(mesh.Vertices, VertexAttr::Tangent, dirMatrix, 0.0f, true);
+            }
+            if (irep.HasVertexAttr(VertexAttr::Binormal)) {
+                transformVertexAttr(mesh.Vertices, VertexAttr::Binormal, dirMatrix, 0.0f, true);
+            }
+            if (checkHandedness) {
+                for (int i = 0; i < int(mesh.Vertices.size()); i++) {
+                    auto& vtx = mesh.Vertices[i];
+                    if (frameHandedness(vtx) != handedness[i]) {
+                        vtx[VertexAttr::Binormal] = glm::vec4(-glm::vec3(vtx[VertexAttr::Binormal]), vtx[VertexAttr::Binormal].w);
+                    }
+                }
+            }
+            if (mirrored) {
+                for (int i = 0; i + 2 < int(mesh.Indices.size()); i += 3) {
+                    std::swap(mesh.Indices[i + 1], mesh.Indices[i + 2]);
+                }
+            }
+            rigidMeshes.push_back(std::move(mesh));
+        }
+        node.Meshes = std::move(skinnedMeshes);
+        numBakedNodes += (int(rigidMeshes.size()) > numRigidMeshes) ? 1 : 0;
+    }
+    if (hasSkinnedMeshes) {
+        auto& rootMeshes = irep.Nodes[rootIndex].Meshes;
+        rootMeshes.insert(rootMeshes.end(), std::make_move_iterator(rigidMeshes.begin()), std::make_move_iterator(rigidMeshes.end()));
+        Log::Info("IRepProcessor::BakeNodeTransforms: rigid meshes of %d nodes baked into root node, keeping node hierarchy of skinned meshes\n", numBakedNodes);
+    }
+    else {
+        IRep::Node root;
+        root.Name = irep.Nodes[rootIndex].Name;
+        root.Meshes = std::move(rigidMeshes);
+        irep.Nodes.clear();
+        irep.Nodes.push_back(std::move(root));
+        Log::Info("IRepProcessor::BakeNodeTransforms: %d nodes flattened\n", numNodes);
+    }
+    this->MergeMeshesByMaterial(irep);
+    irep.ComputeVertexMagnitude();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Interleave the bits of 10-bit grid cell coordinates.
+*/
+static uint32_t
+mortonCode(uint32_t x, uint32_t y, uint32_t z) {
+    auto spread = [](uint32_t v) {
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+//------------------------------------------------------------------------------
+void
+IRepProcessor::SplitSpatialChunks(IRep& irep, float chunkSize) {
+    // triangles go into the grid cell of their centroid, the grid starts
+    // at the min corner of the node's vertices, chunk nodes are added
+    // in Morton order of their cells, so that near chunks are written
+    // next to each other
+    const int numNodes = irep.Nodes.size();
+    const int numMeshes = irep.NumMeshes();
+    int numSplitNodes = 0;
+    vector<IRep::Node> chunks;
+    for (int nodeIndex = 0; nodeIndex < numNodes; nodeIndex++) {
+        IRep::Node& node = irep.Nodes[nodeIndex];
+        bool isStatic = !node.Meshes.empty() && (node.SpatialChunk == -1);
+        glm::vec3 minPos(FLT_MAX);
+        glm::vec3 maxPos(-FLT_MAX);
+        for (const auto& mesh : node.Meshes) {
+            isStatic &= !irep.IsSkinned(mesh);
+            for (const auto& vtx : mesh.Vertices) {
+                minPos = glm::min(minPos, glm::vec3(vtx[VertexAttr::Position]));
+                maxPos = glm::max(maxPos, glm::vec3(vtx[VertexAttr::Position]));
+            }
+        }
+        if (!isStatic) {
+            continue;
+        }
+
+        // Morton codes hold 10 bits per axis, grow the cells of huge
+        // nodes so that they need at most 1024 cells per axis
+        const glm::vec3 extent = maxPos - minPos;
+        const float maxExtent = glm::max(extent.x, glm::max(extent.y, extent.z));
+        float cellSize = chunkSize;
+        if (maxExtent / chunkSize > 1023.0f) {
+            cellSize = maxExtent / 1023.0f;
+            Log::Warn("IRepProcessor::SplitSpatialChunks: node '%s' needs more than 1024 chunks per axis, chunk size raised from %f to %f\n",
+                node.Name.c_str(), chunkSize, cellSize);
+        }
+
+        // the first index of the triangles of each mesh in each cell
+        map<uint32_t, vector<vector<int>>> cells;
+        for (int meshIndex = 0; meshIndex < int(node.Meshes.size()); meshIndex++) {
+            const IRep::Mesh& mesh = node.Meshes[meshIndex];
+            for (int i = 0; i + 2 < int(mesh.Indices.size()); i += 3) {
+                const glm::vec3 centroid = (glm::vec3(mesh.Vertices[mesh.Indices[i]][VertexAttr::Position]) +
+                                            glm::vec3(mesh.Vertices[mesh.Indices[i + 1]][VertexAttr::Position]) +
+                                            glm::vec3(mesh.Vertices[mesh.Indices[i + 2]][VertexAttr::Position])) / 3.0f;
+                const glm::vec3 cell = glm::min(glm::floor((centroid - minPos) / cellSize), glm::vec3(1023.0f));
+                auto& cellMeshes = cells[mortonCode(uint32_t(cell.x), uint32_t(cell.y), uint32_t(cell.z))];
+                cellMeshes.resize(node.Meshes.size());
+                cellMeshes[meshIndex].push_back(i);
+            }
+        }
+        if (cells.size() < 2) {
+            continue;
+        }
+        numSplitNodes++;
+
+        // build the chunk meshes, only with the vertices of their triangles
+        for (const auto& cell : cells) {
+            IRep::Node chunk;
+            chunk.Name = node.Name + "_chunk" + to_string(cell.first);
+            chunk.Parent = nodeIndex;
+            chunk.SpatialChunk = cell.first;
+            for (int meshIndex = 0; meshIndex < int(node.Meshes.size()); meshIndex++) {
+                if (cell.second[meshIndex].empty()) {
+                    continue;
+                }
+                const IRep::Mesh& src = node.Meshes[meshIndex];
+                IRep::Mesh dst;
+                dst.Material = src.Material;
+                dst.JointPalette = src.JointPalette;
+                vector<int> remap(src.Vertices.size(), -1);
+                for (int first : cell.second[meshIndex]) {
+                    for (int i = first; i < first + 3; i++) {
+                        const uint16_t index = src.Indices[i];
+                        if (remap[index] == -1) {
+                            remap[index] = dst.Vertices.size();
+                            dst.Vertices.push_back(src.Vertices[index]);
+                        }
+                        dst.Indices.push_back(uint16_t(remap[index]));
+                    }
+                }
+                chunk.Meshes.push_back(std::move(dst));
+            }
+            chunks.push_back(std::move(chunk));
+        }
+        node.Meshes.clear();
+    }
+    const int numChunks = chunks.size();
+    for (auto& chunk : chunks) {
+        irep.Nodes.push_back(std::move(chunk));
+    }
+    Log::Info("IRepProcessor::SplitSpatialChunks: %d nodes split into %d chunks, %d meshes into %d\n",
+        numSplitNodes, numChunks, numMeshes, irep.NumMeshes());
+}
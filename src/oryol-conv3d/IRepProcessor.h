@@ -13,6 +13,24 @@ struct IRepProcessor {
     std::vector<std::string> Nodes;
     /// if not empty, non-matching anim clips will be dropped
     std::vector<std::string> Clips;
+    /// if > 0, turn anim curves with less key variation into static curves
+    float AnimCurveEpsilon = 0.0f;
+    /// if true, identical anim curves share their keys
+    bool ShareAnimCurves = false;
+    /// if true, remove bones which are neither skinned nor animated
+    bool PruneBones = false;
+    /// if > 0, max number of skin influences per vertex (1, 2 or 4), also quantizes skin weights (unweighted vertices stay rigid)
+    int MaxSkinInfluences = 0;
+    /// if > 0, split skinned meshes into sub-meshes with local joint palettes of this max size
+    int MaxJointPaletteSize = 0;
+    /// if not empty, order bones by importance, with these fractions of bones per skeleton LOD level
+    std::vector<float> BoneLodLevels;
+    /// if true, merge identical materials, and merge the meshes of a node which share a material
+    bool MergeMaterials = false;
+    /// if true, bake node transforms into the vertices of static models, and merge all nodes into one
+    bool FlattenHierarchy = false;
+    /// if > 0, split the triangles of static nodes into child nodes per grid cell of this size
+    float SpatialChunkSize = 0.0f;
 
     /// reset processor into its empty state
     void Clear();
@@ -29,4 +47,24 @@ struct IRepProcessor {
     void RemoveVertices(IRep& irep, int first, int num);
     /// remove an index range and fix meshes
     void RemoveIndices(IRep& irep, int first, int num);    
+    /// make near-constant anim curves static, and flag static curves matching the bind pose
+    void OptimizeAnimCurves(IRep& irep, float epsilon);
+    /// find identical anim curves (in all clips) and let them share their keys
+    void ShareCurveKeys(IRep& irep);
+    /// remove bones without skinned vertices and animated curves, reparent their children
+    void RemoveUnusedBones(IRep& irep);
+    /// sort and limit skin influences, and quantize weights to sum up to exactly 255
+    void LimitSkinInfluences(IRep& irep, int maxInfluences);
+    /// split skinned meshes into sub-meshes which reference at most maxPaletteSize bones
+    void SplitJointPalettes(IRep& irep, int maxPaletteSize);
+    /// order bones by importance (parents-first), and setup skeleton LOD cutoffs
+    void OrderBonesByLod(IRep& irep, const std::vector<float>& lodLevels);
+    /// merge materials with identical shader, textures and values (ignoring the name)
+    void MergeIdenticalMaterials(IRep& irep);
+    /// concatenate the meshes of each node which share a material (and joint palette)
+    void MergeMeshesByMaterial(IRep& irep);
+    /// transform rigid meshes by their accumulated node transform, move them into one root node and merge them by material
+    void BakeNodeTransforms(IRep& irep);
+    /// split the meshes of static nodes into spatial chunk child nodes (one per grid cell, in Morton order)
+    void SplitSpatialChunks(IRep& irep, float chunkSize);
 };
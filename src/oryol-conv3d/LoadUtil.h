@@ -20,6 +20,30 @@ inline const uint8_t* load_file(const std::string& path) {
     return (const uint8_t*) ptr;
 }
 
+//------------------------------------------------------------------------------
+inline const uint8_t* try_load_file(const std::string& path, int& outSize) {
+    // NOTE: like load_file(), but returns a nullptr instead of exiting on
+    // failure, so this can be called from worker threads
+    outSize = 0;
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return nullptr;
+    }
+    fseek(fp, 0, SEEK_END);
+    int size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* ptr = (uint8_t*) malloc(size + 1);
+    int bytesRead = fread((void*)ptr, 1, size, fp);
+    fclose(fp);
+    if (bytesRead != size) {
+        free((void*)ptr);
+        return nullptr;
+    }
+    ptr[size] = 0;
+    outSize = size;
+    return (const uint8_t*) ptr;
+}
+
 //------------------------------------------------------------------------------
 inline void free_file_data(const uint8_t* ptr) {
     free((void*)ptr);
@@ -585,18 +585,22 @@ N3Loader::toIRep(IRep& irep) {
         }
     }
 
-    // anim clips and curves
-    for (const auto& nax3Clip : this->nax3Loader.Clips) {
+    // anim clips and curves, the key data is moved over from the NAX3 loader
+    // since the NAX3 key layout matches the IRep key types
+    for (auto& nax3Clip : this->nax3Loader.Clips) {
         irep.AnimClips.push_back(IRep::AnimClip());
         auto& clip = irep.AnimClips.back();
         clip.Name = nax3Clip.Name;
         clip.KeyDuration = nax3Clip.KeyDuration;
+        clip.Length = nax3Clip.NumKeys;
         for (const auto& nax3Curve : nax3Clip.Curves) {
             clip.Curves.push_back(IRep::AnimCurve());
             auto& curve = clip.Curves.back();
-            curve.IsStatic = nax3Curve.IsStatic;
+            // inactive curves have no keys, treat them as static
+            curve.IsStatic = nax3Curve.IsStatic || (nax3Curve.NumKeys == 0);
             curve.StaticKey = nax3Curve.StaticKey;
-            curve.Keys = nax3Curve.Keys;
+            curve.KeyOffset = nax3Curve.KeyOffset;
+            curve.NumKeys = nax3Curve.NumKeys;
             switch (nax3Curve.Type) {
                 case NAX3Loader::CurveType::Translation:
                 case NAX3Loader::CurveType::Scale:
@@ -611,7 +615,10 @@ N3Loader::toIRep(IRep& irep) {
                     curve.Type = IRep::KeyType::Float4;
                     break;
             }
+            Log::FailIf(IRep::KeyType::NumComponents(curve.Type) != NAX3Loader::CurveType::NumKeyComponents(nax3Curve.Type),
+                "Anim key size mismatch!\n");
         }
+        clip.KeyData = std::move(nax3Clip.KeyData);
     }
     irep.ComputeCurveMagnitudes();
 }
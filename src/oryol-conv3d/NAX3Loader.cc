@@ -3,8 +3,11 @@
 //------------------------------------------------------------------------------
 #include "NAX3Loader.h"
 #include "ExportUtil/Log.h"
+#include "ExportUtil/Parallel.h"
 #include "LoadUtil.h"
 #include "pystring.h"
+#include <algorithm>
+#include <string.h>
 
 using namespace OryolTools;
 
@@ -31,16 +34,19 @@ NAX3Loader::Load(const std::string& nax3AssetName, const std::string& n3AssetDir
     Log::FailIf(nax3Hdr->Magic != 'NAH0', "Magic number mismatch for '%s'\n", path.c_str());
     ptr += sizeof(Nax3Header);
 
-    // read clips
-    this->Clips.reserve(nax3Hdr->NumClips);
+    // read clips, the key data is loaded from separate clip files
+    // afterwards, the clip slots are preallocated so that the
+    // clips end up in a deterministic order
+    std::vector<nacJob> jobs;
+    this->Clips.resize(nax3Hdr->NumClips);
     for (int clipIndex = 0; clipIndex < int(nax3Hdr->NumClips); clipIndex++) {
         const Nax3Clip* nax3Clip = (const Nax3Clip*) ptr;
         ptr += sizeof(Nax3Clip);
-        this->Clips.push_back(Clip());
-        auto& clip = this->Clips.back();
+        auto& clip = this->Clips[clipIndex];
         clip.Name = (const char*) nax3Clip->Name;
         clip.KeyDuration = float(nax3Clip->KeyDuration) / 1000.0f;
-        clip.Curves.reserve(nax3Clip->NumCurves);
+        clip.NumKeys = nax3Clip->NumKeys;
+        clip.Curves.resize(nax3Clip->NumCurves);
         
         // skip anim events
         ptr += nax3Clip->NumEvents * sizeof(Nax3AnimEvent);
@@ -50,8 +56,7 @@ NAX3Loader::Load(const std::string& nax3AssetName, const std::string& n3AssetDir
         bool clipHasKeyData = false;
         for (int curveIndex = 0; curveIndex < nax3Clip->NumCurves; curveIndex++) {
             const Nax3Curve* nax3Curve = &nax3Curves[curveIndex];
-            clip.Curves.push_back(Curve());
-            auto& curve = clip.Curves.back();
+            auto& curve = clip.Curves[curveIndex];
             curve.IsStatic = nax3Curve->IsStatic;
             curve.IsActive = nax3Curve->IsActive;
             curve.Type = (CurveType::Enum) nax3Curve->CurveType;
@@ -59,64 +64,115 @@ NAX3Loader::Load(const std::string& nax3AssetName, const std::string& n3AssetDir
                 curve.StaticKey[i] = nax3Curve->StaticKey[i];
             }
             if (!curve.IsStatic && curve.IsActive) {
-                curve.Keys.reserve(nax3Clip->NumKeys);
                 clipHasKeyData = true;
             }
         }
         ptr += sizeof(Nax3Curve) * nax3Clip->NumCurves;
 
-        // load anim keys from separate clip file
         if (clipHasKeyData) {
-            std::string nacPath = n3AssetDir + "/anims/";
-            nacPath += pystring::replace(nax3AssetName, "_animations.nax3", "");
-            nacPath += "_" + clip.Name + ".nac";
-            const uint8_t* nacStart = load_file(nacPath);
-            const uint8_t* nacPtr = nacStart;
-            const Nac3Header* nac3Hdr = (const Nac3Header*) nacPtr;
-            Log::FailIf(nac3Hdr->Magic != 'NAC0', "Magic number mismatch for clip file '%s'\n", nacPath.c_str());
-            nacPtr += sizeof(Nac3Header);
-            const int numCurves = nax3Clip->NumCurves;
-            const int numKeys = nax3Clip->NumKeys;
-            for (int keyIndex = 0; keyIndex < numKeys; keyIndex++) {
-                for (int curveIndex = 0; curveIndex < numCurves; curveIndex++) {
-                    const Nax3Curve* nax3Curve = &nax3Curves[curveIndex];
-                    if (!nax3Curve->IsStatic && nax3Curve->IsActive) {
-                        glm::vec4 dstKey;
-                        if (nax3Curve->CurveType == CurveType::Rotation) {
-                            // this is a packed quaternion with 16-bit components
-                            const float div = (const float) 0x7FFF;
-                            for (int i = 0; i < 4; i++) {
-                                dstKey[i] = (float)((int16_t*)nacPtr)[i] / div;
-                            }
-                            nacPtr += 8;
-                        }
-                        else {
-                            // unpacked, 4 float components
-                            for (int i = 0; i < 4; i++) {
-                                dstKey[i] = ((float*)nacPtr)[i];
-                            }
-                            nacPtr += 16;
-                        }
-                        clip.Curves[curveIndex].Keys.push_back(dstKey);
-                    }
-                }
-            }
-            free_file_data(nacStart);
+            nacJob job;
+            job.ClipIndex = clipIndex;
+            job.Path = n3AssetDir + "/anims/";
+            job.Path += pystring::replace(nax3AssetName, "_animations.nax3", "");
+            job.Path += "_" + clip.Name + ".nac";
+            jobs.push_back(job);
         }
+    }
 
-        // for each non-static curve, init its static key with the first
-        // curve key, this way they static key information can be
-        // used as a approximate placeholder even if the actual
-        // curve data isn't available yet
+    // load and decode the clip files in parallel
+    ParallelFor(jobs.size(), [this, &jobs](int i) {
+        jobs[i].Error = this->loadClipKeys(jobs[i].Path, this->Clips[jobs[i].ClipIndex]);
+    });
+    // errors are only reported once all workers are done
+    for (const auto& job : jobs) {
+        Log::FailIf(!job.Error.empty(), "%s", job.Error.c_str());
+    }
+
+    // for each non-static curve, init its static key with the first
+    // curve key, this way they static key information can be
+    // used as a approximate placeholder even if the actual
+    // curve data isn't available yet
+    for (auto& clip : this->Clips) {
         for (auto& curve : clip.Curves) {
-            if (!curve.Keys.empty()) {
-                curve.StaticKey = curve.Keys[0];
+            if (curve.NumKeys > 0) {
+                const int num = CurveType::NumKeyComponents(curve.Type);
+                for (int i = 0; i < num; i++) {
+                    curve.StaticKey[i] = clip.KeyData[curve.KeyOffset + i];
+                }
             }
         }
     }
     free_file_data(start);
 }
 
+//------------------------------------------------------------------------------
+std::string
+NAX3Loader::loadClipKeys(const std::string& nacPath, Clip& clip) {
+    // NOTE: this is called from worker threads, and must only touch the clip,
+    // errors are returned instead of calling Log::FailIf()
+    int nacSize = 0;
+    const uint8_t* nacStart = try_load_file(nacPath, nacSize);
+    if (!nacStart) {
+        return "Failed to load clip file '" + nacPath + "'\n";
+    }
+    const uint8_t* nacPtr = nacStart;
+    const Nac3Header* nac3Hdr = (const Nac3Header*) nacPtr;
+    if ((nacSize < int(sizeof(Nac3Header))) || (nac3Hdr->Magic != 'NAC0')) {
+        free_file_data(nacStart);
+        return "Magic number mismatch for clip file '" + nacPath + "'\n";
+    }
+    nacPtr += sizeof(Nac3Header);
+
+    // presize the key data, each animated curve gets one block
+    // of type-sized keys
+    std::vector<Curve*> curves;
+    int keyDataSize = 0;
+    for (auto& curve : clip.Curves) {
+        if (!curve.IsStatic && curve.IsActive) {
+            curve.KeyOffset = keyDataSize;
+            curve.NumKeys = clip.NumKeys;
+            keyDataSize += clip.NumKeys * CurveType::NumKeyComponents(curve.Type);
+            curves.push_back(&curve);
+        }
+    }
+    clip.KeyData.resize(keyDataSize);
+    int keyBytes = 0;
+    for (const Curve* curve : curves) {
+        keyBytes += (curve->Type == CurveType::Rotation) ? 4 * sizeof(int16_t) : 4 * sizeof(float);
+    }
+    if ((nacSize - int(sizeof(Nac3Header))) < (keyBytes * clip.NumKeys)) {
+        free_file_data(nacStart);
+        return "Clip file '" + nacPath + "' is truncated\n";
+    }
+
+    // keys are stored interleaved in the file, all animated curves key by key
+    const float div = float(0x7FFF);
+    const int numCurves = curves.size();
+    for (int keyIndex = 0; keyIndex < clip.NumKeys; keyIndex++) {
+        for (int curveIndex = 0; curveIndex < numCurves; curveIndex++) {
+            const Curve* curve = curves[curveIndex];
+            const int num = CurveType::NumKeyComponents(curve->Type);
+            float* dstKey = &clip.KeyData[curve->KeyOffset + keyIndex * num];
+            if (curve->Type == CurveType::Rotation) {
+                // this is a packed quaternion with 16-bit components
+                int16_t src[4];
+                memcpy(src, nacPtr, sizeof(src));
+                for (int i = 0; i < 4; i++) {
+                    dstKey[i] = float(src[i]) / div;
+                }
+                nacPtr += sizeof(src);
+            }
+            else {
+                // unpacked, 4 float components
+                memcpy(dstKey, nacPtr, num * sizeof(float));
+                nacPtr += 4 * sizeof(float);
+            }
+        }
+    }
+    free_file_data(nacStart);
+    return std::string();
+}
+
 //------------------------------------------------------------------------------
 void
 NAX3Loader::Validate() {
@@ -137,15 +193,11 @@ NAX3Loader::Validate() {
         }
     }
 
-    // all curves of a clip must either have no keys, or the same number of keys
+    // all curves of a clip must either have no keys, or the clip's number of keys
     for (const auto& clip : this->Clips) {
-        int numKeys = 0;
         for (const auto& curve : clip.Curves) {
-            if ((numKeys == 0) && !curve.Keys.empty()) {
-                numKeys = curve.Keys.size();
-            }
-            if (!curve.Keys.empty()) {
-                Log::FailIf(int(curve.Keys.size()) != numKeys, "Inconsistent number of keys in curves!\n");
+            if (curve.NumKeys > 0) {
+                Log::FailIf(curve.NumKeys != clip.NumKeys, "Inconsistent number of keys in curves!\n");
             }
         }
     }
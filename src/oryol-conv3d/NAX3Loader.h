@@ -40,6 +40,16 @@ struct NAX3Loader {
                 default: return "Invalid";
             }
         };
+        /// number of key components stored per key (translation and scale only need xyz)
+        static int NumKeyComponents(Enum e) {
+            switch (e) {
+                case Translation:
+                case Scale:
+                    return 3;
+                default:
+                    return 4;
+            }
+        };
     };
     /// an animation curve is a container for animation keys
     struct Curve {
@@ -47,17 +57,30 @@ struct NAX3Loader {
         bool IsActive = false;
         CurveType::Enum Type = CurveType::Invalid;
         glm::vec4 StaticKey;
-        std::vector<glm::vec4> Keys;
+        int KeyOffset = -1;     // index of the curve's first key component in the clip's KeyData
+        int NumKeys = 0;
     };
     /// an animation clip hols animation curves
     struct Clip {
         std::string Name;
         float KeyDuration = 0.0f;   // in seconds!
+        int NumKeys = 0;
         std::vector<Curve> Curves;
+        /// keys of all curves, curve by curve, CurveType::NumKeyComponents() floats per key
+        std::vector<float> KeyData;
     };
     /// all the clips
     std::vector<Clip> Clips;
 
+    /// a clip key file to load
+    struct nacJob {
+        int ClipIndex = 0;
+        std::string Path;
+        std::string Error;
+    };
+    /// load and decode the keys of a clip from its .nac file (called from worker threads), return error message or empty string
+    std::string loadClipKeys(const std::string& nacPath, Clip& clip);
+
     // NAX3 file format structs and constants
     #pragma pack(push, 1)
     struct Nax3Header {
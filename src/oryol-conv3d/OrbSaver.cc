@@ -2,12 +2,23 @@
 //  OrbSaver.cc
 //------------------------------------------------------------------------------
 #include <algorithm>
+#include <array>
+#include <map>
+#include <unordered_map>
 
 #include "OrbSaver.h"
 #include "ExportUtil/Log.h"
 #include "ExportUtil/VertexCodec.h"
+#include "ExportUtil/Hash.h"
+#include "AnimQuantizer.h"
+#include "AnimKeyEncoder.h"
+#include "BoundsBuilder.h"
+#include "BvhBuilder.h"
+#include "ProgressiveMeshBuilder.h"
 #include <glm/glm.hpp>
 #include <stdio.h>
+#include <string.h>
+#include <float.h>
 
 using namespace OryolTools;
 using namespace Oryol;
@@ -28,6 +39,18 @@ OrbSaver::addString(const std::string& str) {
     return index;
 }
 
+//------------------------------------------------------------------------------
+void
+OrbSaver::addChunk(uint32_t tag, const std::vector<uint8_t>& payload, bool inFront) {
+    Log::FailIf((payload.size() & 3) != 0, "Chunk payload size must be multiple of 4\n");
+    OrbChunkHeader hdr;
+    hdr.Tag = tag;
+    hdr.Size = payload.size();
+    std::vector<uint8_t>& dst = inFront ? this->frontChunks : this->chunks;
+    appendChunkItem(dst, hdr);
+    dst.insert(dst.end(), payload.begin(), payload.end());
+}
+
 //------------------------------------------------------------------------------
 static OrbVertexAttr::Enum
 toOrbVertexAttr(VertexAttr::Code attr) {
@@ -87,9 +110,254 @@ roundup4(uint32_t val) {
     return (val + 3) & ~3;
 }
 
+//------------------------------------------------------------------------------
+static uint64_t
+hashMesh(const IRep::Mesh& mesh) {
+    // hash over the material, joint palette, vertices and indices
+    Hash hash;
+    hash.AddValue(mesh.Material);
+    hash.Add(mesh.JointPalette.data(), mesh.JointPalette.size() * sizeof(int));
+    hash.Add(mesh.Vertices.data(), mesh.Vertices.size() * sizeof(IRep::Vertex));
+    hash.Add(mesh.Indices.data(), mesh.Indices.size() * sizeof(uint16_t));
+    return hash.Value;
+}
+
+//------------------------------------------------------------------------------
+static bool
+sameMesh(const IRep::Mesh& a, const IRep::Mesh& b) {
+    return (a.Material == b.Material) &&
+           (a.JointPalette == b.JointPalette) &&
+           (a.Indices == b.Indices) &&
+           (a.Vertices.size() == b.Vertices.size()) &&
+           (a.Vertices.empty() || (memcmp(&a.Vertices[0], &b.Vertices[0], a.Vertices.size() * sizeof(IRep::Vertex)) == 0));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compute the dequantization transform (value = decoded * scale + offset)
+    of a vertex attribute from the bounding box of its values in a group
+    of meshes. Returns false for non-normalized formats, which don't need
+    a transform.
+*/
+static bool
+quantizationRange(const std::vector<const IRep::Mesh*>& meshes, VertexAttr::Code attr, VertexFormat::Code fmt,
+                  glm::vec4& outOffset, glm::vec4& outScale) {
+    outOffset = glm::vec4(0.0f);
+    outScale = glm::vec4(1.0f);
+    const bool isSigned = (fmt == VertexFormat::Byte4N) || (fmt == VertexFormat::Short2N) || (fmt == VertexFormat::Short4N);
+    const bool isUnsigned = (fmt == VertexFormat::UByte4N);
+    if (!(isSigned || isUnsigned)) {
+        return false;
+    }
+    glm::vec4 minVal(FLT_MAX);
+    glm::vec4 maxVal(-FLT_MAX);
+    for (const IRep::Mesh* mesh : meshes) {
+        for (const auto& vtx : mesh->Vertices) {
+            minVal = glm::min(minVal, vtx[attr]);
+            maxVal = glm::max(maxVal, vtx[attr]);
+        }
+    }
+    if (minVal.x > maxVal.x) {
+        return true;
+    }
+    if (isSigned) {
+        outOffset = (minVal + maxVal) * 0.5f;
+        outScale = (maxVal - minVal) * 0.5f;
+    }
+    else {
+        outOffset = minVal;
+        outScale = maxVal - minVal;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (outScale[i] <= 0.0f) {
+            outScale[i] = 1.0f;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool
+OrbSaver::vertexTransform(const IRep& irep, const IRep::Node& node, const IRep::Mesh& mesh,
+                          VertexAttr::Code attr, VertexFormat::Code fmt,
+                          glm::vec4& outOffset, glm::vec4& outScale) const {
+    outOffset = glm::vec4(0.0f);
+    outScale = glm::vec4(1.0f);
+    const bool isTexCoord = (attr >= VertexAttr::TexCoord0) && (attr <= VertexAttr::TexCoord3);
+    if ((attr != VertexAttr::Position) && !isTexCoord) {
+        return false;
+    }
+    if (this->Quantization == VertexQuantization::Model) {
+        // 16-bit positions are scaled by the model-wide vertex magnitude
+        if ((attr == VertexAttr::Position) && ((fmt == VertexFormat::Short2) || (fmt == VertexFormat::Short4N))) {
+            outScale = glm::vec4(irep.VertexMagnitude, 1.0f);
+        }
+        return false;
+    }
+    std::vector<const IRep::Mesh*> meshes;
+    if (this->Quantization == VertexQuantization::Node) {
+        for (const auto& nodeMesh : node.Meshes) {
+            meshes.push_back(&nodeMesh);
+        }
+    }
+    else {
+        meshes.push_back(&mesh);
+    }
+    return quantizationRange(meshes, attr, fmt, outOffset, outScale);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Append the level ranges of a sorted hierarchy to a chunk payload,
+    returns the number of levels.
+*/
+template<class TYPE> static uint32_t
+appendHierarchyLevels(std::vector<uint8_t>& payload, const std::vector<TYPE>& items) {
+    std::vector<int> depth(items.size(), 0);
+    uint32_t numLevels = 0;
+    for (int i = 0; i < int(items.size()); i++) {
+        depth[i] = (items[i].Parent == -1) ? 0 : depth[items[i].Parent] + 1;
+        if (depth[i] == int(numLevels)) {
+            uint32_t first = i;
+            OrbSaver::appendChunkItem(payload, first);
+            numLevels++;
+        }
+    }
+    uint32_t end = items.size();
+    OrbSaver::appendChunkItem(payload, end);
+    return numLevels;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the value of a vertex attribute as written to the vertex data
+    (before quantization), with quaternion tangent frames the normal
+    is the Short4N quaternion.
+*/
+static glm::vec4
+vertexValue(const IRep::Vertex& vtx, VertexAttr::Code attr, bool qtangents) {
+    if (qtangents && (attr == VertexAttr::Normal)) {
+        uint8_t encoded[8];
+        VertexCodec::EncodeQTangent(encoded, glm::vec3(vtx[VertexAttr::Normal]), glm::vec3(vtx[VertexAttr::Tangent]), glm::vec3(vtx[VertexAttr::Binormal]));
+        glm::vec4 value;
+        VertexCodec::Decode<VertexFormat::Short4N>(&value.x, 1.0f, 0.0f, encoded, 4, 4);
+        return value;
+    }
+    return vtx[attr];
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the vertex layout of a mesh, this drops the attributes which are
+    constant across the mesh (including skin indices without skin weights),
+    their values go into outConstants.
+*/
+static VertexLayout
+meshVertexLayout(const IRep::Mesh& mesh, const VertexLayout& layout, bool qtangents, std::vector<OrbVertexConstant>& outConstants) {
+    VertexLayout result;
+    bool hasWeights = false;
+    for (const auto& vtx : mesh.Vertices) {
+        hasWeights |= vtx[VertexAttr::Weights] != glm::vec4(0.0f);
+    }
+    for (const auto& comp : layout.Components) {
+        glm::vec4 value(0.0f);
+        bool isConstant = (comp.Attr != VertexAttr::Position);
+        if (isConstant && ((comp.Attr != VertexAttr::Indices) || hasWeights) && !mesh.Vertices.empty()) {
+            value = vertexValue(mesh.Vertices[0], comp.Attr, qtangents);
+            for (const auto& vtx : mesh.Vertices) {
+                if (vertexValue(vtx, comp.Attr, qtangents) != value) {
+                    isConstant = false;
+                    break;
+                }
+            }
+        }
+        if (isConstant) {
+            OrbVertexConstant dst;
+            dst.Attr = toOrbVertexAttr(comp.Attr);
+            for (int i = 0; i < 4; i++) {
+                dst.Value[i] = value[i];
+            }
+            outConstants.push_back(dst);
+        }
+        else {
+            result.Components.push_back(comp);
+        }
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+static bool
+sameVertexLayout(const VertexLayout& l0, const VertexLayout& l1) {
+    if (l0.Components.size() != l1.Components.size()) {
+        return false;
+    }
+    for (int i = 0; i < int(l0.Components.size()); i++) {
+        if ((l0.Components[i].Attr != l1.Components[i].Attr) || (l0.Components[i].Format != l1.Components[i].Format)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 //------------------------------------------------------------------------------
 void
-OrbSaver::Save(const std::string& path, const IRep& irep) {
+OrbSaver::Save(const std::string& path, const IRep& srcIRep) {
+
+    this->strings.clear();
+    this->chunks.clear();
+    this->frontChunks.clear();
+
+    // bones and nodes are written parents-first, grouped by depth, and
+    // progressive meshes reorder their vertices and triangles, both on a copy
+    const bool isSorted = srcIRep.IsHierarchySorted();
+    const bool needsCopy = !isSorted || this->ProgressiveMeshes;
+    IRep dstIRep;
+    ProgressiveMeshBuilder progressive;
+    if (needsCopy) {
+        dstIRep = srcIRep;
+        if (!isSorted) {
+            dstIRep.SortHierarchy();
+        }
+        if (this->ProgressiveMeshes) {
+            progressive.Build(dstIRep);
+        }
+    }
+    const IRep& irep = needsCopy ? dstIRep : srcIRep;
+
+    // optionally quantize anim keys into a bit-packed key stream
+    const bool packAnimKeys = (this->AnimKeyMaxError > 0.0f) && !irep.AnimClips.empty();
+    AnimQuantizer animQuantizer;
+    if (packAnimKeys) {
+        animQuantizer.MaxError = this->AnimKeyMaxError;
+        animQuantizer.Quantize(irep);
+    }
+
+    // otherwise encode 16-bit keys, identical curves can only share
+    // keys with the contiguous key layout
+    AnimKeyEncoder animKeyEncoder;
+    animKeyEncoder.Layout = this->AnimKeyLayout;
+    animKeyEncoder.SegmentLength = this->AnimKeySegmentLength;
+    bool hasSharedCurves = false;
+    for (const auto& clip : irep.AnimClips) {
+        for (const auto& curve : clip.Curves) {
+            hasSharedCurves |= (curve.SharedKeys != -1);
+        }
+    }
+    if (hasSharedCurves) {
+        if (packAnimKeys) {
+            Log::Warn("Shared anim curves are not supported with bit-packed anim keys, writing unshared keys\n");
+        }
+        else if (animKeyEncoder.Layout == OrbAnimKeyLayout::Interleaved) {
+            animKeyEncoder.Layout = OrbAnimKeyLayout::Contiguous;
+        }
+        else if (animKeyEncoder.Layout == OrbAnimKeyLayout::Segmented) {
+            Log::Warn("Shared anim curves are not supported with segmented anim keys, writing unshared keys\n");
+        }
+    }
+    if (!packAnimKeys) {
+        animKeyEncoder.Encode(irep);
+    }
 
     // setup the destination layout, this is the cross-section of
     // the requested layout, and what's actually in the IRep
@@ -100,6 +368,177 @@ OrbSaver::Save(const std::string& path, const IRep& irep) {
         }
     }
 
+    // with quaternion tangent frames, the normal holds the whole tangent frame
+    const bool qtangents = this->QTangents && this->DstLayout.HasAttr(VertexAttr::Normal) && this->DstLayout.HasAttr(VertexAttr::Tangent);
+    if (qtangents) {
+        VertexLayout layout;
+        for (const auto& comp : this->DstLayout.Components) {
+            if (comp.Attr == VertexAttr::Normal) {
+                VertexComponent qtangent = comp;
+                qtangent.Format = VertexFormat::Short4N;
+                layout.Components.push_back(qtangent);
+            }
+            else if ((comp.Attr != VertexAttr::Tangent) && (comp.Attr != VertexAttr::Binormal)) {
+                layout.Components.push_back(comp);
+            }
+        }
+        this->DstLayout = layout;
+    }
+    else if (this->QTangents) {
+        Log::Warn("Quaternion tangent frames need normals and tangents, writing plain normals\n");
+    }
+
+    // setup the vertex layout of each mesh, meshes with the same layout
+    // are grouped into one vertex stream (see 'MVLY' chunk)
+    std::vector<const IRep::Node*> meshNodes;
+    std::vector<const IRep::Mesh*> meshes;
+    std::vector<int> meshStream;
+    std::vector<VertexLayout> streamLayouts;
+    std::vector<int> streamNumVertices;
+    std::vector<uint32_t> meshFirstConstant;
+    std::vector<OrbVertexConstant> constants;
+    for (const auto& node : irep.Nodes) {
+        for (const auto& mesh : node.Meshes) {
+            meshFirstConstant.push_back(constants.size());
+            const VertexLayout layout = this->MeshVertexLayouts ? meshVertexLayout(mesh, this->DstLayout, qtangents, constants) : this->DstLayout;
+            int stream = 0;
+            while ((stream < int(streamLayouts.size())) && !sameVertexLayout(streamLayouts[stream], layout)) {
+                stream++;
+            }
+            if (stream == int(streamLayouts.size())) {
+                streamLayouts.push_back(layout);
+                streamNumVertices.push_back(0);
+            }
+            streamNumVertices[stream] += mesh.Vertices.size();
+            meshNodes.push_back(&node);
+            meshes.push_back(&mesh);
+            meshStream.push_back(stream);
+        }
+    }
+    meshFirstConstant.push_back(constants.size());
+
+    // meshes identical with an earlier mesh share its vertices and indices
+    // (see 'INST' chunk), this also needs identical quantization transforms
+    std::vector<int> meshSource(meshes.size());
+    for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+        meshSource[meshIndex] = meshIndex;
+    }
+    int numInstances = 0;
+    if (this->MeshInstancing) {
+        std::unordered_map<uint64_t, std::vector<int>> uniqueMeshes;
+        for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+            const IRep::Mesh& mesh = *meshes[meshIndex];
+            if (mesh.Vertices.empty()) {
+                continue;
+            }
+            auto& candidates = uniqueMeshes[hashMesh(mesh)];
+            for (int candidate : candidates) {
+                if (!sameMesh(*meshes[candidate], mesh)) {
+                    continue;
+                }
+                bool sameTransforms = true;
+                for (const auto& comp : this->DstLayout.Components) {
+                    glm::vec4 offset0, scale0, offset1, scale1;
+                    this->vertexTransform(irep, *meshNodes[candidate], *meshes[candidate], comp.Attr, comp.Format, offset0, scale0);
+                    this->vertexTransform(irep, *meshNodes[meshIndex], mesh, comp.Attr, comp.Format, offset1, scale1);
+                    sameTransforms &= (offset0 == offset1) && (scale0 == scale1);
+                }
+                if (sameTransforms) {
+                    meshSource[meshIndex] = candidate;
+                    break;
+                }
+            }
+            if (meshSource[meshIndex] == meshIndex) {
+                candidates.push_back(meshIndex);
+            }
+            else {
+                streamNumVertices[meshStream[meshIndex]] -= mesh.Vertices.size();
+                numInstances++;
+            }
+        }
+    }
+    int numIndices = 0;
+    for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+        if (meshSource[meshIndex] == meshIndex) {
+            numIndices += meshes[meshIndex]->Indices.size();
+        }
+    }
+
+    std::vector<int> streamDataOffset(streamLayouts.size(), 0);
+    int vertexDataSize = 0;
+    for (int i = 0; i < int(streamLayouts.size()); i++) {
+        // vertex indices are 16-bit and relative to the stream
+        Log::FailIf(streamNumVertices[i] > IRep::MaxIndexedVertices, "Vertex stream %d has %d vertices, 16-bit vertex indices can only address %d\n",
+            i, streamNumVertices[i], IRep::MaxIndexedVertices);
+        streamDataOffset[i] = vertexDataSize;
+        vertexDataSize += streamNumVertices[i] * streamLayouts[i].ByteSize();
+    }
+
+    // the vertex data of each stream and the index data are written as ranges
+    // of mesh vertices and indices, mesh by mesh, or with progressive meshes
+    // level by level (see 'PMSH' chunk), instances have no data of their own
+    std::vector<std::vector<ProgressiveMeshBuilder::Range>> streamVertexRanges(streamLayouts.size());
+    std::vector<ProgressiveMeshBuilder::Range> indexRanges;
+    if (this->ProgressiveMeshes) {
+        progressive.Interleave(meshSource, meshStream, streamVertexRanges, indexRanges);
+    }
+    else {
+        for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+            if (meshSource[meshIndex] == meshIndex) {
+                ProgressiveMeshBuilder::Range range;
+                range.Mesh = meshIndex;
+                range.Num = meshes[meshIndex]->Vertices.size();
+                streamVertexRanges[meshStream[meshIndex]].push_back(range);
+                range.Num = meshes[meshIndex]->Indices.size();
+                indexRanges.push_back(range);
+            }
+        }
+    }
+
+    // the vertex index of each mesh vertex relative to its stream, and the
+    // first vertex and index of each mesh (instances get the ones of their source)
+    std::vector<std::vector<int>> meshVertexIndex(meshes.size());
+    std::vector<int> meshFirstVertex(meshes.size(), -1);
+    std::vector<int> meshFirstIndex(meshes.size(), -1);
+    for (const auto& ranges : streamVertexRanges) {
+        int curVertex = 0;
+        for (const auto& range : ranges) {
+            auto& vertexIndex = meshVertexIndex[range.Mesh];
+            vertexIndex.resize(meshes[range.Mesh]->Vertices.size());
+            if (meshFirstVertex[range.Mesh] == -1) {
+                meshFirstVertex[range.Mesh] = curVertex;
+            }
+            for (int i = range.First; i < (range.First + range.Num); i++) {
+                vertexIndex[i] = curVertex++;
+            }
+        }
+    }
+    int curIndex = 0;
+    for (const auto& range : indexRanges) {
+        if (meshFirstIndex[range.Mesh] == -1) {
+            meshFirstIndex[range.Mesh] = curIndex;
+        }
+        curIndex += range.Num;
+    }
+    for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+        meshFirstVertex[meshIndex] = meshFirstVertex[meshSource[meshIndex]];
+        meshFirstIndex[meshIndex] = meshFirstIndex[meshSource[meshIndex]];
+    }
+
+    // the level table of progressive meshes goes in front of the vertex
+    // data, so that it is loaded first (the ORB header can't hold it)
+    if (this->ProgressiveMeshes) {
+        std::vector<uint8_t> payload;
+        progressive.Write(payload, meshSource, meshStream, streamLayouts.size(), meshVertexIndex);
+        this->addChunk('PMSH', payload, true);
+        int numBaseVertices = 0;
+        for (const auto& mesh : progressive.Meshes) {
+            numBaseVertices += mesh.NumBaseVertices;
+        }
+        Log::Info("Progressive meshes: %d of %d vertices in base meshes, %d levels, built in %.2f ms\n",
+            numBaseVertices, irep.NumVertices(), progressive.NumLevels, progressive.BuildTimeMs);
+    }
+
     FILE* fp = fopen(path.c_str(), "wb");
     Log::FailIf(!fp, "Failed to open file '%s'\n", path.c_str());
 
@@ -138,14 +577,20 @@ OrbSaver::Save(const std::string& path, const IRep& irep) {
     hdr.AnimClipOffset = offset;
     hdr.NumAnimClips = irep.AnimClips.size();
     offset += sizeof(OrbAnimClip) * hdr.NumAnimClips;
+    offset += this->frontChunks.size();
     hdr.VertexDataOffset = offset;
-    hdr.VertexDataSize = irep.NumVertices() * this->DstLayout.ByteSize();
+    hdr.VertexDataSize = vertexDataSize;
     offset += hdr.VertexDataSize;
     hdr.IndexDataOffset = offset;
-    hdr.IndexDataSize = roundup4(irep.NumIndices() * sizeof(uint16_t));
+    hdr.IndexDataSize = roundup4(numIndices * sizeof(uint16_t));
     offset += hdr.IndexDataSize;
     hdr.AnimKeyDataOffset = offset;
-    hdr.AnimKeyDataSize = roundup4(irep.AnimKeyDataSize() / 2);   // anim keys are 16-bit signed normalized
+    if (packAnimKeys) {
+        hdr.AnimKeyDataSize = roundup4(animQuantizer.KeyData.size());
+    }
+    else {
+        hdr.AnimKeyDataSize = roundup4(animKeyEncoder.Keys.size() * sizeof(int16_t));    // anim keys are 16-bit signed normalized
+    }
     offset += hdr.AnimKeyDataSize;
     hdr.StringPoolDataOffset = offset;
     hdr.StringPoolDataSize = 0;     // this will be filled in at the end!
@@ -209,22 +654,18 @@ OrbSaver::Save(const std::string& path, const IRep& irep) {
         }
     }
 
-    // write meshes
-    int curVertex = 0;
-    int curIndex = 0;
+    // write meshes, FirstVertex is relative to the mesh's vertex stream,
+    // instances get the vertex and index range of their source mesh
     Log::FailIf(ftell(fp) != hdr.MeshOffset, "File offset error (MeshOffset)\n");
-    for (const auto& node : irep.Nodes) {
-        for (const auto& src : node.Meshes) {
-            OrbMesh dst;
-            dst.Material = src.Material;
-            dst.FirstVertex = curVertex;
-            dst.NumVertices = src.Vertices.size();
-            dst.FirstIndex = curIndex;
-            dst.NumIndices = src.Indices.size();
-            fwrite(&dst, 1, sizeof(dst), fp);
-            curVertex += dst.NumVertices;
-            curIndex += dst.NumIndices;
-        }
+    for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+        const IRep::Mesh& src = *meshes[meshIndex];
+        OrbMesh dst;
+        dst.Material = src.Material;
+        dst.FirstVertex = meshFirstVertex[meshIndex];
+        dst.NumVertices = src.Vertices.size();
+        dst.FirstIndex = meshFirstIndex[meshIndex];
+        dst.NumIndices = src.Indices.size();
+        fwrite(&dst, 1, sizeof(dst), fp);
     }
 
     // write bones
@@ -279,14 +720,20 @@ OrbSaver::Save(const std::string& path, const IRep& irep) {
     Log::FailIf(ftell(fp) != hdr.AnimCurveOffset, "File offset error (AnimCurveOffset)\n");
     for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
         const auto& clip = irep.AnimClips[clipIndex];
+        int packedCompIndex = 0;
         for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
             const auto& curve = clip.Curves[curveIndex];
             OrbAnimCurve dst;
             if (curve.IsStatic) {
                 dst.KeyOffset = -1;
             }
+            else if (packAnimKeys) {
+                // index of the curve's first packed component in the clip
+                dst.KeyOffset = packedCompIndex;
+                packedCompIndex += IRep::KeyType::NumComponents(curve.Type);
+            }
             else {
-                dst.KeyOffset = irep.AnimKeyOffset(clipIndex, curveIndex) / 2; // anim keys are 16-bit signed normalized
+                dst.KeyOffset = animKeyEncoder.KeyOffsets[irep.AnimCurveIndex(clipIndex, curveIndex)];
                 Log::FailIf(dst.KeyOffset >= int(hdr.AnimKeyDataSize), "Anim key offset too big\n");
             }
             for (int i = 0; i < 4; i++) {
@@ -314,90 +761,287 @@ OrbSaver::Save(const std::string& path, const IRep& irep) {
         }
     }
 
-    // write the vertex data
+    // write extension chunks which go in front of the vertex data
+    if (!this->frontChunks.empty()) {
+        fwrite(&this->frontChunks[0], 1, this->frontChunks.size(), fp);
+    }
+
+    // write the vertex data, stream by stream
     {
         Log::FailIf(ftell(fp) != hdr.VertexDataOffset, "File offset error (VertexDataOffset)\n");
         uint8_t encodeSpace[1024];
         Log::FailIf(this->DstLayout.ByteSize() >= int(sizeof(encodeSpace)), "Dst vertex stride too big\n");
         int allEncodedBytes = 0;
         const glm::vec4 scaleOne(1.0f);
-        const glm::vec4 scalePos(1.0f/irep.VertexMagnitude, 1.0f);
-        for (const auto& node : irep.Nodes) {
-            for (const auto& mesh : node.Meshes) {
-                const int numVertices = mesh.Vertices.size();
-                for (int i = 0; i < numVertices; i++) {
-                    uint8_t* dstPtr = encodeSpace;
-                    for (const auto& srcComp : irep.VertexComponents) {
-                        if (!this->DstLayout.HasAttr(srcComp.Attr)) {
-                            continue;
-                        }
-                        VertexFormat::Code dstFmt = this->DstLayout.AttrFormat(srcComp.Attr);
-                        const float* srcPtr = &(mesh.Vertices[i][srcComp.Attr].x);
-                        const int numSrcItems = VertexFormat::NumItems(srcComp.Format);
-                        switch (dstFmt) {
-                            case VertexFormat::Float:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Float>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Float2:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Float2>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Float3:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Float3>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Float4:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Float4>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Byte4:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Byte4>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Byte4N:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Byte4N>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::UByte4:
-                                dstPtr = VertexCodec::Encode<VertexFormat::UByte4>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::UByte4N:
-                                dstPtr = VertexCodec::Encode<VertexFormat::UByte4N>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Short2:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Short2>(dstPtr, scalePos, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Short2N:
-                                // FIXME: currently hardcoded for 3.15 fixed-point UV coords!
-                                dstPtr = VertexCodec::Encode<VertexFormat::Short2N>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Short4:
-                                dstPtr = VertexCodec::Encode<VertexFormat::Short4>(dstPtr, scaleOne, srcPtr, numSrcItems);
-                                break;
-                            case VertexFormat::Short4N:
-                                // FIXME: currently hardcoded for vertex positions
-                                dstPtr = VertexCodec::Encode<VertexFormat::Short4N>(dstPtr, scalePos, srcPtr, numSrcItems);
-                                break;
-                            default: break;
+        int numSrcItems[VertexAttr::Num] = { };
+        for (const auto& srcComp : irep.VertexComponents) {
+            numSrcItems[srcComp.Attr] = VertexFormat::NumItems(srcComp.Format);
+        }
+        if (qtangents) {
+            numSrcItems[VertexAttr::Normal] = 4;
+        }
+        float maxNormalError = 0.0f;
+        float maxTangentError = 0.0f;
+        int numFlippedBinormals = 0;
+
+        // per-mesh quantization transforms, and their dequantization
+        // transforms for the 'VQNT' chunk
+        std::vector<std::array<glm::vec4, VertexAttr::Num>> quantOffset(meshes.size());
+        std::vector<std::array<glm::vec4, VertexAttr::Num>> quantScale(meshes.size());
+        std::vector<OrbMeshQuantization> meshQuantization;
+        float maxPosError = 0.0f;
+        for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+            OrbMeshQuantization dst;
+            for (const auto& comp : this->DstLayout.Components) {
+                const int attr = comp.Attr;
+                glm::vec4& offset = quantOffset[meshIndex][attr];
+                glm::vec4& scale = quantScale[meshIndex][attr];
+                if (!this->vertexTransform(irep, *meshNodes[meshIndex], *meshes[meshIndex], comp.Attr, comp.Format, offset, scale)) {
+                    continue;
+                }
+                if (attr == VertexAttr::Position) {
+                    for (int i = 0; i < 3; i++) {
+                        dst.PositionOffset[i] = offset[i];
+                        dst.PositionScale[i] = scale[i];
+                    }
+                    maxPosError = glm::max(maxPosError, glm::max(glm::max(scale.x, scale.y), scale.z) / 32767.0f * 0.5f);
+                }
+                else {
+                    for (int i = 0; i < 2; i++) {
+                        dst.TexCoordOffset[attr - VertexAttr::TexCoord0][i] = offset[i];
+                        dst.TexCoordScale[attr - VertexAttr::TexCoord0][i] = scale[i];
+                    }
+                }
+            }
+            if (this->Quantization != VertexQuantization::Model) {
+                meshQuantization.push_back(dst);
+            }
+        }
+
+        // inside each vertex stream, the attribute streams (see 'VSTR' chunk)
+        // are written one after another
+        const int numAttrStreams = this->DstLayout.NumStreams();
+        for (int stream = 0; stream < int(streamLayouts.size()); stream++) {
+            Log::FailIf(allEncodedBytes != streamDataOffset[stream], "Encoded stream offset error!\n");
+            for (int attrStream = 0; attrStream < numAttrStreams; attrStream++) {
+                for (const auto& range : streamVertexRanges[stream]) {
+                    const int meshIndex = range.Mesh;
+                    for (int i = range.First; i < (range.First + range.Num); i++) {
+                        const IRep::Vertex& vtx = meshes[meshIndex]->Vertices[i];
+                        uint8_t* dstPtr = encodeSpace;
+                        for (const auto& comp : streamLayouts[stream].Components) {
+                            if (comp.Stream != attrStream) {
+                                continue;
+                            }
+                            const glm::vec4 value = (vertexValue(vtx, comp.Attr, qtangents) - quantOffset[meshIndex][comp.Attr]) / quantScale[meshIndex][comp.Attr];
+                            uint8_t* compPtr = dstPtr;
+                            dstPtr = VertexCodec::Encode(comp.Format, dstPtr, scaleOne, &value.x, numSrcItems[comp.Attr]);
+                            if (qtangents && (comp.Attr == VertexAttr::Normal)) {
+                                // round-trip error of the tangent frame
+                                glm::vec3 n, t, b;
+                                VertexCodec::DecodeQTangent(compPtr, n, t, b);
+                                const glm::vec3 srcNormal(vtx[VertexAttr::Normal]);
+                                glm::vec3 srcTangent(vtx[VertexAttr::Tangent]);
+                                if (glm::dot(srcNormal, srcNormal) > 0.0f) {
+                                    maxNormalError = glm::max(maxNormalError, glm::length(n - glm::normalize(srcNormal)));
+                                    // tangents are orthonormalized before encoding
+                                    srcTangent -= glm::normalize(srcNormal) * glm::dot(glm::normalize(srcNormal), srcTangent);
+                                }
+                                if (glm::dot(srcTangent, srcTangent) > 1e-12f) {
+                                    maxTangentError = glm::max(maxTangentError, glm::length(t - glm::normalize(srcTangent)));
+                                }
+                                if (glm::dot(b, glm::vec3(vtx[VertexAttr::Binormal])) < 0.0f) {
+                                    numFlippedBinormals++;
+                                }
+                            }
                         }
+                        const int numEncodedBytes = dstPtr - encodeSpace;
+                        allEncodedBytes += numEncodedBytes;
+                        fwrite(encodeSpace, 1, numEncodedBytes, fp);
                     }
-                    const int numEncodedBytes = dstPtr - encodeSpace;
-                    allEncodedBytes += numEncodedBytes;
-                    fwrite(encodeSpace, 1, numEncodedBytes, fp);
                 }
             }
         }
         Log::FailIf(allEncodedBytes != int(hdr.VertexDataSize), "Encoded destination length error!\n");
+        if (numAttrStreams > 1) {
+            std::vector<uint8_t> payload;
+            appendChunkItem(payload, uint32_t(numAttrStreams));
+            for (int attr = 0; attr < OrbVertexAttr::Num; attr++) {
+                uint32_t attrStream = 0;
+                for (const auto& comp : this->DstLayout.Components) {
+                    if (toOrbVertexAttr(comp.Attr) == attr) {
+                        attrStream = comp.Stream;
+                    }
+                }
+                appendChunkItem(payload, attrStream);
+            }
+            this->addChunk('VSTR', payload);
+        }
+
+        // the position-only depth stream goes into an extension chunk, vertices
+        // are welded across normal and texcoord seams
+        if (this->DepthStream) {
+            VertexLayout depthLayout;
+            for (const auto& comp : this->DstLayout.Components) {
+                if ((comp.Attr == VertexAttr::Position) || (comp.Attr == VertexAttr::Weights) || (comp.Attr == VertexAttr::Indices)) {
+                    depthLayout.Components.push_back(comp);
+                }
+            }
+            const int stride = depthLayout.ByteSize();
+            std::vector<uint8_t> depthVertices;
+            std::vector<uint16_t> depthIndices;
+            std::vector<OrbDepthMesh> depthMeshes;
+            for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+                if (meshSource[meshIndex] != meshIndex) {
+                    depthMeshes.push_back(depthMeshes[meshSource[meshIndex]]);
+                    continue;
+                }
+                const IRep::Mesh& mesh = *meshes[meshIndex];
+                OrbDepthMesh dst;
+                dst.FirstVertex = depthVertices.size() / stride;
+                dst.FirstIndex = depthIndices.size();
+                std::map<std::vector<uint8_t>, uint16_t> welded;
+                std::vector<uint16_t> remap(mesh.Vertices.size());
+                for (int i = 0; i < int(mesh.Vertices.size()); i++) {
+                    uint8_t* dstPtr = encodeSpace;
+                    for (const auto& comp : depthLayout.Components) {
+                        const glm::vec4 value = (mesh.Vertices[i][comp.Attr] - quantOffset[meshIndex][comp.Attr]) / quantScale[meshIndex][comp.Attr];
+                        dstPtr = VertexCodec::Encode(comp.Format, dstPtr, scaleOne, &value.x, numSrcItems[comp.Attr]);
+                    }
+                    const std::vector<uint8_t> key(encodeSpace, dstPtr);
+                    auto it = welded.find(key);
+                    if (it == welded.end()) {
+                        it = welded.insert(std::make_pair(key, uint16_t(dst.FirstVertex + welded.size()))).first;
+                        depthVertices.insert(depthVertices.end(), key.begin(), key.end());
+                    }
+                    remap[i] = it->second;
+                }
+                dst.NumVertices = welded.size();
+                Log::FailIf(int(dst.FirstVertex + dst.NumVertices) > IRep::MaxIndexedVertices, "Depth stream has more than %d vertices, can't be addressed with 16-bit indices\n",
+                    IRep::MaxIndexedVertices);
+                // drop triangles which became degenerate by welding
+                for (int i = 0; i + 2 < int(mesh.Indices.size()); i += 3) {
+                    const uint16_t i0 = remap[mesh.Indices[i]];
+                    const uint16_t i1 = remap[mesh.Indices[i + 1]];
+                    const uint16_t i2 = remap[mesh.Indices[i + 2]];
+                    if ((i0 != i1) && (i1 != i2) && (i0 != i2)) {
+                        depthIndices.push_back(i0);
+                        depthIndices.push_back(i1);
+                        depthIndices.push_back(i2);
+                    }
+                }
+                dst.NumIndices = depthIndices.size() - dst.FirstIndex;
+                depthMeshes.push_back(dst);
+            }
+
+            std::vector<uint8_t> payload;
+            OrbDepthStream depthStream;
+            depthStream.NumComponents = depthLayout.Components.size();
+            depthStream.Stride = stride;
+            depthStream.NumVertices = depthVertices.size() / stride;
+            depthStream.NumIndices = depthIndices.size();
+            appendChunkItem(payload, depthStream);
+            for (const auto& src : depthLayout.Components) {
+                OrbVertexComponent dst;
+                dst.Attr = toOrbVertexAttr(src.Attr);
+                dst.Format = toOrbVertexFormat(src.Format);
+                appendChunkItem(payload, dst);
+            }
+            for (const auto& item : depthMeshes) {
+                appendChunkItem(payload, item);
+            }
+            payload.insert(payload.end(), depthVertices.begin(), depthVertices.end());
+            payload.resize(roundup4(payload.size()), 0);
+            for (uint16_t index : depthIndices) {
+                appendChunkItem(payload, index);
+            }
+            payload.resize(roundup4(payload.size()), 0);
+            this->addChunk('DPTH', payload);
+            Log::Info("Depth stream: %d of %d vertices, %d of %d indices, stride %d of %d bytes\n",
+                depthStream.NumVertices, irep.NumVertices(), depthStream.NumIndices, irep.NumIndices(),
+                stride, this->DstLayout.ByteSize());
+        }
+        if (qtangents) {
+            Log::Info("Quaternion tangent frames: max normal error %f, max tangent error %f, %d flipped binormals\n",
+                maxNormalError, maxTangentError, numFlippedBinormals);
+
+            // the 'QTAN' chunk marks the normal as quaternion tangent frame
+            std::vector<uint8_t> payload;
+            appendChunkItem(payload, uint32_t(OrbVertexAttr::Normal));
+            this->addChunk('QTAN', payload);
+        }
+
+        // the per-mesh dequantization transforms go into an extension chunk
+        if (!meshQuantization.empty()) {
+            std::vector<uint8_t> payload;
+            for (const auto& item : meshQuantization) {
+                appendChunkItem(payload, item);
+            }
+            this->addChunk('VQNT', payload);
+            if (this->DstLayout.AttrFormat(VertexAttr::Position) == VertexFormat::Short4N) {
+                const float modelPosError = glm::max(glm::max(irep.VertexMagnitude.x, irep.VertexMagnitude.y), irep.VertexMagnitude.z) / 32767.0f * 0.5f;
+                Log::Info("Vertex position quantization: max error %f (model-wide range: %f)\n", maxPosError, modelPosError);
+            }
+        }
     }
 
-    // write vertex indices
+    // per-mesh vertex layouts go into an extension chunk
+    if (this->MeshVertexLayouts) {
+        std::vector<uint8_t> payload;
+        OrbVertexLayouts layouts;
+        layouts.NumStreams = streamLayouts.size();
+        for (const auto& layout : streamLayouts) {
+            layouts.NumComponents += layout.Components.size();
+        }
+        appendChunkItem(payload, layouts);
+        uint32_t firstComponent = 0;
+        for (int i = 0; i < int(streamLayouts.size()); i++) {
+            OrbVertexStream dst;
+            dst.FirstComponent = firstComponent;
+            dst.NumComponents = streamLayouts[i].Components.size();
+            dst.Stride = streamLayouts[i].ByteSize();
+            dst.DataOffset = streamDataOffset[i];
+            dst.NumVertices = streamNumVertices[i];
+            appendChunkItem(payload, dst);
+            firstComponent += dst.NumComponents;
+        }
+        for (const auto& layout : streamLayouts) {
+            for (const auto& src : layout.Components) {
+                OrbVertexComponent dst;
+                dst.Attr = toOrbVertexAttr(src.Attr);
+                dst.Format = toOrbVertexFormat(src.Format);
+                appendChunkItem(payload, dst);
+            }
+        }
+        for (int stream : meshStream) {
+            appendChunkItem(payload, uint32_t(stream));
+        }
+        this->addChunk('MVLY', payload);
+
+        // the values of the eliminated constant attributes
+        payload.clear();
+        for (uint32_t first : meshFirstConstant) {
+            appendChunkItem(payload, first);
+        }
+        for (const auto& item : constants) {
+            appendChunkItem(payload, item);
+        }
+        this->addChunk('MCON', payload);
+        Log::Info("Per-mesh vertex layouts: %d streams, %d constant attributes, %d bytes saved\n",
+            int(streamLayouts.size()), int(constants.size()), int(irep.NumVertices() * this->DstLayout.ByteSize() - hdr.VertexDataSize));
+    }
+
+    // write vertex indices, relative to the mesh's vertex stream
     {
         Log::FailIf(ftell(fp) != hdr.IndexDataOffset, "File offset error (IndexDataOffset)\n");
-        uint16_t baseVertexIndex = 0;
         int numBytes = 0;
-        for (const auto& node : irep.Nodes) {
-            for (const auto& mesh : node.Meshes) {
-                for (uint16_t li : mesh.Indices) {
-                    uint16_t vi = li + baseVertexIndex;
-                    fwrite(&vi, 1, sizeof(vi), fp);
-                    numBytes += 2;
-                }
-                baseVertexIndex += mesh.Vertices.size();
+        for (const auto& range : indexRanges) {
+            const auto& vertexIndex = meshVertexIndex[range.Mesh];
+            const auto& indices = meshes[range.Mesh]->Indices;
+            for (int i = range.First; i < (range.First + range.Num); i++) {
+                uint16_t vi = uint16_t(vertexIndex[indices[i]]);
+                fwrite(&vi, 1, sizeof(vi), fp);
+                numBytes += 2;
             }
         }
         if ((numBytes & 3) != 0) {
@@ -406,32 +1050,264 @@ OrbSaver::Save(const std::string& path, const IRep& irep) {
         }
     }
 
+    // meshes sharing their geometry are grouped in an extension chunk for instanced draws
+    if (numInstances > 0) {
+        std::vector<std::vector<int>> sourceInstances(meshes.size());
+        for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+            sourceInstances[meshSource[meshIndex]].push_back(meshIndex);
+        }
+        std::vector<OrbInstanceGroup> groups;
+        std::vector<OrbMeshInstance> instances;
+        for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+            if (sourceInstances[meshIndex].size() < 2) {
+                continue;
+            }
+            OrbInstanceGroup group;
+            group.Mesh = meshIndex;
+            group.FirstInstance = instances.size();
+            group.NumInstances = sourceInstances[meshIndex].size();
+            groups.push_back(group);
+            for (int instanceMesh : sourceInstances[meshIndex]) {
+                OrbMeshInstance dst;
+                dst.Mesh = instanceMesh;
+                dst.Node = meshNodes[instanceMesh] - &irep.Nodes[0];
+                instances.push_back(dst);
+            }
+        }
+        std::vector<uint8_t> payload;
+        OrbInstanceHeader instHdr;
+        instHdr.NumGroups = groups.size();
+        instHdr.NumInstances = instances.size();
+        appendChunkItem(payload, instHdr);
+        for (const auto& item : groups) {
+            appendChunkItem(payload, item);
+        }
+        for (const auto& item : instances) {
+            appendChunkItem(payload, item);
+        }
+        this->addChunk('INST', payload);
+        int numSavedBytes = (irep.NumIndices() - numIndices) * sizeof(uint16_t);
+        for (int meshIndex = 0; meshIndex < int(meshes.size()); meshIndex++) {
+            if (meshSource[meshIndex] != meshIndex) {
+                numSavedBytes += meshes[meshIndex]->Vertices.size() * streamLayouts[meshStream[meshIndex]].ByteSize();
+            }
+        }
+        Log::Info("Mesh instancing: %d meshes in %d instance groups, %d bytes saved\n",
+            int(instances.size()), int(groups.size()), numSavedBytes);
+    }
+
     // write animation keys
     Log::FailIf(ftell(fp) != hdr.AnimKeyDataOffset, "File offset error (AnimKeyDataSize)\n");
-    for (int clipIndex = 0; clipIndex < int(irep.AnimClips.size()); clipIndex++) {
-        const auto& clip = irep.AnimClips[clipIndex];
-        const int clipLength = irep.AnimClipLength(clipIndex);
-        for (int keyIndex = 0; keyIndex < clipLength; keyIndex++) {
-            for (const auto& curve : clip.Curves) {
-                if (!curve.IsStatic) {
-                    const int num = IRep::KeyType::NumComponents(curve.Type);
-                    for (int i = 0; i < num; i++) {
-                        float f = 0.0f;
-                        if (curve.Magnitude[i] > 0.0f) {
-                            f = curve.Keys[keyIndex][i] / curve.Magnitude[i];
-                        }
-                        // f is now between -1.0 and +1.0
-                        glm::i16 p = glm::round(glm::clamp(f*32767.0f, -32768.0f, 32767.0f));
-                        fwrite(&p, 1, sizeof(p), fp);
+    if (packAnimKeys) {
+        std::vector<uint8_t> keyData = animQuantizer.KeyData;
+        keyData.resize(hdr.AnimKeyDataSize, 0);
+        fwrite(&keyData[0], 1, keyData.size(), fp);
+
+        // the packed key layout goes into an extension chunk
+        std::vector<uint8_t> payload;
+        OrbPackedAnimHeader packedHdr;
+        packedHdr.NumClips = animQuantizer.Clips.size();
+        packedHdr.NumComponents = animQuantizer.Components.size();
+        appendChunkItem(payload, packedHdr);
+        for (const auto& src : animQuantizer.Clips) {
+            OrbPackedAnimClip dst;
+            dst.FirstComponent = src.FirstComponent;
+            dst.NumComponents = src.NumComponents;
+            dst.KeyDataOffset = src.KeyDataOffset;
+            dst.KeyStride = src.KeyStride;
+            appendChunkItem(payload, dst);
+        }
+        for (const auto& src : animQuantizer.Components) {
+            OrbPackedAnimComponent dst;
+            dst.Curve = src.Curve;
+            dst.Index = src.Index;
+            dst.Bits = src.Bits;
+            dst.BitOffset = src.BitOffset;
+            dst.Min = src.Min;
+            dst.Scale = src.Scale;
+            appendChunkItem(payload, dst);
+        }
+        this->addChunk('AKBP', payload);
+        Log::Info("Bit-packed anim keys: %d bytes (16-bit keys: %d bytes)\n",
+            hdr.AnimKeyDataSize, roundup4(irep.AnimKeyDataSize() / 2));
+    }
+    else {
+        if (!animKeyEncoder.Keys.empty()) {
+            fwrite(&animKeyEncoder.Keys[0], sizeof(int16_t), animKeyEncoder.Keys.size(), fp);
+        }
+        // 2-bytes padding if animkey data size isn't multiple of 4
+        if ((animKeyEncoder.Keys.size() & 1) != 0) {
+            int16_t padding = 0;
+            fwrite(&padding, 1, sizeof(padding), fp);
+        }
+        // non-default key layouts go into an extension chunk
+        if (animKeyEncoder.Layout != OrbAnimKeyLayout::Interleaved) {
+            std::vector<uint8_t> payload;
+            OrbAnimKeyLayout layout;
+            layout.Layout = animKeyEncoder.Layout;
+            if (animKeyEncoder.Layout == OrbAnimKeyLayout::Segmented) {
+                layout.SegmentLength = animKeyEncoder.SegmentLength;
+                layout.NumSegments = animKeyEncoder.Segments.size();
+            }
+            appendChunkItem(payload, layout);
+            for (const auto& src : animKeyEncoder.Segments) {
+                OrbAnimKeySegment dst;
+                dst.FirstKey = src.FirstKey;
+                dst.NumKeys = src.NumKeys;
+                dst.KeyDataOffset = src.KeyDataOffset;
+                appendChunkItem(payload, dst);
+            }
+            this->addChunk('AKLY', payload);
+        }
+        if (hasSharedCurves && (animKeyEncoder.Layout == OrbAnimKeyLayout::Contiguous)) {
+            Log::Info("Shared anim keys: %d bytes (unshared: %d bytes)\n",
+                hdr.AnimKeyDataSize, roundup4(irep.AnimKeyDataSize() / 2));
+        }
+    }
+
+    // static curves identical with the bind pose go into an extension chunk
+    {
+        std::vector<uint8_t> payload;
+        bool anyBindPose = false;
+        for (const auto& clip : irep.AnimClips) {
+            std::vector<uint32_t> mask((clip.Curves.size() + 31) / 32, 0);
+            for (int curveIndex = 0; curveIndex < int(clip.Curves.size()); curveIndex++) {
+                if (clip.Curves[curveIndex].IsBindPose) {
+                    mask[curveIndex >> 5] |= 1u << (curveIndex & 31);
+                    anyBindPose = true;
+                }
+            }
+            for (uint32_t bits : mask) {
+                appendChunkItem(payload, bits);
+            }
+        }
+        if (anyBindPose) {
+            this->addChunk('ABPC', payload);
+        }
+    }
+
+    // skinning information of skinned meshes goes into an extension chunk
+    if (irep.HasVertexAttr(VertexAttr::Weights) && irep.HasVertexAttr(VertexAttr::Indices)) {
+        std::vector<uint8_t> payload;
+        std::vector<uint32_t> joints;
+        for (const auto& node : irep.Nodes) {
+            for (const auto& mesh : node.Meshes) {
+                OrbMeshSkin dst;
+                dst.FirstJoint = joints.size();
+                dst.NumJoints = mesh.JointPalette.size();
+                for (const auto& vtx : mesh.Vertices) {
+                    uint32_t num = 0;
+                    for (int i = 0; i < 4; i++) {
+                        num += (vtx[VertexAttr::Weights][i] > 0.0f) ? 1 : 0;
                     }
+                    dst.MaxInfluences = std::max(dst.MaxInfluences, num);
                 }
+                joints.insert(joints.end(), mesh.JointPalette.begin(), mesh.JointPalette.end());
+                appendChunkItem(payload, dst);
             }
         }
+        for (uint32_t joint : joints) {
+            appendChunkItem(payload, joint);
+        }
+        this->addChunk('MSKN', payload);
+    }
+
+    // sorted hierarchy levels and inverse bind matrices go into extension chunks
+    {
+        std::vector<uint8_t> payload;
+        OrbHierarchy hier;
+        appendChunkItem(payload, hier);
+        if (irep.BoneLodCutoffs.empty()) {
+            hier.NumBoneLevels = appendHierarchyLevels(payload, irep.Bones);
+        }
+        else {
+            uint32_t numBones = irep.Bones.size();
+            appendChunkItem(payload, numBones);
+        }
+        hier.NumNodeLevels = appendHierarchyLevels(payload, irep.Nodes);
+        memcpy(&payload[0], &hier, sizeof(hier));
+        this->addChunk('HIER', payload);
+    }
+    if (!irep.Bones.empty()) {
+        std::vector<uint8_t> payload;
+        for (const glm::mat4& m : irep.BoneModelMatrices()) {
+            appendChunkItem(payload, glm::inverse(m));
+        }
+        this->addChunk('BIBM', payload);
     }
-    // 2-bytes padding if animkey data size isn't multiple of 4
-    if (((irep.AnimKeyDataSize() / 2) & 3) != 0) {
-        int16_t padding = 0;
-        fwrite(&padding, 1, sizeof(padding), fp);
+    {
+        BoundsBuilder builder;
+        builder.Build(irep);
+        std::vector<uint8_t> payload;
+        for (const auto* list : { &builder.MeshBounds, &builder.NodeBounds }) {
+            for (const Bounds& src : *list) {
+                OrbBounds dst;
+                for (int i = 0; i < 3; i++) {
+                    dst.Min[i] = src.IsEmpty() ? 0.0f : src.Min[i];
+                    dst.Max[i] = src.IsEmpty() ? 0.0f : src.Max[i];
+                    dst.Center[i] = src.Center[i];
+                }
+                dst.Radius = src.Radius;
+                appendChunkItem(payload, dst);
+            }
+        }
+        this->addChunk('BVOL', payload);
+    }
+    {
+        std::vector<uint8_t> payload;
+        for (int nodeIndex = 0; nodeIndex < int(irep.Nodes.size()); nodeIndex++) {
+            if (irep.Nodes[nodeIndex].SpatialChunk != -1) {
+                OrbSpatialChunk dst;
+                dst.Node = nodeIndex;
+                dst.MortonCode = irep.Nodes[nodeIndex].SpatialChunk;
+                appendChunkItem(payload, dst);
+            }
+        }
+        if (!payload.empty()) {
+            this->addChunk('SPCH', payload);
+        }
+    }
+    if (this->Bvh != TriangleBvh::None) {
+        BvhBuilder builder;
+        builder.SkinnedNodes = (this->Bvh == TriangleBvh::All);
+        builder.Build(irep);
+        if (!builder.Trees.empty()) {
+            std::vector<uint8_t> payload;
+            builder.Write(payload);
+            this->addChunk('TBVH', payload);
+        }
+        int numBvhNodes = 0;
+        int numBvhTriangles = 0;
+        for (const auto& tree : builder.Trees) {
+            numBvhNodes += tree.Nodes.size();
+            numBvhTriangles += tree.Triangles.size();
+        }
+        Log::Info("Triangle BVH: %d trees, %d nodes, %d triangles, built in %.2f ms\n",
+            int(builder.Trees.size()), numBvhNodes, numBvhTriangles, builder.BuildTimeMs);
+    }
+    if (!irep.BoneLodCutoffs.empty()) {
+        std::vector<uint8_t> payload;
+        OrbBoneLod lod;
+        lod.NumLevels = irep.BoneLodCutoffs.size();
+        lod.NumBones = irep.Bones.size();
+        appendChunkItem(payload, lod);
+        for (int cutoff : irep.BoneLodCutoffs) {
+            uint32_t numLevelBones = cutoff;
+            appendChunkItem(payload, numLevelBones);
+        }
+        // bones outside a level use their nearest ancestor in the level,
+        // or the first bone if there is none (another root)
+        for (int cutoff : irep.BoneLodCutoffs) {
+            for (int boneIndex = 0; boneIndex < int(irep.Bones.size()); boneIndex++) {
+                int32_t remap = boneIndex;
+                while (remap >= cutoff) {
+                    remap = irep.Bones[remap].Parent;
+                }
+                uint32_t dst = glm::max(remap, 0);
+                appendChunkItem(payload, dst);
+            }
+        }
+        this->addChunk('BLOD', payload);
     }
 
     // write string pool
@@ -449,5 +1325,13 @@ OrbSaver::Save(const std::string& path, const IRep& irep) {
         fwrite(&stringPoolDataSize, 1, sizeof(stringPoolDataSize), fp);
         fseek(fp, 0, SEEK_END);
     }
+
+    // write extension chunks (4-byte aligned after the string pool)
+    if (!this->chunks.empty()) {
+        for (uint32_t pad = roundup4(ftell(fp)) - ftell(fp); pad > 0; pad--) {
+            fputc(0, fp);
+        }
+        fwrite(&this->chunks[0], 1, this->chunks.size(), fp);
+    }
     fclose(fp);
 }
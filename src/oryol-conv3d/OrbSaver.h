@@ -10,16 +10,70 @@
 #include "ExportUtil/Vertex.h"
 #include "IRep.h"
 #include "OrbFileFormat.h"
+#include "ExportUtil/OrbChunkFormat.h"
 
 struct OrbSaver {
     /// the requested vertex layout, drop any src components not in here, ignore non-existing src comps
     VertexLayout Layout;
     /// this is the cross-section of the requested layout, and the IRep layout
     VertexLayout DstLayout;
-    /// save IRep to ORB
-    void Save(const std::string& path, const IRep& irep);
+    /// if > 0, write bit-packed anim keys with this max skinned vertex error (see AnimQuantizer)
+    float AnimKeyMaxError = 0.0f;
+    /// the 16-bit anim key layout (see AnimKeyEncoder)
+    Oryol::OrbAnimKeyLayout::Enum AnimKeyLayout = Oryol::OrbAnimKeyLayout::Interleaved;
+    /// number of keys per segment for the segmented anim key layout
+    int AnimKeySegmentLength = 16;
+    /// quantization ranges of vertex positions and texcoords
+    struct VertexQuantization {
+        enum Enum {
+            Model,  // positions scaled by IRep::VertexMagnitude, texcoords unscaled
+            Node,   // bounding box of all meshes of a node
+            Mesh,   // bounding box of each mesh
+        };
+    };
+    VertexQuantization::Enum Quantization = VertexQuantization::Model;
+    /// nodes with a triangle BVH ('TBVH' chunk)
+    struct TriangleBvh {
+        enum Enum {
+            None,
+            Static,     // nodes without skinned meshes
+            All,        // also nodes with skinned meshes (in their bind pose)
+        };
+    };
+    TriangleBvh::Enum Bvh = TriangleBvh::None;
+    /// if true, also write a position-only (plus skinning) stream with welded indices ('DPTH' chunk)
+    bool DepthStream = false;
+    /// if true, write normal, tangent and binormal as one quaternion tangent frame ('QTAN' chunk)
+    bool QTangents = false;
+    /// if true, drop attributes which are constant across a mesh ('MCON' chunk),
+    /// and group meshes by layout into vertex streams ('MVLY' chunk)
+    bool MeshVertexLayouts = false;
+    /// if true, meshes with identical vertices, indices and material share one vertex and index range ('INST' chunk)
+    bool MeshInstancing = false;
+    /// if true, write the vertices and triangles of all meshes coarse to fine, level by level ('PMSH' chunk)
+    bool ProgressiveMeshes = false;
+    /// save IRep to ORB, bones and nodes are written parents-first (see 'HIER' chunk)
+    void Save(const std::string& path, const IRep& srcIRep);
 
+    /// get the transform to quantize a vertex attribute of a mesh (encoded = (value - offset) / scale),
+    /// returns true if the transform is a per-mesh quantization range (see 'VQNT' chunk)
+    bool vertexTransform(const IRep& irep, const IRep::Node& node, const IRep::Mesh& mesh,
+                         VertexAttr::Code attr, VertexFormat::Code fmt,
+                         glm::vec4& outOffset, glm::vec4& outScale) const;
     uint32_t addString(const std::string& str);
+    /// add an extension chunk, written after the string pool, or in front of the vertex data
+    void addChunk(uint32_t tag, const std::vector<uint8_t>& payload, bool inFront = false);
+    /// append a POD item to a chunk payload
+    template<class TYPE> static void appendChunkItem(std::vector<uint8_t>& payload, const TYPE& item);
 
     std::vector<std::string> strings;
+    std::vector<uint8_t> chunks;
+    std::vector<uint8_t> frontChunks;
 };
+
+//------------------------------------------------------------------------------
+template<class TYPE> inline void
+OrbSaver::appendChunkItem(std::vector<uint8_t>& payload, const TYPE& item) {
+    const uint8_t* ptr = (const uint8_t*) &item;
+    payload.insert(payload.end(), ptr, ptr + sizeof(TYPE));
+}
@@ -0,0 +1,560 @@
+//------------------------------------------------------------------------------
+//  ProgressiveMeshBuilder.cc
+//------------------------------------------------------------------------------
+#include "ProgressiveMeshBuilder.h"
+#include "OrbSaver.h"
+#include "ExportUtil/Log.h"
+#include "ExportUtil/Hash.h"
+#include "ExportUtil/Parallel.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <queue>
+#include <unordered_map>
+#include <math.h>
+
+using namespace OryolTools;
+using namespace Oryol;
+
+/// a symmetric 4x4 error quadric (upper triangle), and the summed plane weights
+struct pmQuadric {
+    double Q[10] = { };
+    double Weight = 0.0;
+
+    void AddPlane(const glm::dvec3& n, double d, double weight) {
+        const double p[4] = { n.x, n.y, n.z, d };
+        int i = 0;
+        for (int row = 0; row < 4; row++) {
+            for (int col = row; col < 4; col++) {
+                this->Q[i++] += p[row] * p[col] * weight;
+            }
+        }
+        this->Weight += weight;
+    }
+    void Add(const pmQuadric& other) {
+        for (int i = 0; i < 10; i++) {
+            this->Q[i] += other.Q[i];
+        }
+        this->Weight += other.Weight;
+    }
+    /// weighted sum of squared distances of a point to the planes
+    double Error(const glm::vec3& pos) const {
+        const double p[4] = { pos.x, pos.y, pos.z, 1.0 };
+        double err = 0.0;
+        int i = 0;
+        for (int row = 0; row < 4; row++) {
+            for (int col = row; col < 4; col++) {
+                err += this->Q[i++] * p[row] * p[col] * ((row == col) ? 1.0 : 2.0);
+            }
+        }
+        return err;
+    }
+};
+
+/// a collapse candidate in the priority queue (cheapest first)
+struct pmCollapse {
+    double Cost = 0.0;
+    int From = 0;
+    int To = 0;
+    uint32_t FromStamp = 0;
+    uint32_t ToStamp = 0;
+
+    bool operator<(const pmCollapse& rhs) const {
+        return this->Cost > rhs.Cost;
+    }
+};
+
+//------------------------------------------------------------------------------
+static glm::vec3
+triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+//------------------------------------------------------------------------------
+void
+ProgressiveMeshBuilder::buildMesh(IRep::Mesh& mesh, Mesh& result) const {
+    const int numWedges = mesh.Vertices.size();
+    const int numTris = mesh.Indices.size() / 3;
+    result = Mesh();
+
+    // the topology is built on welded positions, the vertices at a
+    // position are its wedges (split by attribute seams)
+    std::vector<glm::vec3> pos;
+    std::vector<int> wedgePos(numWedges);
+    {
+        std::unordered_map<uint64_t, std::vector<int>> welded;
+        for (int w = 0; w < numWedges; w++) {
+            const glm::vec3 p(mesh.Vertices[w][VertexAttr::Position]);
+            Hash hash;
+            hash.AddValue(p);
+            auto& candidates = welded[hash.Value];
+            wedgePos[w] = -1;
+            for (int candidate : candidates) {
+                if (pos[candidate] == p) {
+                    wedgePos[w] = candidate;
+                    break;
+                }
+            }
+            if (wedgePos[w] == -1) {
+                wedgePos[w] = pos.size();
+                candidates.push_back(pos.size());
+                pos.push_back(p);
+            }
+        }
+    }
+    const int numPositions = pos.size();
+
+    // working triangles (with collapsed wedges replaced), degenerate
+    // source triangles stay in the base mesh
+    std::vector<std::array<int, 3>> tris(numTris);
+    std::vector<bool> alive(numTris, true);
+    std::vector<int> killedBy(numTris, -1);
+    std::vector<std::vector<int>> posTris(numPositions);
+    for (int t = 0; t < numTris; t++) {
+        for (int i = 0; i < 3; i++) {
+            tris[t][i] = mesh.Indices[t * 3 + i];
+        }
+        const int p0 = wedgePos[tris[t][0]];
+        const int p1 = wedgePos[tris[t][1]];
+        const int p2 = wedgePos[tris[t][2]];
+        if ((p0 == p1) || (p1 == p2) || (p0 == p2)) {
+            alive[t] = false;
+            continue;
+        }
+        posTris[p0].push_back(t);
+        posTris[p1].push_back(t);
+        posTris[p2].push_back(t);
+    }
+    auto triHasPos = [&tris, &wedgePos](int t, int p) {
+        return (wedgePos[tris[t][0]] == p) || (wedgePos[tris[t][1]] == p) || (wedgePos[tris[t][2]] == p);
+    };
+
+    // positions on edges which aren't shared by exactly 2 triangles (open
+    // borders, non-manifold edges) are locked, so is anything with unused wedges
+    std::vector<bool> locked(numPositions, false);
+    {
+        std::unordered_map<uint64_t, int> edgeUse;
+        for (int t = 0; t < numTris; t++) {
+            if (!alive[t]) {
+                continue;
+            }
+            for (int i = 0; i < 3; i++) {
+                const uint64_t p0 = std::min(wedgePos[tris[t][i]], wedgePos[tris[t][(i + 1) % 3]]);
+                const uint64_t p1 = std::max(wedgePos[tris[t][i]], wedgePos[tris[t][(i + 1) % 3]]);
+                edgeUse[(p0 << 32) | p1]++;
+            }
+        }
+        for (const auto& edge : edgeUse) {
+            if (edge.second != 2) {
+                locked[edge.first >> 32] = true;
+                locked[edge.first & 0xFFFFFFFF] = true;
+            }
+        }
+    }
+    std::vector<std::vector<int>> posWedges(numPositions);
+    {
+        std::vector<bool> used(numWedges, false);
+        for (int t = 0; t < numTris; t++) {
+            if (alive[t]) {
+                used[tris[t][0]] = used[tris[t][1]] = used[tris[t][2]] = true;
+            }
+        }
+        for (int w = 0; w < numWedges; w++) {
+            posWedges[wedgePos[w]].push_back(w);
+            locked[wedgePos[w]] = locked[wedgePos[w]] || !used[w];
+        }
+    }
+
+    // area-weighted quadrics of the triangle planes around each position
+    std::vector<pmQuadric> quadrics(numPositions);
+    for (int t = 0; t < numTris; t++) {
+        if (!alive[t]) {
+            continue;
+        }
+        const glm::vec3 n = triangleNormal(pos[wedgePos[tris[t][0]]], pos[wedgePos[tris[t][1]]], pos[wedgePos[tris[t][2]]]);
+        const double len = glm::length(n);
+        if (len > 0.0) {
+            const glm::dvec3 dn = glm::dvec3(n) / len;
+            const double d = -glm::dot(dn, glm::dvec3(pos[wedgePos[tris[t][0]]]));
+            for (int i = 0; i < 3; i++) {
+                quadrics[wedgePos[tris[t][i]]].AddPlane(dn, d, len * 0.5);
+            }
+        }
+    }
+
+    std::vector<uint32_t> stamps(numPositions, 0);
+    std::vector<bool> collapsed(numPositions, false);
+    std::vector<int> parent(numWedges, -1);
+    std::priority_queue<pmCollapse> queue;
+    auto push = [&](int from, int to) {
+        if (!locked[from]) {
+            pmQuadric q = quadrics[from];
+            q.Add(quadrics[to]);
+            queue.push({ q.Error(pos[to]), from, to, stamps[from], stamps[to] });
+        }
+    };
+    auto neighbours = [&](int p, std::vector<int>& out) {
+        out.clear();
+        for (int t : posTris[p]) {
+            if (alive[t]) {
+                for (int w : tris[t]) {
+                    if (wedgePos[w] != p) {
+                        out.push_back(wedgePos[w]);
+                    }
+                }
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+    std::vector<int> fromNeighbours, toNeighbours;
+    for (int p = 0; p < numPositions; p++) {
+        neighbours(p, fromNeighbours);
+        for (int q : fromNeighbours) {
+            push(p, q);
+        }
+    }
+
+    // collapse the cheapest valid edges until none is left, the error of
+    // a collapse is the RMS distance to the planes of the merged quadric
+    std::vector<int> order;
+    std::vector<float> orderError;
+    std::vector<bool> groupEnd;
+    float maxError = 0.0f;
+    while (!queue.empty()) {
+        const pmCollapse c = queue.top();
+        queue.pop();
+        if (collapsed[c.From] || collapsed[c.To] || (stamps[c.From] != c.FromStamp) || (stamps[c.To] != c.ToStamp)) {
+            continue;
+        }
+
+        // link condition: the common neighbours must be the opposite
+        // vertices of the triangles sharing the edge (keeps the mesh manifold)
+        neighbours(c.From, fromNeighbours);
+        neighbours(c.To, toNeighbours);
+        int numCommon = 0;
+        for (int p : fromNeighbours) {
+            numCommon += std::binary_search(toNeighbours.begin(), toNeighbours.end(), p) ? 1 : 0;
+        }
+        int numShared = 0;
+        bool valid = true;
+        for (int t : posTris[c.From]) {
+            if (!alive[t]) {
+                continue;
+            }
+            if (triHasPos(t, c.To)) {
+                numShared++;
+                continue;
+            }
+            // reject collapses which flip or degenerate a remaining triangle
+            glm::vec3 p[3];
+            for (int i = 0; i < 3; i++) {
+                p[i] = pos[wedgePos[tris[t][i]]];
+            }
+            const glm::vec3 n0 = triangleNormal(p[0], p[1], p[2]);
+            for (int i = 0; i < 3; i++) {
+                if (wedgePos[tris[t][i]] == c.From) {
+                    p[i] = pos[c.To];
+                }
+            }
+            const glm::vec3 n1 = triangleNormal(p[0], p[1], p[2]);
+            if (glm::dot(n0, n1) <= 0.2f * glm::length(n0) * glm::length(n1)) {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid || (numCommon != numShared)) {
+            continue;
+        }
+
+        // each used wedge moves to the wedge of the target position in a
+        // triangle along the collapsed edge, a wedge without such triangle
+        // (or with different target wedges) would tear an attribute seam
+        int anyTarget = -1;
+        for (int t : posTris[c.From]) {
+            if (alive[t] && triHasPos(t, c.To)) {
+                int from = -1, to = -1;
+                for (int w : tris[t]) {
+                    from = (wedgePos[w] == c.From) ? w : from;
+                    to = (wedgePos[w] == c.To) ? w : to;
+                }
+                valid &= (parent[from] == -1) || (parent[from] == to);
+                parent[from] = to;
+                anyTarget = to;
+            }
+        }
+        for (int t : posTris[c.From]) {
+            if (alive[t]) {
+                for (int w : tris[t]) {
+                    valid &= (wedgePos[w] != c.From) || (parent[w] != -1);
+                }
+            }
+        }
+        if (!valid || (anyTarget == -1)) {
+            for (int w : posWedges[c.From]) {
+                parent[w] = -1;
+            }
+            continue;
+        }
+
+        // merge From into To
+        for (int t : posTris[c.From]) {
+            if (!alive[t]) {
+                continue;
+            }
+            auto& tri = tris[t];
+            if (triHasPos(t, c.To)) {
+                alive[t] = false;
+                for (int w : tri) {
+                    killedBy[t] = (wedgePos[w] == c.From) ? w : killedBy[t];
+                }
+            }
+            else {
+                for (int i = 0; i < 3; i++) {
+                    if (wedgePos[tri[i]] == c.From) {
+                        tri[i] = parent[tri[i]];
+                    }
+                }
+                posTris[c.To].push_back(t);
+            }
+        }
+        for (int w : posWedges[c.From]) {
+            if (parent[w] == -1) {
+                parent[w] = anyTarget;
+            }
+            order.push_back(w);
+            groupEnd.push_back(false);
+        }
+        posTris[c.From].clear();
+        posWedges[c.From].clear();
+        quadrics[c.To].Add(quadrics[c.From]);
+        collapsed[c.From] = true;
+        const double weight = quadrics[c.To].Weight;
+        maxError = std::max(maxError, float(sqrt(std::max(0.0, c.Cost) / ((weight > 0.0) ? weight : 1.0))));
+        orderError.resize(order.size(), maxError);
+        groupEnd.back() = true;
+        stamps[c.To]++;
+        auto& toTris = posTris[c.To];
+        toTris.erase(std::remove_if(toTris.begin(), toTris.end(), [&alive](int t) { return !alive[t]; }), toTris.end());
+        neighbours(c.To, toNeighbours);
+        for (int p : toNeighbours) {
+            push(c.To, p);
+            push(p, c.To);
+        }
+    }
+
+    // base vertices first, then the collapsed vertices in reverse collapse
+    // order, each vertex's parent comes before it, a prefix is the mesh
+    // state after a collapse if it ends at a collapse boundary
+    const int numCollapsed = order.size();
+    result.NumBaseVertices = numWedges - numCollapsed;
+    std::vector<int> newIndex(numWedges, -1);
+    std::vector<float> prefixError(numWedges + 1, 0.0f);
+    std::vector<bool> prefixBoundary(numWedges + 1, false);
+    int next = 0;
+    for (int w = 0; w < numWedges; w++) {
+        if (parent[w] == -1) {
+            newIndex[w] = next++;
+        }
+    }
+    prefixBoundary[next] = true;
+    for (int i = numCollapsed - 1; i >= 0; i--) {
+        prefixBoundary[next] = prefixBoundary[next] || groupEnd[i];
+        prefixError[next] = orderError[i];
+        newIndex[order[i]] = next++;
+    }
+    prefixBoundary[numWedges] = true;
+    result.Parents.resize(numWedges);
+    std::vector<IRep::Vertex> vertices(numWedges);
+    for (int w = 0; w < numWedges; w++) {
+        result.Parents[newIndex[w]] = uint16_t((parent[w] != -1) ? newIndex[parent[w]] : newIndex[w]);
+        vertices[newIndex[w]] = mesh.Vertices[w];
+    }
+    mesh.Vertices = std::move(vertices);
+
+    // a triangle appears with the wedge whose collapse removed it
+    std::vector<int> appear(numTris);
+    std::vector<int> triOrder(numTris);
+    for (int t = 0; t < numTris; t++) {
+        appear[t] = (killedBy[t] == -1) ? result.NumBaseVertices : (newIndex[killedBy[t]] + 1);
+        triOrder[t] = t;
+    }
+    std::stable_sort(triOrder.begin(), triOrder.end(), [&appear](int a, int b) {
+        return appear[a] < appear[b];
+    });
+    std::vector<uint16_t> indices;
+    indices.reserve(mesh.Indices.size());
+    std::vector<int> sortedAppear;
+    for (int t : triOrder) {
+        for (int i = 0; i < 3; i++) {
+            indices.push_back(uint16_t(newIndex[mesh.Indices[t * 3 + i]]));
+        }
+        sortedAppear.push_back(appear[t]);
+    }
+    mesh.Indices = std::move(indices);
+
+    // prefix levels, halving the number of vertices down to the base mesh,
+    // rounded up to the next collapse boundary
+    for (int level = 0; level < this->MaxLevels; level++) {
+        Level dst;
+        dst.NumVertices = std::max(result.NumBaseVertices, numWedges >> level);
+        while (!prefixBoundary[dst.NumVertices]) {
+            dst.NumVertices++;
+        }
+        if (!result.Levels.empty() && (result.Levels.back().NumVertices == dst.NumVertices)) {
+            continue;
+        }
+        dst.NumIndices = 3 * (std::upper_bound(sortedAppear.begin(), sortedAppear.end(), dst.NumVertices) - sortedAppear.begin());
+        dst.Error = (dst.NumVertices < numWedges) ? prefixError[dst.NumVertices] : 0.0f;
+        result.Levels.push_back(dst);
+        if (dst.NumVertices == result.NumBaseVertices) {
+            break;
+        }
+    }
+    std::reverse(result.Levels.begin(), result.Levels.end());
+}
+
+//------------------------------------------------------------------------------
+void
+ProgressiveMeshBuilder::Build(IRep& irep) {
+    Log::FailIf(this->MaxLevels < 1, "ProgressiveMeshBuilder: invalid MaxLevels\n");
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<IRep::Mesh*> meshes;
+    for (auto& node : irep.Nodes) {
+        for (auto& mesh : node.Meshes) {
+            meshes.push_back(&mesh);
+        }
+    }
+    this->Meshes.clear();
+    this->Meshes.resize(meshes.size());
+    ParallelFor(meshes.size(), [this, &meshes](int i) {
+        this->buildMesh(*meshes[i], this->Meshes[i]);
+    });
+    this->NumLevels = 0;
+    for (const auto& mesh : this->Meshes) {
+        this->NumLevels = std::max(this->NumLevels, int(mesh.Levels.size()));
+    }
+    auto dur = std::chrono::high_resolution_clock::now() - start;
+    this->BuildTimeMs = std::chrono::duration_cast<std::chrono::microseconds>(dur).count() / 1000.0;
+}
+
+//------------------------------------------------------------------------------
+int
+ProgressiveMeshBuilder::MeshLevel(int meshIndex, int level) const {
+    // mesh levels are aligned at the full mesh, the base mesh is in level 0
+    return std::max(0, level - (this->NumLevels - int(this->Meshes[meshIndex].Levels.size())));
+}
+
+//------------------------------------------------------------------------------
+ProgressiveMeshBuilder::Range
+ProgressiveMeshBuilder::VertexRange(int meshIndex, int level) const {
+    const auto& levels = this->Meshes[meshIndex].Levels;
+    Range range;
+    range.Mesh = meshIndex;
+    range.First = (level > 0) ? levels[this->MeshLevel(meshIndex, level - 1)].NumVertices : 0;
+    range.Num = levels[this->MeshLevel(meshIndex, level)].NumVertices - range.First;
+    return range;
+}
+
+//------------------------------------------------------------------------------
+ProgressiveMeshBuilder::Range
+ProgressiveMeshBuilder::IndexRange(int meshIndex, int level) const {
+    const auto& levels = this->Meshes[meshIndex].Levels;
+    Range range;
+    range.Mesh = meshIndex;
+    range.First = (level > 0) ? levels[this->MeshLevel(meshIndex, level - 1)].NumIndices : 0;
+    range.Num = levels[this->MeshLevel(meshIndex, level)].NumIndices - range.First;
+    return range;
+}
+
+//------------------------------------------------------------------------------
+void
+ProgressiveMeshBuilder::Interleave(const std::vector<int>& meshSource, const std::vector<int>& meshStream,
+                                   std::vector<std::vector<Range>>& outStreamVertices, std::vector<Range>& outIndices) const {
+    // level by level, and inside a level mesh by mesh, instances
+    // share the data of their source mesh
+    outIndices.clear();
+    for (auto& ranges : outStreamVertices) {
+        ranges.clear();
+    }
+    for (int level = 0; level < this->NumLevels; level++) {
+        for (int meshIndex = 0; meshIndex < int(this->Meshes.size()); meshIndex++) {
+            if (meshSource[meshIndex] == meshIndex) {
+                outStreamVertices[meshStream[meshIndex]].push_back(this->VertexRange(meshIndex, level));
+                outIndices.push_back(this->IndexRange(meshIndex, level));
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+ProgressiveMeshBuilder::Write(std::vector<uint8_t>& payload, const std::vector<int>& meshSource, const std::vector<int>& meshStream,
+                              int numStreams, const std::vector<std::vector<int>>& meshVertexIndex) const {
+    // the prefix sizes and slices of each level, in the order of Interleave()
+    const int numMeshes = this->Meshes.size();
+    std::vector<OrbProgressiveLevel> levels(this->NumLevels);
+    std::vector<uint32_t> levelStreamVertices(this->NumLevels * numStreams, 0);
+    std::vector<OrbProgressiveSlice> slices(this->NumLevels * numMeshes);
+    std::vector<uint32_t> numStreamVertices(numStreams, 0);
+    uint32_t numIndices = 0;
+    for (int level = 0; level < this->NumLevels; level++) {
+        for (int meshIndex = 0; meshIndex < numMeshes; meshIndex++) {
+            OrbProgressiveSlice& slice = slices[level * numMeshes + meshIndex];
+            if (meshSource[meshIndex] != meshIndex) {
+                slice = slices[level * numMeshes + meshSource[meshIndex]];
+                continue;
+            }
+            const Range indices = this->IndexRange(meshIndex, level);
+            slice.FirstIndex = numIndices;
+            slice.NumIndices = indices.Num;
+            numIndices += indices.Num;
+            numStreamVertices[meshStream[meshIndex]] += this->VertexRange(meshIndex, level).Num;
+            const float error = this->Meshes[meshIndex].Levels[this->MeshLevel(meshIndex, level)].Error;
+            levels[level].Error = std::max(levels[level].Error, error);
+        }
+        levels[level].NumIndices = numIndices;
+        std::copy(numStreamVertices.begin(), numStreamVertices.end(), levelStreamVertices.begin() + level * numStreams);
+    }
+
+    // parents of the stream vertices, stream by stream
+    std::vector<std::vector<uint16_t>> parents(numStreams);
+    for (int stream = 0; stream < numStreams; stream++) {
+        parents[stream].resize(numStreamVertices[stream]);
+    }
+    for (int meshIndex = 0; meshIndex < numMeshes; meshIndex++) {
+        if (meshSource[meshIndex] != meshIndex) {
+            continue;
+        }
+        const auto& vertexIndex = meshVertexIndex[meshIndex];
+        const auto& meshParents = this->Meshes[meshIndex].Parents;
+        for (int i = 0; i < int(meshParents.size()); i++) {
+            parents[meshStream[meshIndex]][vertexIndex[i]] = uint16_t(vertexIndex[meshParents[i]]);
+        }
+    }
+
+    OrbProgressiveHeader hdr;
+    hdr.NumLevels = this->NumLevels;
+    hdr.NumMeshes = numMeshes;
+    hdr.NumStreams = numStreams;
+    for (const auto& streamParents : parents) {
+        hdr.NumVertices += streamParents.size();
+    }
+    OrbSaver::appendChunkItem(payload, hdr);
+    for (const auto& item : levels) {
+        OrbSaver::appendChunkItem(payload, item);
+    }
+    for (uint32_t item : levelStreamVertices) {
+        OrbSaver::appendChunkItem(payload, item);
+    }
+    for (const auto& item : slices) {
+        OrbSaver::appendChunkItem(payload, item);
+    }
+    for (const auto& streamParents : parents) {
+        for (uint16_t parent : streamParents) {
+            OrbSaver::appendChunkItem(payload, parent);
+        }
+    }
+    payload.resize((payload.size() + 3) & ~3, 0);
+}
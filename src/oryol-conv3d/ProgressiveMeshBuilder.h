@@ -0,0 +1,67 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class ProgressiveMeshBuilder
+    @brief order mesh vertices and triangles coarse to fine for streaming
+
+    Each mesh is simplified by half-edge collapses (a position is merged
+    into a neighbour position) with the cheapest quadric error first. The
+    topology is built on welded positions, so attribute seams only collapse
+    along themselves, and positions on open borders are never collapsed,
+    so lower-detail meshes don't crack. The collapse records then define
+    the order of the vertices (base vertices, then reverse collapse order)
+    and triangles (by the vertex prefix they appear in). The levels of all
+    meshes are then aligned into global levels, and the vertex and index
+    data is written level by level, see the 'PMSH' chunk in OrbChunkFormat.h.
+    Meshes are processed in parallel.
+*/
+#include <vector>
+#include "IRep.h"
+
+struct ProgressiveMeshBuilder {
+    /// max number of prefix levels per mesh (the vertex count halves per level)
+    int MaxLevels = 12;
+
+    /// a vertex prefix of a mesh
+    struct Level {
+        int NumVertices = 0;
+        int NumIndices = 0;
+        float Error = 0.0f;
+    };
+    /// the collapse records and prefix levels of a mesh
+    struct Mesh {
+        int NumBaseVertices = 0;
+        std::vector<uint16_t> Parents;
+        std::vector<Level> Levels;
+    };
+    /// one item per mesh in node order
+    std::vector<Mesh> Meshes;
+    /// number of global levels (mesh levels are aligned at the full meshes)
+    int NumLevels = 0;
+    /// wall-clock time of the last Build() in milliseconds
+    double BuildTimeMs = 0.0;
+
+    /// a range of the vertices or indices of a mesh
+    struct Range {
+        int Mesh = 0;
+        int First = 0;
+        int Num = 0;
+    };
+
+    /// simplify all meshes, and reorder their vertices and triangles
+    void Build(IRep& irep);
+    /// get the level of a mesh at a global level
+    int MeshLevel(int meshIndex, int level) const;
+    /// get the vertices which a global level adds to a mesh
+    Range VertexRange(int meshIndex, int level) const;
+    /// get the indices which a global level adds to a mesh
+    Range IndexRange(int meshIndex, int level) const;
+    /// get the coarse to fine order of the vertex data of each vertex stream, and of the index data
+    void Interleave(const std::vector<int>& meshSource, const std::vector<int>& meshStream,
+                    std::vector<std::vector<Range>>& outStreamVertices, std::vector<Range>& outIndices) const;
+    /// append the 'PMSH' chunk payload, with the stream vertex index of each mesh vertex
+    void Write(std::vector<uint8_t>& payload, const std::vector<int>& meshSource, const std::vector<int>& meshStream,
+               int numStreams, const std::vector<std::vector<int>>& meshVertexIndex) const;
+    /// simplify and reorder one mesh
+    void buildMesh(IRep::Mesh& mesh, Mesh& result) const;
+};
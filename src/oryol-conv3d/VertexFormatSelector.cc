@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------
+//  VertexFormatSelector.cc
+//------------------------------------------------------------------------------
+#include "VertexFormatSelector.h"
+#include "ExportUtil/VertexCodec.h"
+#include "ExportUtil/Log.h"
+#include <glm/glm.hpp>
+
+using namespace OryolTools;
+
+//------------------------------------------------------------------------------
+/**
+    Candidate formats of a vertex attribute, smallest first.
+*/
+static std::vector<VertexFormat::Code>
+candidateFormats(VertexAttr::Code attr) {
+    switch (attr) {
+        case VertexAttr::Position:
+            return { VertexFormat::Short4N, VertexFormat::Float3 };
+        case VertexAttr::Normal:
+        case VertexAttr::Tangent:
+        case VertexAttr::Binormal:
+            return { VertexFormat::Byte4N, VertexFormat::Short4N, VertexFormat::Float3 };
+        case VertexAttr::TexCoord0:
+        case VertexAttr::TexCoord1:
+        case VertexAttr::TexCoord2:
+        case VertexAttr::TexCoord3:
+            return { VertexFormat::Short2N, VertexFormat::Float2 };
+        case VertexAttr::Color0:
+        case VertexAttr::Color1:
+            return { VertexFormat::UByte4N, VertexFormat::Float4 };
+        case VertexAttr::Weights:
+            return { VertexFormat::UByte4N, VertexFormat::Short4N, VertexFormat::Float4 };
+        case VertexAttr::Indices:
+            return { VertexFormat::UByte4, VertexFormat::Short4, VertexFormat::Float4 };
+        default:
+            return { };
+    }
+}
+
+//------------------------------------------------------------------------------
+void
+VertexFormatSelector::measure(const IRep& irep, const OrbSaver& saver, VertexAttr::Code attr, VertexFormat::Code fmt, int numSrcComps, float& outMaxError, float& outMeanError) const {
+    outMaxError = 0.0f;
+    outMeanError = 0.0f;
+    double sumError = 0.0;
+    int numValues = 0;
+    const glm::vec4 scaleOne(1.0f);
+    for (const auto& node : irep.Nodes) {
+        for (const auto& mesh : node.Meshes) {
+            glm::vec4 offset, scale;
+            saver.vertexTransform(irep, node, mesh, attr, fmt, offset, scale);
+            for (const auto& vtx : mesh.Vertices) {
+                const glm::vec4 value = (vtx[attr] - offset) / scale;
+                uint8_t encoded[16];
+                VertexCodec::Encode(fmt, encoded, scaleOne, &value.x, numSrcComps);
+                glm::vec4 decoded(0.0f);
+                VertexCodec::Decode(fmt, &decoded.x, 1.0f, 0.0f, encoded, VertexFormat::NumItems(fmt), numSrcComps);
+                decoded = decoded * scale + offset;
+                for (int i = 0; i < numSrcComps; i++) {
+                    const float err = glm::abs(decoded[i] - vtx[attr][i]);
+                    outMaxError = glm::max(outMaxError, err);
+                    sumError += err;
+                    numValues++;
+                }
+            }
+        }
+    }
+    if (numValues > 0) {
+        outMeanError = float(sumError / numValues);
+    }
+}
+
+//------------------------------------------------------------------------------
+VertexLayout
+VertexFormatSelector::Select(const IRep& irep, const OrbSaver& saver) {
+    this->Results.clear();
+    VertexLayout layout = saver.Layout;
+    const int numVertices = irep.NumVertices();
+    for (auto& comp : layout.Components) {
+        int numSrcComps = 0;
+        for (const auto& srcComp : irep.VertexComponents) {
+            if (srcComp.Attr == comp.Attr) {
+                numSrcComps = VertexFormat::NumItems(srcComp.Format);
+            }
+        }
+        if (numSrcComps == 0) {
+            continue;
+        }
+        // quaternion tangent frames have a fixed format
+        if (saver.QTangents && ((comp.Attr == VertexAttr::Normal) || (comp.Attr == VertexAttr::Tangent) || (comp.Attr == VertexAttr::Binormal))) {
+            continue;
+        }
+        const float budget = (comp.Attr == VertexAttr::Position) ? this->MaxPositionError : this->MaxError;
+        Result res;
+        res.Attr = comp.Attr;
+        for (VertexFormat::Code fmt : candidateFormats(comp.Attr)) {
+            if (VertexFormat::NumItems(fmt) < numSrcComps) {
+                continue;
+            }
+            float maxError, meanError;
+            this->measure(irep, saver, comp.Attr, fmt, numSrcComps, maxError, meanError);
+            // bone indices must survive the round trip exactly
+            const bool exact = (comp.Attr == VertexAttr::Indices);
+            if ((exact && (maxError == 0.0f)) || (!exact && (maxError <= budget)) || !VertexFormat::IsPacked(fmt)) {
+                res.Format = fmt;
+                res.MaxError = maxError;
+                res.MeanError = meanError;
+                break;
+            }
+        }
+        if (res.Format == VertexFormat::Invalid) {
+            continue;
+        }
+        res.BytesSaved = (VertexFormat::ByteSize(comp.Format) - VertexFormat::ByteSize(res.Format)) * numVertices;
+        comp.Format = res.Format;
+        this->Results.push_back(res);
+    }
+
+    Log::Info("Vertex format selection (max position error %f, max error %f):\n", this->MaxPositionError, this->MaxError);
+    int bytesSaved = 0;
+    for (const auto& res : this->Results) {
+        Log::Info("  %s: %s, max error %f, mean error %f, %d bytes saved\n",
+            VertexAttr::ToString(res.Attr), VertexFormat::ToString(res.Format),
+            res.MaxError, res.MeanError, res.BytesSaved);
+        bytesSaved += res.BytesSaved;
+    }
+    Log::Info("  total: %d bytes saved (%d vertices)\n", bytesSaved, numVertices);
+    return layout;
+}
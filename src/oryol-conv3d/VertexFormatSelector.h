@@ -0,0 +1,39 @@
+#pragma once
+//------------------------------------------------------------------------------
+/**
+    @class VertexFormatSelector
+    @brief select the smallest vertex format of each attribute within an error budget
+
+    Each vertex attribute of the IRep is encoded and decoded with all
+    candidate formats (smallest first), using the same quantization
+    transforms as the OrbSaver (see OrbSaver::Quantization), the first
+    format with a max round-trip error within the budget is selected.
+    Positions are measured in model units, all other attributes in
+    attribute units, bone indices must be exact.
+*/
+#include <vector>
+#include "ExportUtil/Vertex.h"
+#include "IRep.h"
+#include "OrbSaver.h"
+
+struct VertexFormatSelector {
+    /// max position error in model units
+    float MaxPositionError = 0.0005f;
+    /// max error of all other attributes (normals, texcoords, colors, weights)
+    float MaxError = 0.005f;
+
+    /// the selected format of each attribute
+    struct Result {
+        VertexAttr::Code Attr = VertexAttr::Invalid;
+        VertexFormat::Code Format = VertexFormat::Invalid;
+        float MaxError = 0.0f;
+        float MeanError = 0.0f;
+        int BytesSaved = 0;     // compared to the requested layout, all vertices
+    };
+    std::vector<Result> Results;
+
+    /// select the formats for the saver's requested layout, return the new layout
+    VertexLayout Select(const IRep& irep, const OrbSaver& saver);
+    /// measure the max and mean round-trip error of an attribute in a format
+    void measure(const IRep& irep, const OrbSaver& saver, VertexAttr::Code attr, VertexFormat::Code fmt, int numSrcComps, float& outMaxError, float& outMeanError) const;
+};
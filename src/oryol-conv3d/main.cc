@@ -3,6 +3,7 @@
 //------------------------------------------------------------------------------ 
 #include "ExportUtil/CmdLineArgs.h"
 #include "ExportUtil/Log.h"
+#include "ExportUtil/Config.h"
 #include "pystring.h"
 #include "N3Loader.h"
 #include "N3JsonDumper.h"
@@ -10,6 +11,11 @@
 #include "OrbSaver.h"
 #include "IRepProcessor.h"
 #include "AssimpLoader.h"
+#include "AnimQuantizer.h"
+#include "AnimBench.h"
+#include "VertexFormatSelector.h"
+#include "CodecTest.h"
+#include <stdlib.h>
 
 using namespace OryolTools;
 
@@ -27,6 +33,21 @@ int main(int argc, const char** argv) {
     args.AddBool("-dumpvtx", "dump intermediate representation vertex data");
     args.AddBool("-dumpidx", "dump intermediate representation index data");
     args.AddString("-n3dir", "N3 asset root directory (when loading .n3 file)", "");
+    args.AddString("-animerror", "write bit-packed anim keys with this max skinned vertex error (model units)", "");
+    args.AddString("-animlayout", "16-bit anim key layout (interleaved, contiguous, segmented)", "interleaved");
+    args.AddString("-animsegment", "number of keys per segment with segmented anim key layout", "16");
+    args.AddString("-quant", "vertex position/texcoord quantization ranges (model, node, mesh)", "model");
+    args.AddString("-config", "optional TOML config file with the vertex layout ([Layout] table)", "");
+    args.AddString("-bvh", "write triangle BVHs of nodes for raycasts (none, static, all)", "none");
+    args.AddBool("-depthstream", "write an extra position-only vertex stream with welded indices for depth passes");
+    args.AddBool("-qtangents", "write normal, tangent and binormal as one quaternion tangent frame");
+    args.AddBool("-meshlayouts", "drop vertex attributes constant across a mesh, group meshes by layout into vertex streams");
+    args.AddBool("-instancing", "share the vertices and indices of identical meshes, group them for instanced draws");
+    args.AddBool("-progressive", "order mesh vertices and triangles coarse to fine, so that data prefixes give lower-detail meshes");
+    args.AddString("-vtxerror", "select smallest vertex formats with this max position error (model units)", "");
+    args.AddString("-vtxattrerror", "max error of other vertex attributes with -vtxerror", "0.005");
+    args.AddBool("-benchanim", "benchmark anim key decoding and sampling");
+    args.AddBool("-qtangent-selftest", "run the quaternion tangent frame encode/decode round-trip test and exit");
     if (!args.Parse(argc, argv)) {
         Log::Fatal("Failed to parse args\n");
     }
@@ -36,6 +57,9 @@ int main(int argc, const char** argv) {
         args.ShowHelp();
         return 0;
     }
+    if (args.HasArg("-qtangent-selftest")) {
+        return CodecTest::QTangents(0.001f) ? 0 : 10;
+    }
 
     IRep irep;
     std::string inFile = args.GetString("-in");
@@ -73,8 +97,85 @@ int main(int argc, const char** argv) {
     orbSaver.Layout.Components.push_back(VertexComponent(VertexAttr::TexCoord0, VertexFormat::Short2N));
     orbSaver.Layout.Components.push_back(VertexComponent(VertexAttr::Weights, VertexFormat::UByte4N));
     orbSaver.Layout.Components.push_back(VertexComponent(VertexAttr::Indices, VertexFormat::UByte4));
+    if (args.HasArg("-animerror")) {
+        orbSaver.AnimKeyMaxError = (float) atof(args.GetString("-animerror").c_str());
+        Log::FailIf(orbSaver.AnimKeyMaxError <= 0.0f, "-animerror must be > 0\n");
+    }
+    const std::string animLayout = args.GetString("-animlayout");
+    if (animLayout == "interleaved") {
+        orbSaver.AnimKeyLayout = Oryol::OrbAnimKeyLayout::Interleaved;
+    }
+    else if (animLayout == "contiguous") {
+        orbSaver.AnimKeyLayout = Oryol::OrbAnimKeyLayout::Contiguous;
+    }
+    else if (animLayout == "segmented") {
+        orbSaver.AnimKeyLayout = Oryol::OrbAnimKeyLayout::Segmented;
+    }
+    else {
+        Log::Fatal("invalid -animlayout '%s'\n", animLayout.c_str());
+    }
+    orbSaver.AnimKeySegmentLength = atoi(args.GetString("-animsegment").c_str());
+    Log::FailIf(orbSaver.AnimKeySegmentLength <= 0, "-animsegment must be > 0\n");
+    const std::string quant = args.GetString("-quant");
+    if (quant == "model") {
+        orbSaver.Quantization = OrbSaver::VertexQuantization::Model;
+    }
+    else if (quant == "node") {
+        orbSaver.Quantization = OrbSaver::VertexQuantization::Node;
+    }
+    else if (quant == "mesh") {
+        orbSaver.Quantization = OrbSaver::VertexQuantization::Mesh;
+    }
+    else {
+        Log::Fatal("invalid -quant '%s'\n", quant.c_str());
+    }
+    if (args.HasArg("-config")) {
+        Config config;
+        Log::FailIf(!config.Load(args.GetString("-config")), "Failed to load config '%s'\n", args.GetString("-config").c_str());
+        orbSaver.Layout = config.GetLayout();
+    }
+    const std::string bvh = args.GetString("-bvh");
+    if (bvh == "none") {
+        orbSaver.Bvh = OrbSaver::TriangleBvh::None;
+    }
+    else if (bvh == "static") {
+        orbSaver.Bvh = OrbSaver::TriangleBvh::Static;
+    }
+    else if (bvh == "all") {
+        orbSaver.Bvh = OrbSaver::TriangleBvh::All;
+    }
+    else {
+        Log::Fatal("invalid -bvh '%s'\n", bvh.c_str());
+    }
+    orbSaver.DepthStream = args.HasArg("-depthstream");
+    orbSaver.QTangents = args.HasArg("-qtangents");
+    if (orbSaver.QTangents) {
+        if (!orbSaver.Layout.HasAttr(VertexAttr::Tangent)) {
+            orbSaver.Layout.Components.push_back(VertexComponent(VertexAttr::Tangent, VertexFormat::Byte4N));
+        }
+        if (!orbSaver.Layout.HasAttr(VertexAttr::Binormal)) {
+            orbSaver.Layout.Components.push_back(VertexComponent(VertexAttr::Binormal, VertexFormat::Byte4N));
+        }
+    }
+    orbSaver.MeshVertexLayouts = args.HasArg("-meshlayouts");
+    orbSaver.MeshInstancing = args.HasArg("-instancing");
+    orbSaver.ProgressiveMeshes = args.HasArg("-progressive");
+    if (args.HasArg("-vtxerror")) {
+        VertexFormatSelector selector;
+        selector.MaxPositionError = (float) atof(args.GetString("-vtxerror").c_str());
+        selector.MaxError = (float) atof(args.GetString("-vtxattrerror").c_str());
+        orbSaver.Layout = selector.Select(irep, orbSaver);
+    }
     orbSaver.Save(args.GetString("-out"), irep);
 
+    // run anim benchmarks
+    if (args.HasArg("-benchanim")) {
+        AnimQuantizer defaults;
+        const float maxError = (orbSaver.AnimKeyMaxError > 0.0f) ? orbSaver.AnimKeyMaxError : defaults.MaxError;
+        AnimBench::DecodeKeys(irep, maxError);
+        AnimBench::SampleLayouts(irep, orbSaver.AnimKeySegmentLength);
+    }
+
     // dump intermediate representation
     if (args.HasArg("-dumpproc")) {
         std::string json = IRepJsonDumper::DumpIRepProcessor(irep);